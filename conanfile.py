@@ -9,7 +9,7 @@ required_conan_version = ">=1.60.0"
 
 class HomeBlocksConan(ConanFile):
     name = "homeblocks"
-    version = "5.0.2"
+    version = "5.0.3"
 
     homepage = "https://github.com/eBay/HomeBlocks"
     description = "Block Store built on HomeStore"
@@ -49,6 +49,8 @@ class HomeBlocksConan(ConanFile):
         self.requires("homestore/[^7.0]@oss/master", transitive_headers=True)
         self.requires("iomgr/[^12.0]@oss/master", transitive_headers=True)
         self.requires("sisl/[^13.0]@oss/master", transitive_headers=True)
+        self.requires("xxhash/0.8.2")
+        self.requires("lz4/1.9.4")
 
     def validate(self):
         if self.info.settings.compiler.cppstd:
@@ -26,6 +26,8 @@ struct vol_interface_req : public sisl::ObjLifeCounter< vol_interface_req > {
     lba_count_t nlbas;
     sisl::atomic_counter< int > refcount;
     bool part_of_batch{false};
+    bool fua{false};        // write is acked only once durable, also on volumes with write_back_ack;
+    bool relocation{false}; // internal, data moved by the cleaner, which is neither hot nor an overwrite;
     uint64_t request_id;
     VolumePtr vol{nullptr};                // back ref to the volume this request is associated with.
     Clock::time_point io_start_time;       // time when the request reaches homeblks.
@@ -45,6 +47,35 @@ public:
 
 using vol_interface_req_ptr = boost::intrusive_ptr< vol_interface_req >;
 
+// Checksum algorithm used to protect data blocks of a volume, chosen at volume creation and can't be changed after.
+ENUM(vol_checksum_type, uint8_t,
+     NONE,   // no checksum, data read is not verified; for scratch/cache volumes;
+     CRC16,  // crc16 t10dif, default;
+     CRC32C, // crc32c, uses SSE4.2 crc32 instruction if cpu supports it;
+     XXH3    // xxh3 64 bits hash, truncated to 32 bits;
+);
+
+// Placement of volume data between fast and slow tiers.
+ENUM(vol_tier_policy, uint8_t,
+     AUTO, // frequently read extents are promoted to fast tier in background, cold ones age out;
+     NONE  // data is only served from data device;
+);
+
+// Compression of volume data pages, chosen at volume creation and can't be changed after. Only pages larger than a data
+// blk can be stored compressed.
+ENUM(vol_compression_type, uint8_t,
+     NONE, // default;
+     LZ4   // lz4 fast mode, pages which don't save a blk are stored as is;
+);
+
+// Access pattern the application expects on a range of a volume, given to VolumeManager::advise.
+ENUM(vol_advice, uint8_t,
+     WILLNEED,   // range is going to be read soon, prefetch it into read cache;
+     DONTNEED,   // range is not going to be read again soon, drop it from read cache;
+     SEQUENTIAL, // range is going to be read sequentially, reads in it are followed by read ahead;
+     RANDOM      // range is going to be read randomly, no read ahead in it, which is the default;
+);
+
 struct VolumeInfo {
     VolumeInfo() = default;
     VolumeInfo(const VolumeInfo&) = delete;
@@ -52,8 +83,16 @@ struct VolumeInfo {
             id(rhs.id),
             size_bytes(rhs.size_bytes),
             page_size(rhs.page_size),
+            sector_size(rhs.sector_size),
             name(std::move(rhs.name)),
-            ordinal(rhs.ordinal) {}
+            ordinal(rhs.ordinal),
+            checksum_type(rhs.checksum_type),
+            tier_policy(rhs.tier_policy),
+            dedup(rhs.dedup),
+            compression_type(rhs.compression_type),
+            write_back_ack(rhs.write_back_ack),
+            shared_journal(rhs.shared_journal),
+            mirrored(rhs.mirrored) {}
 
     VolumeInfo(volume_id_t id_in, uint64_t size, uint64_t psize, std::string in_name) :
             id(id_in), size_bytes(size), page_size(psize), name(std::move(in_name)) {}
@@ -64,8 +103,21 @@ struct VolumeInfo {
     volume_id_t id;
     uint64_t size_bytes{0};
     uint64_t page_size{0};
+    // unit of lba in IO requests, a power of 2 from 512 to page_size, page_size if 0. Writes of part of a page are
+    // merged into it by read-modify-write, not with mirrored;
+    uint32_t sector_size{0};
     std::string name;
     uint64_t ordinal = 0;
+    vol_checksum_type checksum_type{vol_checksum_type::CRC16};
+    vol_tier_policy tier_policy{vol_tier_policy::AUTO};
+    bool dedup{false}; // pages with the same content as recently written ones are stored once, chosen at creation;
+    vol_compression_type compression_type{vol_compression_type::NONE};
+    // writes are acked before their journal entry is durable, flush() waits for the writes acked before it;
+    bool write_back_ack{false};
+    // journal records share log flushes with the other volumes created with it, chosen at volume creation;
+    bool shared_journal{false};
+    // data is kept on two pdevs, a copy failing checksum is repaired from the other, needs checksum and no compression;
+    bool mirrored{false};
 
     auto operator<=>(VolumeInfo const& rhs) const {
         return boost::uuids::hash_value(id) <=> boost::uuids::hash_value(rhs.id);
@@ -74,8 +126,11 @@ struct VolumeInfo {
     auto operator==(VolumeInfo const& rhs) const { return id == rhs.id; }
 
     std::string to_string() {
-        return fmt::format("VolumeInfo: id={} size_bytes={}, page_size={}, name={} ordinal={}",
-                           boost::uuids::to_string(id), size_bytes, page_size, name, ordinal);
+        return fmt::format(
+            "VolumeInfo: id={} size_bytes={}, page_size={}, sector_size={}, name={} ordinal={} checksum_type={} "
+            "tier_policy={} dedup={} compression_type={} write_back_ack={} shared_journal={} mirrored={}",
+            boost::uuids::to_string(id), size_bytes, page_size, sector_size, name, ordinal, enum_name(checksum_type),
+            enum_name(tier_policy), dedup, enum_name(compression_type), write_back_ack, shared_journal, mirrored);
     }
 };
 
@@ -123,11 +178,45 @@ public:
      * req.part_of_batch field can be used if this request is part of a batch request. If so, implementation can wait
      * for batch_submit call before issuing the writes. IO might already be started or even completed (in case of
      * errors) before batch_sumbit call, so application cannot assume IO will be started only after submit_batch call.
+     * Writes up to HomeBlocks::max_vol_io_size() are accepted, large ones are split internally into sub IOs issued in
+     * parallel which complete together.
+     *
+     * Durability of an acked write depends on the volume:
+     * - By default, a write is acked once its journal entry is flushed and it survives a crash.
+     * - On volumes with write_back_ack, a write is acked once it is readable. Its journal entry is flushed later
+     *   with those of other writes, a crash before that loses it. flush() or req.fua make writes durable.
+     * - With req.fua set, the write is acked only once durable, along with the writes acked before it.
+     *
+     * Whatever the path, writes to overlapping ranges are applied in issue order, also after a crash.
      *
      * @return std::error_condition no_error or error in issuing writes
      */
     virtual NullAsyncResult write(const VolumePtr& vol, const vol_interface_req_ptr& req) = 0;
 
+    /**
+     * @brief Write several ranges of the volume atomically, either all of them are written or none of them is, even
+     * across a crash. It is meant for databases to drop their double write buffer. Reads racing with the write could
+     * see some of the ranges updated before it completes. It is durable once acked, also with write_back_ack.
+     *
+     * @param vol Pointer to the volume
+     * @param reqs One request per range with its data buffer, ranges must not overlap.
+     *
+     * @return INVALID_ARG if ranges overlap, UNSUPPORTED_OP on volumes with dedup, compression or sectors smaller than
+     * pages.
+     */
+    virtual NullAsyncResult atomic_write(const VolumePtr& vol, const std::vector< vol_interface_req_ptr >& reqs) = 0;
+
+    /**
+     * @brief Barrier for durability, wait until all the writes acked on the volume before this call are durable.
+     * Writes acked after it is called are not waited for. Writes are only acked before they are durable on volumes
+     * created with write_back_ack, on other volumes it completes right away.
+     *
+     * @param vol Pointer to the volume
+     *
+     * @return DRIVE_WRITE_ERROR if any of the writes acked failed to be journaled.
+     */
+    virtual NullAsyncResult flush(const VolumePtr& vol) = 0;
+
     /**
      * @brief Read the data from the volume asynchronously, created from the request. After completion the attached
      * callback function will be called with this req ptr.
@@ -137,6 +226,7 @@ public:
      * req.part_of_batch field can be used if this request is part of a batch request. If so, implementation can wait
      * for batch_submit call before issuing the reads. IO might already be started or even completed (in case of errors)
      * before batch_sumbit call, so application cannot assume IO will be started only after submit_batch call.
+     * Reads up to HomeBlocks::max_vol_io_size() are accepted, large ones are split like writes.
      *
      * @return std::error_condition no_error or error in issuing reads
      */
@@ -150,6 +240,39 @@ public:
      */
     virtual NullAsyncResult unmap(const VolumePtr& vol, const vol_interface_req_ptr& req) = 0;
 
+    /**
+     * @brief Tell how a range of the volume is going to be accessed, so that caching and read ahead of it can be tuned.
+     * It is only a hint, reads of the range are served the same whatever the advice. Prefetched pages are only kept on
+     * volumes with a read cache, i.e. on HDD data device, elsewhere WILLNEED only brings in the index of the range.
+     *
+     * @param vol Pointer to the volume
+     * @param lba Start of the range, in sectors like IO requests
+     * @param nlbas Size of the range, WILLNEED ranges are up to HomeBlocks::max_vol_io_size()
+     * @param advice Access pattern expected on the range
+     *
+     * @return completes once the range is prefetched for WILLNEED, right away for the others. INVALID_ARG if the range
+     * is out of the volume.
+     */
+    virtual NullAsyncResult advise(const VolumePtr& vol, lba_t lba, lba_count_t nlbas, vol_advice advice) = 0;
+
+    /**
+     * @brief Register a buffer the application is going to issue IOs with, for the whole lifetime of it. Its pages are
+     * locked in memory so that they are not faulted in on IO. Buffers of read/write requests should be aligned to
+     * HomeBlocks::io_buf_align(), IOs with unaligned buffers are served through an aligned bounce buffer and pay for a
+     * copy of the data.
+     *
+     * @param buf Start of the buffer, aligned to io_buf_align()
+     * @param size Size of the buffer, multiple of io_buf_align()
+     *
+     * @return INVALID_ARG if buf or size is not aligned.
+     */
+    virtual NullResult register_io_buffer(uint8_t const* buf, uint64_t size) = 0;
+
+    /**
+     * @brief Unregister a buffer registered with register_io_buffer, before the application frees it.
+     */
+    virtual void unregister_io_buffer(uint8_t const* buf) = 0;
+
     /**
      * @brief Submit the io batch, which is a mandatory method to be called if read/write are issued with part_of_batch
      * is set to true. In those cases, without this method, IOs might not be even issued. No-op if previous io requests
@@ -16,6 +16,7 @@
 #include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/nil_generator.hpp>
+#include <boost/uuid/name_generator_sha1.hpp>
 #include <iomgr/io_environment.hpp>
 #include <homestore/homestore.hpp>
 #include <homestore/replication_service.hpp>
@@ -38,6 +39,12 @@ extern std::shared_ptr< HomeBlocks > init_homeblocks(std::weak_ptr< HomeBlocksAp
     inst->init_homestore();
     inst->init_cp();
     inst->start_reaper_thread();
+    inst->start_scrub_timer();
+    inst->start_destage_timer();
+    inst->start_tier_migrate_timer();
+    inst->start_group_commit_timer();
+    inst->start_warmup_timer();
+    inst->start_cleaner_timer();
     HomeBlocksImpl::s_instance_ = inst;
     return inst;
 }
@@ -150,6 +157,59 @@ void HomeBlocksImpl::shutdown() {
         shutdown_timer_hdl_ = iomgr::null_timer_handle;
     }
 
+    if (vol_scrub_timer_hdl_ != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(vol_scrub_timer_hdl_);
+        vol_scrub_timer_hdl_ = iomgr::null_timer_handle;
+    }
+
+    if (vol_destage_timer_hdl_ != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(vol_destage_timer_hdl_);
+        vol_destage_timer_hdl_ = iomgr::null_timer_handle;
+    }
+
+    if (vol_tier_timer_hdl_ != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(vol_tier_timer_hdl_);
+        vol_tier_timer_hdl_ = iomgr::null_timer_handle;
+    }
+
+    {
+        std::scoped_lock lg(group_commit_timer_mtx_);
+        if (vol_group_commit_timer_hdl_ != iomgr::null_timer_handle) {
+            iomanager.cancel_timer(vol_group_commit_timer_hdl_);
+            vol_group_commit_timer_hdl_ = iomgr::null_timer_handle;
+        }
+    }
+
+    if (vol_warmup_timer_hdl_ != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(vol_warmup_timer_hdl_);
+        vol_warmup_timer_hdl_ = iomgr::null_timer_handle;
+    }
+
+    if (vol_clean_timer_hdl_ != iomgr::null_timer_handle) {
+        iomanager.cancel_timer(vol_clean_timer_hdl_);
+        vol_clean_timer_hdl_ = iomgr::null_timer_handle;
+    }
+
+    // writes acked in write back mode are committed before shutdown so that none of them is lost;
+    {
+        std::vector< VolumePtr > vols;
+        {
+            auto lg = std::shared_lock(vol_lock_);
+            for (auto& [_, vol] : vol_map_) {
+                if (vol->write_back_ack() && vol->rd()) { vols.push_back(vol); }
+            }
+        }
+        for (auto& vol : vols) {
+            if (!vol->flush().get()) { LOGE("Failed to commit acked writes of volume: {}", vol->id_str()); }
+        }
+    }
+
+    // destage what is still pending so that no log replay is needed after graceful shutdown;
+    if (!flush_inline_writes().get()) { LOGE("Failed to destage inline writes during shutdown"); }
+
+    // what is read lately is likely to be read again soon after restart;
+    save_warmup_extents();
+
     // set the shutdown flag so that no new requests are accepted;
     sb_->set_flag(SB_FLAGS_GRACEFUL_SHUTDOWN);
     sb_.write();
@@ -162,7 +222,7 @@ void HomeBlocksImpl::shutdown() {
 }
 
 HomeBlocksImpl::HomeBlocksImpl(std::weak_ptr< HomeBlocksApplication >&& application) :
-        _application(std::move(application)), sb_{HB_META_NAME} {
+        _application(std::move(application)), sb_{HB_META_NAME}, warmup_sb_{WARMUP_META_NAME} {
     auto exe_type = SISL_OPTIONS["executor"].as< std::string >();
     std::transform(exe_type.begin(), exe_type.end(), exe_type.begin(), ::tolower);
 
@@ -202,7 +262,7 @@ public:
 
     // this will be called by homestore when create_repl_dev is called;
     std::shared_ptr< homestore::ReplDevListener > create_repl_dev_listener(homestore::group_id_t group_id) override {
-        return std::make_shared< HBListener >(hb_);
+        return std::make_shared< HBListener >(hb_, group_id);
 #if 0
         std::scoped_lock lock_guard(_repl_sm_map_lock);
         auto [it, inserted] = _repl_sm_map.emplace(group_id, nullptr);
@@ -311,6 +371,7 @@ void HomeBlocksImpl::init_homestore() {
         "volume", [this](uint64_t volume_ordinal, const std::vector< chunk_num_t >& chunk_ids) {
             update_vol_sb_cb(volume_ordinal, chunk_ids);
         });
+    bounce_pool_ = std::make_unique< BounceBufferPool >(IO_BUF_ALIGN, HB_DYNAMIC_CONFIG(bounce_buffer_pool_mb) * Mi);
     LOGI("Initialize index chunk selector");
     index_chunk_selector_ = std::make_shared< VolumeChunkSelector >(
         "index", [this](uint64_t volume_ordinal, const std::vector< chunk_num_t >& chunk_ids) {
@@ -391,12 +452,38 @@ void HomeBlocksImpl::init_homestore() {
         }
         // repl_app->on_repl_devs_init_completed();
         superblk_init();
+        if (has_data_dev && has_fast_dev && HB_DYNAMIC_CONFIG(l2_read_cache_mb)) {
+            enable_l2_cache(HB_DYNAMIC_CONFIG(l2_read_cache_mb) * Mi);
+        }
     } else {
         // we are starting on an existing system;
         DEBUG_ASSERT(our_uuid() != boost::uuids::nil_uuid(), "UUID should be recovered from HB superblock!");
         // now callback to application to nofity the uuid so that we are treated as an existing system;
         app->discover_svc_id(our_uuid());
         LOGINFO("We are starting on [{}].", boost::uuids::to_string(our_uuid_));
+
+        // Volumes with shared_journal get back the group journal, which is replayed already.
+        auto const group_jrnl = group_journal();
+        std::vector< VolumePtr > vols;
+        {
+            auto lg = std::shared_lock(vol_lock_);
+            for (auto& [_, vol] : vol_map_) {
+                vols.push_back(vol);
+            }
+        }
+        for (auto& vol : vols) {
+            // References on blks shared by dedup are not persisted, recount them now that log replay is done. It
+            // scans the index of the volume, so vol_lock_ isn't held meanwhile. A volume which can't be recounted
+            // would free shared blks on overwrite, so it is taken offline.
+            if (!vol->rebuild_dedup_refs()) { fault_containment(vol, "failed to recount dedup references"); }
+            if (vol->shared_journal()) {
+                if (group_jrnl) {
+                    vol->set_journal_rd(group_jrnl);
+                } else {
+                    fault_containment(vol, "group journal not found");
+                }
+            }
+        }
     }
 
     recovery_done_ = true;
@@ -439,6 +526,18 @@ void HomeBlocksImpl::on_hb_meta_blk_found(sisl::byte_view const& buf, void* cook
     // the 1st CP should flush all dirty SB before taking traffic;
 }
 
+void HomeBlocksImpl::on_warmup_meta_blk_found(sisl::byte_view const& buf, void* cookie) {
+    warmup_sb_.load(buf, cookie);
+    RELEASE_ASSERT_EQ(warmup_sb_->version, WARMUP_SB_VER);
+    RELEASE_ASSERT_EQ(warmup_sb_->magic, WARMUP_SB_MAGIC);
+
+    std::scoped_lock lg(warmup_mtx_);
+    auto const* extents = warmup_sb_->extents();
+    warmup_extents_.assign(extents, extents + warmup_sb_->num_extents);
+    warmup_saved_extents_ = warmup_sb_->num_extents;
+    LOGI("Warmup superblock loaded, extents to warm up: {}", warmup_extents_.size());
+}
+
 void HomeBlocksImpl::register_metablk_cb() {
     // register some callbacks for metadata recovery;
     using namespace homestore;
@@ -450,6 +549,29 @@ void HomeBlocksImpl::register_metablk_cb() {
             on_hb_meta_blk_found(std::move(buf), voidptr_cast(mblk));
         },
         nullptr /*recovery_comp_cb*/, true /* do_crc */);
+
+    // Warmup SB
+    homestore::hs()->meta_service().register_handler(
+        WARMUP_META_NAME,
+        [this](homestore::meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            on_warmup_meta_blk_found(std::move(buf), voidptr_cast(mblk));
+        },
+        nullptr /*recovery_comp_cb*/, true /* do_crc */);
+
+    // L2 read cache SB, its log store has to be opened before log service starts.
+    homestore::hs()->meta_service().register_handler(
+        L2ReadCache::L2_CACHE_META_NAME,
+        [this](homestore::meta_blk* mblk, sisl::byte_view buf, size_t size) {
+            l2_cache_ = std::make_unique< L2ReadCache >(HB_DYNAMIC_CONFIG(l2_read_cache_mb) * Mi);
+            l2_cache_->on_meta_blk_found(std::move(buf), voidptr_cast(mblk));
+        },
+        nullptr /*recovery_comp_cb*/, true /* do_crc */);
+}
+
+void HomeBlocksImpl::enable_l2_cache(uint64_t capacity_bytes) {
+    if (l2_cache_) { return; }
+    l2_cache_ = std::make_unique< L2ReadCache >(capacity_bytes);
+    l2_cache_->create();
 }
 
 void HomeBlocksImpl::on_init_complete() {
@@ -469,7 +591,10 @@ void HomeBlocksImpl::on_init_complete() {
     homestore::hs()->meta_service().read_sub_sb(Volume::VOL_META_NAME);
 }
 
-void HomeBlocksImpl::init_cp() {}
+void HomeBlocksImpl::init_cp() {
+    homestore::hs()->cp_mgr().register_consumer(homestore::cp_consumer_t::HS_CLIENT,
+                                                std::make_unique< HBCPCallbacks >(this));
+}
 
 uint64_t HomeBlocksImpl::gc_timer_nsecs() const {
     if (SISL_OPTIONS.count("gc_timer_nsecs")) {
@@ -515,6 +640,367 @@ void HomeBlocksImpl::vol_gc() {
     }
 }
 
+void HomeBlocksImpl::start_scrub_timer() {
+    if (!HB_DYNAMIC_CONFIG(scrub_on)) {
+        LOGI("Background scrubber is turned off");
+        return;
+    }
+
+    auto const msecs = HB_DYNAMIC_CONFIG(scrub_timer_ms);
+    LOGI("Starting volume scrub timer with interval: {} ms, bandwidth: {} MB/s", msecs,
+         HB_DYNAMIC_CONFIG(scrub_bandwidth_mb));
+    vol_scrub_timer_hdl_ = iomanager.schedule_global_timer(
+        msecs * 1000 * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_scrub(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_scrub() {
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    // Only one round in flight, if the device can't keep up with the configured bandwidth, we skip ticks.
+    bool expected{false};
+    if (!scrub_running_.compare_exchange_strong(expected, true)) {
+        LOGD("Previous scrub round is still in progress, skipping");
+        return;
+    }
+
+    // Yield to foreground IO, a busy volume is skipped and picked up again in later ticks.
+    std::vector< VolumePtr > vols_to_scrub;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (vol->is_online() && vol->rd() && vol->checksum_type() != vol_checksum_type::NONE &&
+                vol->num_outstanding_reqs() <= HB_DYNAMIC_CONFIG(scrub_yield_outstanding_reqs)) {
+                vols_to_scrub.push_back(vol);
+            }
+        }
+    }
+
+    if (vols_to_scrub.empty()) {
+        scrub_running_ = false;
+        return;
+    }
+
+    // Bandwidth budget of this tick is shared by all volumes being scrubbed.
+    auto const budget = HB_DYNAMIC_CONFIG(scrub_bandwidth_mb) * Mi * HB_DYNAMIC_CONFIG(scrub_timer_ms) / 1000;
+    auto const vol_budget = std::max(static_cast< uint64_t >(DATA_BLK_SIZE), budget / vols_to_scrub.size());
+
+    std::vector< VolumeManager::AsyncResult< lba_t > > futs;
+    for (auto& vol : vols_to_scrub) {
+        // hold a ref so that volume destroy and shutdown wait for the scrub batch to finish;
+        vol->inc_ref();
+        futs.emplace_back(vol->scrub(vol_budget).thenValue([vol](auto&& ret) {
+            vol->dec_ref();
+            return ret;
+        }));
+    }
+
+    folly::collectAllUnsafe(futs).thenValue([this](auto&&) { scrub_running_ = false; });
+}
+
+void HomeBlocksImpl::start_destage_timer() {
+    auto const msecs = HB_DYNAMIC_CONFIG(inline_destage_timer_ms);
+    LOGI("Starting inline write destage timer with interval: {} ms", msecs);
+    vol_destage_timer_hdl_ = iomanager.schedule_global_timer(
+        msecs * 1000 * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_destage(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_destage() {
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    // Mirrored volumes with lbas left stale on a copy by failed writes are resynced on the same ticks.
+    std::vector< VolumePtr > vols_to_destage;
+    std::vector< VolumePtr > vols_to_resync;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (!vol->is_online() || !vol->rd()) { continue; }
+            if (vol->inline_cache()->num_pages()) { vols_to_destage.push_back(vol); }
+            if (vol->mirrored() && vol->num_mirror_dirty_ranges()) { vols_to_resync.push_back(vol); }
+        }
+    }
+
+    // destage is single flight per volume, a tick finding previous round still in flight is a no-op for it;
+    for (auto& vol : vols_to_destage) {
+        vol->destage(HB_DYNAMIC_CONFIG(inline_destage_batch_pages));
+    }
+    // so is resync, a ref is held so that volume destroy and shutdown wait for it;
+    for (auto& vol : vols_to_resync) {
+        vol->inc_ref();
+        vol->resync_mirror().thenValue([vol](auto&&) { vol->dec_ref(); });
+    }
+}
+
+void HomeBlocksImpl::start_tier_migrate_timer() {
+    auto const msecs = HB_DYNAMIC_CONFIG(tier_migrate_timer_ms);
+    LOGI("Starting tier migrate timer with interval: {} ms, bandwidth: {} MB/s", msecs,
+         HB_DYNAMIC_CONFIG(tier_migrate_bandwidth_mb));
+    vol_tier_timer_hdl_ = iomanager.schedule_global_timer(
+        msecs * 1000 * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_tier_migrate(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_tier_migrate() {
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    bool expected{false};
+    if (!tier_migrate_running_.compare_exchange_strong(expected, true)) { return; }
+
+    // Only volumes with a fast tier to promote to track access frequency, busy volumes are skipped in this tick.
+    std::vector< VolumePtr > vols_to_migrate;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (vol->is_online() && vol->rd() && vol->access_tracker() &&
+                vol->num_outstanding_reqs() <= HB_DYNAMIC_CONFIG(scrub_yield_outstanding_reqs)) {
+                vols_to_migrate.push_back(vol);
+            }
+        }
+    }
+
+    if (vols_to_migrate.empty()) {
+        tier_migrate_running_ = false;
+        return;
+    }
+
+    auto const budget =
+        HB_DYNAMIC_CONFIG(tier_migrate_bandwidth_mb) * Mi * HB_DYNAMIC_CONFIG(tier_migrate_timer_ms) / 1000;
+    auto const vol_budget = budget / vols_to_migrate.size();
+
+    std::vector< VolumeManager::AsyncResult< uint64_t > > futs;
+    for (auto& vol : vols_to_migrate) {
+        vol->inc_ref();
+        futs.emplace_back(vol->promote_hot_extents(vol_budget).thenValue([vol](auto&& ret) {
+            vol->dec_ref();
+            return ret;
+        }));
+    }
+
+    folly::collectAllUnsafe(futs).thenValue([this](auto&&) { tier_migrate_running_ = false; });
+}
+
+void HomeBlocksImpl::start_cleaner_timer() {
+    if (!HB_DYNAMIC_CONFIG(log_structured_on)) {
+        LOGI("Log structured allocation is turned off, no cleaner");
+        return;
+    }
+
+    auto const msecs = HB_DYNAMIC_CONFIG(cleaner_timer_ms);
+    LOGI("Starting cleaner timer with interval: {} ms, bandwidth: {} MB/s", msecs,
+         HB_DYNAMIC_CONFIG(cleaner_bandwidth_mb));
+    vol_clean_timer_hdl_ = iomanager.schedule_global_timer(
+        msecs * 1000 * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_clean(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_clean() {
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    bool expected{false};
+    if (!clean_running_.compare_exchange_strong(expected, true)) { return; }
+
+    // Cleaning competes with application IOs for the same disk arms, busy volumes are skipped in this tick.
+    std::vector< VolumePtr > vols_to_clean;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (vol->is_online() && vol->rd() && vol->log_structured() &&
+                vol->num_outstanding_reqs() <= HB_DYNAMIC_CONFIG(scrub_yield_outstanding_reqs)) {
+                vols_to_clean.push_back(vol);
+            }
+        }
+    }
+
+    if (vols_to_clean.empty()) {
+        clean_running_ = false;
+        return;
+    }
+
+    auto const budget = HB_DYNAMIC_CONFIG(cleaner_bandwidth_mb) * Mi * HB_DYNAMIC_CONFIG(cleaner_timer_ms) / 1000;
+    auto const vol_budget = budget / vols_to_clean.size();
+
+    std::vector< VolumeManager::AsyncResult< uint64_t > > futs;
+    for (auto& vol : vols_to_clean) {
+        vol->inc_ref();
+        futs.emplace_back(vol->clean(vol_budget).thenValue([vol](auto&& ret) {
+            vol->dec_ref();
+            return ret;
+        }));
+    }
+
+    folly::collectAllUnsafe(futs).thenValue([this](auto&&) { clean_running_ = false; });
+}
+
+void HomeBlocksImpl::start_group_commit_timer() {
+    std::scoped_lock lg(group_commit_timer_mtx_);
+    if (vol_group_commit_timer_hdl_ != iomgr::null_timer_handle || is_shutting_down()) { return; }
+    {
+        auto vol_lg = std::shared_lock(vol_lock_);
+        if (std::none_of(vol_map_.begin(), vol_map_.end(),
+                         [](auto const& entry) { return entry.second->write_back_ack(); })) {
+            return;
+        }
+    }
+
+    auto const usecs = HB_DYNAMIC_CONFIG(group_commit_timer_us);
+    LOGI("Starting group commit timer with interval: {} us, max entries: {}", usecs,
+         HB_DYNAMIC_CONFIG(group_commit_max_entries));
+    vol_group_commit_timer_hdl_ = iomanager.schedule_global_timer(
+        usecs * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_group_commit(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_group_commit() {
+    // acked writes still queued at shutdown are submitted by the flush in shutdown;
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    std::vector< VolumePtr > vols;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (vol->write_back_ack() && vol->rd()) { vols.push_back(vol); }
+        }
+    }
+
+    for (auto& vol : vols) {
+        vol->submit_journal_writes();
+    }
+}
+
+void HomeBlocksImpl::start_warmup_timer() {
+    if (warmup_pending_extents() == 0) { return; }
+
+    auto const msecs = HB_DYNAMIC_CONFIG(warmup_timer_ms);
+    LOGI("Starting warmup timer with interval: {} ms, bandwidth: {} MB/s, extents: {}", msecs,
+         HB_DYNAMIC_CONFIG(warmup_bandwidth_mb), warmup_pending_extents());
+    vol_warmup_timer_hdl_ = iomanager.schedule_global_timer(
+        msecs * 1000 * 1000, true /* recurring */, nullptr /* cookie */, iomgr::reactor_regex::all_user,
+        [this](void*) { this->vol_warmup(); }, true /* wait_to_schedule */);
+}
+
+void HomeBlocksImpl::vol_warmup() {
+    if (is_shutting_down() || is_restricted() || !recovery_done_) { return; }
+
+    bool expected{false};
+    if (!warmup_running_.compare_exchange_strong(expected, true)) { return; }
+
+    // Bandwidth budget of this tick is spent on the extents in the order they were persisted.
+    auto budget = HB_DYNAMIC_CONFIG(warmup_bandwidth_mb) * Mi * HB_DYNAMIC_CONFIG(warmup_timer_ms) / 1000;
+    std::vector< NullAsyncResult > futs;
+    {
+        std::scoped_lock lg(warmup_mtx_);
+        while (budget && !warmup_extents_.empty()) {
+            auto const ext = warmup_extents_.front();
+            warmup_extents_.pop_front();
+
+            // volumes destroyed or resized since the extents were persisted are skipped;
+            auto vol = lookup_volume(ext.vol_id);
+            if (!vol || !vol->is_online() || !vol->rd()) { continue; }
+            auto const page_size = vol->info()->page_size;
+            if ((ext.start_lba + ext.nlbas) * page_size > vol->info()->size_bytes) { continue; }
+
+            budget -= std::min< uint64_t >(budget, ext.nlbas * page_size);
+            vol->inc_ref();
+            futs.emplace_back(vol->prefetch(ext.start_lba, ext.nlbas).thenValue([vol](auto&& ret) {
+                vol->dec_ref();
+                return ret;
+            }));
+        }
+        if (futs.empty() && warmup_extents_.empty()) {
+            warmup_running_ = false;
+            return;
+        }
+    }
+
+    folly::collectAllUnsafe(futs).thenValue([this](auto&&) {
+        if (warmup_pending_extents() == 0) { LOGI("Warmup is done"); }
+        warmup_running_ = false;
+    });
+}
+
+void HomeBlocksImpl::save_warmup_extents() {
+    auto const max_bytes = HB_DYNAMIC_CONFIG(warmup_max_mb) * Mi;
+    std::vector< std::pair< volume_id_t, std::vector< std::pair< lba_t, lba_count_t > > > > vol_extents;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [id, vol] : vol_map_) {
+            if (vol->is_online()) { vol_extents.emplace_back(id, vol->hot_extents(max_bytes)); }
+        }
+    }
+
+    // Extents of all volumes are interleaved, so that they are all warmed up alike.
+    std::vector< warmup_extent_t > extents;
+    for (size_t i = 0;; ++i) {
+        auto const n = extents.size();
+        for (auto const& [id, hot] : vol_extents) {
+            if (i < hot.size()) { extents.push_back(warmup_extent_t{id, hot[i].first, hot[i].second}); }
+        }
+        if (extents.size() == n) { break; }
+    }
+
+    auto const size = uint32_cast(sizeof(warmup_sb_t) + extents.size() * sizeof(warmup_extent_t));
+    if (warmup_sb_.get()) {
+        warmup_sb_.resize(size);
+    } else {
+        warmup_sb_.create(size);
+    }
+    warmup_sb_->magic = WARMUP_SB_MAGIC;
+    warmup_sb_->version = WARMUP_SB_VER;
+    warmup_sb_->num_extents = uint32_cast(extents.size());
+    std::copy(extents.begin(), extents.end(), warmup_sb_->extents());
+    warmup_sb_.write();
+    LOGI("Saved {} extents to warm up after restart", extents.size());
+}
+
+uint32_t HomeBlocksImpl::warmup_saved_extents() const {
+    std::scoped_lock lg(warmup_mtx_);
+    return warmup_saved_extents_;
+}
+
+uint64_t HomeBlocksImpl::warmup_pending_extents() const {
+    std::scoped_lock lg(warmup_mtx_);
+    return warmup_extents_.size();
+}
+
+homestore::group_id_t HomeBlocksImpl::group_journal_id() const {
+    return boost::uuids::name_generator_sha1(our_uuid_)("group_journal");
+}
+
+ReplDevPtr HomeBlocksImpl::group_journal(bool create) {
+    std::scoped_lock lg(group_journal_mtx_);
+    if (group_journal_) { return group_journal_; }
+
+    auto const gid = group_journal_id();
+    if (auto ret = homestore::hs()->repl_service().get_repl_dev(gid); ret.hasValue()) {
+        group_journal_ = ret.value();
+    } else if (create) {
+        // members left empty on purpose for solo repl dev
+        LOGI("Creating group journal, uuid: {}", boost::uuids::to_string(gid));
+        auto cret = homestore::hs()->repl_service().create_repl_dev(gid, {} /*members*/).get();
+        if (cret.hasError()) {
+            LOGE("Failed to create group journal, uuid: {}, error: {}", boost::uuids::to_string(gid), cret.error());
+            return nullptr;
+        }
+        group_journal_ = cret.value();
+    }
+    return group_journal_;
+}
+
+folly::Future< bool > HomeBlocksImpl::flush_inline_writes() {
+    std::vector< folly::Future< bool > > futs;
+    {
+        auto lg = std::shared_lock(vol_lock_);
+        for (auto& [_, vol] : vol_map_) {
+            if (vol->rd() && vol->inline_cache()->num_pages()) { futs.emplace_back(vol->flush_inline_writes()); }
+        }
+    }
+
+    return folly::collectAllUnsafe(futs).thenValue([](auto&& results) {
+        return std::all_of(results.begin(), results.end(), [](auto const& t) { return t.hasValue() && t.value(); });
+    });
+}
+
 bool HomeBlocksImpl::fc_on() const {
 #ifdef _PRERELEASE
     // for prerelease mode, fault containment is disabled;
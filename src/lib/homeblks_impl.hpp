@@ -15,6 +15,7 @@
  *********************************************************************************/
 
 #pragma once
+#include <deque>
 #include <map>
 #include <string>
 #include <sisl/fds/id_reserver.hpp>
@@ -25,11 +26,14 @@
 #include <homestore/index/index_table.hpp>
 #include <homestore/superblk_handler.hpp>
 #include <homestore/fault_cmt_service.hpp>
+#include <homestore/checkpoint/cp_mgr.hpp>
 #include <homeblks/home_blks.hpp>
 #include <homeblks/volume_mgr.hpp>
 #include <homeblks/common.hpp>
 #include "volume/volume.hpp"
 #include "volume/volume_chunk_selector.hpp"
+#include "volume/bounce_buffer_pool.hpp"
+#include "volume/l2_read_cache.hpp"
 
 namespace homeblocks {
 
@@ -54,15 +58,38 @@ class HomeBlocksImpl : public HomeBlocks, public VolumeManager, public std::enab
         bool test_flag(uint32_t bit) { return flag & bit; }
     };
 
+    struct warmup_extent_t {
+        volume_id_t vol_id;
+        lba_t start_lba;
+        lba_count_t nlbas;
+    };
+
+    // Extents read lately on all volumes, persisted at graceful shutdown to be warmed up after restart.
+    struct warmup_sb_t {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t num_extents;
+        // List of extents is stored after this, hottest ones of every volume first.
+
+        warmup_extent_t* extents() { return r_cast< warmup_extent_t* >(uintptr_cast(this) + sizeof(warmup_sb_t)); }
+    };
+
 private:
     inline static auto const HB_META_NAME = std::string("HomeBlks2");
     static constexpr uint64_t HB_SB_MAGIC{0xCEEDDEEB};
     static constexpr uint32_t HB_SB_VER{0x1};
+    inline static auto const WARMUP_META_NAME = std::string("HomeBlksWarmup");
+    static constexpr uint64_t WARMUP_SB_MAGIC{0xCEEDC0DE};
+    static constexpr uint32_t WARMUP_SB_VER{0x1};
     static constexpr uint64_t HS_CHUNK_SIZE = 2 * Gi;
     static constexpr uint32_t DATA_BLK_SIZE = 4096;
     static constexpr uint32_t SB_FLAGS_GRACEFUL_SHUTDOWN{0x00000001};
     static constexpr uint32_t SB_FLAGS_RESTRICTED{0x00000002};
-    static constexpr uint64_t MAX_VOL_IO_SIZE = 1 * Mi; // 1 MiB
+    static constexpr uint64_t MAX_VOL_IO_SIZE = 64 * Mi;    // larger IOs are rejected;
+    static constexpr uint64_t MAX_VOL_SUB_IO_SIZE = 1 * Mi; // larger IOs are split into sub IOs of up to this size;
+    static constexpr uint64_t MAX_VOL_PAGE_SIZE = 128 * Ki;
+    static constexpr uint32_t MIN_VOL_SECTOR_SIZE = 512;
+    static constexpr uint32_t IO_BUF_ALIGN = 512; // buffers not aligned to it are bounced through aligned ones;
 
 private:
     /// Our SvcId retrieval and SvcId->IP mapping
@@ -93,6 +120,31 @@ private:
     folly::Promise< folly::Unit > shutdown_promise_;
     iomgr::timer_handle_t vol_gc_timer_hdl_{iomgr::null_timer_handle};
     iomgr::timer_handle_t shutdown_timer_hdl_{iomgr::null_timer_handle};
+    iomgr::timer_handle_t vol_scrub_timer_hdl_{iomgr::null_timer_handle};
+    std::atomic< bool > scrub_running_{false}; // previous scrub round is still in flight;
+    iomgr::timer_handle_t vol_destage_timer_hdl_{iomgr::null_timer_handle};
+    iomgr::timer_handle_t vol_tier_timer_hdl_{iomgr::null_timer_handle};
+    std::atomic< bool > tier_migrate_running_{false}; // previous tier migrate round is still in flight;
+    std::mutex group_commit_timer_mtx_;
+    iomgr::timer_handle_t vol_group_commit_timer_hdl_{iomgr::null_timer_handle};
+    std::mutex group_journal_mtx_;
+    ReplDevPtr group_journal_; // journal of volumes with shared_journal, created along with the first of them;
+
+    std::unique_ptr< BounceBufferPool > bounce_pool_;
+    std::mutex io_bufs_mtx_;
+    std::map< uint8_t const*, uint64_t > io_bufs_; // buffers registered by application, start -> size;
+
+    std::unique_ptr< L2ReadCache > l2_cache_; // only with HDD data device and a fast device;
+
+    superblk< warmup_sb_t > warmup_sb_;
+    iomgr::timer_handle_t vol_warmup_timer_hdl_{iomgr::null_timer_handle};
+    std::atomic< bool > warmup_running_{false}; // previous warmup round is still in flight;
+    mutable std::mutex warmup_mtx_;
+    std::deque< warmup_extent_t > warmup_extents_; // persisted at last graceful shutdown and not warmed up yet;
+    uint32_t warmup_saved_extents_{0};             // persisted at last graceful shutdown;
+
+    iomgr::timer_handle_t vol_clean_timer_hdl_{iomgr::null_timer_handle};
+    std::atomic< bool > clean_running_{false}; // previous cleaner round is still in flight;
 
 public:
     // static uint64_t _hs_chunk_size;
@@ -118,6 +170,8 @@ public:
 
     uint64_t max_vol_io_size() const final { return MAX_VOL_IO_SIZE; }
 
+    uint32_t io_buf_align() const final { return IO_BUF_ALIGN; }
+
     void shutdown() final;
 
     /// VolumeManager
@@ -129,10 +183,20 @@ public:
 
     NullAsyncResult write(const VolumePtr& vol, const vol_interface_req_ptr& req) final;
 
+    NullAsyncResult atomic_write(const VolumePtr& vol, const std::vector< vol_interface_req_ptr >& reqs) final;
+
+    NullAsyncResult flush(const VolumePtr& vol) final;
+
     NullAsyncResult read(const VolumePtr& vol, const vol_interface_req_ptr& req) final;
 
     NullAsyncResult unmap(const VolumePtr& vol, const vol_interface_req_ptr& req) final;
 
+    NullAsyncResult advise(const VolumePtr& vol, lba_t lba, lba_count_t nlbas, vol_advice advice) final;
+
+    NullResult register_io_buffer(uint8_t const* buf, uint64_t size) final;
+
+    void unregister_io_buffer(uint8_t const* buf) final;
+
     // Submit the io batch, which is a mandatory method to be called if read/write are issued
     // with part_of_batchis set to true.
     void submit_io_batch() final;
@@ -142,7 +206,7 @@ public:
     void get_volume_ids(std::vector< volume_id_t >& vol_ids) const final;
 
     // Index
-    shared< hs_index_table_t > recover_index_table(homestore::superblk< homestore::index_table_sb >&& sb);
+    shared< homestore::IndexTableBase > recover_index_table(homestore::superblk< homestore::index_table_sb >&& sb);
 
     // HomeStore
     void init_homestore();
@@ -155,8 +219,38 @@ public:
     void on_write(int64_t lsn, const sisl::blob& header, const sisl::blob& key,
                   const std::vector< homestore::MultiBlkId >& blkids, cintrusive< homestore::repl_req_ctx >& ctx);
 
+    void on_inline_write(int64_t lsn, const sisl::blob& header, const sisl::blob& key,
+                         cintrusive< homestore::repl_req_ctx >& ctx);
+
+    //
+    // Journal shared by volumes with shared_journal, so that their journal records share log flushes. It is created
+    // if asked and not there yet. Its group id is derived from our uuid, so that it is found again after restart.
+    //
+    ReplDevPtr group_journal(bool create = false);
+    homestore::group_id_t group_journal_id() const;
+
+    // Destage all the inline written pages pending now on all volumes, called in cp flush and shutdown;
+    folly::Future< bool > flush_inline_writes();
+
     void start_reaper_thread();
 
+    void start_scrub_timer();
+
+    void start_destage_timer();
+
+    void start_tier_migrate_timer();
+
+    // Submit journal entries of writes acked in write back mode, once there is a write_back_ack volume.
+    void start_group_commit_timer();
+
+    // Warm up the extents persisted at last graceful shutdown at a bounded rate, if any.
+    void start_warmup_timer();
+    uint32_t warmup_saved_extents() const;
+    uint64_t warmup_pending_extents() const;
+
+    // Clean chunks of log structured volumes at a bounded rate, only with log_structured_on.
+    void start_cleaner_timer();
+
     void fault_containment(const VolumePtr vol, const std::string& reason = "");
     bool fc_on() const;
     void exit_fc(VolumePtr& vol);
@@ -164,6 +258,10 @@ public:
     hs_chunk_size_cfg_t get_chunk_size() const;
     bool is_graceful_shutdown() const { return gracefully_shutdown_; }
 
+    // Read cache on fast device shared by volumes on HDD data device, null if there is none.
+    L2ReadCache* l2_cache() const { return l2_cache_.get(); }
+    void enable_l2_cache(uint64_t capacity_bytes);
+
 public:
     // public static APIs;
     static shared< HomeBlocksImpl > instance() { return s_instance_; }
@@ -190,11 +288,51 @@ private:
     // recovery apis
     void on_hb_meta_blk_found(sisl::byte_view const& buf, void* cookie);
     void on_vol_meta_blk_found(sisl::byte_view const& buf, void* cookie);
+    void on_warmup_meta_blk_found(sisl::byte_view const& buf, void* cookie);
 
     void vol_gc();
 
     uint64_t gc_timer_nsecs() const;
 
+    void vol_scrub();
+
+    void vol_destage();
+
+    void vol_tier_migrate();
+
+    void vol_group_commit();
+
+    void vol_warmup();
+
+    void vol_clean();
+
+    void save_warmup_extents();
+
+    bool use_inline_write(const VolumePtr& vol, const vol_interface_req_ptr& req) const;
+
+    // Issue an IO larger than MAX_VOL_SUB_IO_SIZE as sub IOs split at MAX_VOL_SUB_IO_SIZE aligned offsets, all at once.
+    // The IO completes once all of them do, with the first error if any failed.
+    NullAsyncResult split_io(const VolumePtr& vol, const vol_interface_req_ptr& req,
+                             folly::Function< NullAsyncResult(const vol_interface_req_ptr&) >&& issue);
+
+    // Write the pages of req, inline in the journal or to data device. Caller holds the range lock of the pages.
+    NullAsyncResult issue_write(const VolumePtr& vol, const vol_interface_req_ptr& req);
+
+    // Read and write of volumes with sectors smaller than pages, req is in unit of sectors. Writes of part of a page
+    // are merged into it by read-modify-write, see PartialPageMerger.
+    NullAsyncResult write_sectors(const VolumePtr& vol, const vol_interface_req_ptr& req);
+    NullAsyncResult read_modify_write(const VolumePtr& vol, std::shared_ptr< partial_write_t > const& pw);
+    NullAsyncResult read_sectors(const VolumePtr& vol, const vol_interface_req_ptr& req);
+
+    // Swap an unaligned buffer of req for a bounce buffer until the io completes. Returns the buffer of the application
+    // to be restored after, nullptr if the buffer was aligned already, or an error if no bounce buffer is available.
+    Result< uint8_t* > bounce_io_buffer(const vol_interface_req_ptr& req, uint64_t size, bool copy_in);
+    void restore_io_buffer(const vol_interface_req_ptr& req, uint8_t* app_buf, uint64_t size, bool copy_out);
+
+    // Commit a single write entry of the journal key, returns where the next entry starts.
+    uint8_t const* on_write_entry(int64_t lsn, const sisl::blob& header, const VolumePtr& vol_ptr,
+                                  uint8_t const* key_buffer, PageBlkIdIter& blkid_iter, bool is_recovery);
+
     void inc_ref(uint64_t n = 1) { outstanding_reqs_.increment(n); }
     void dec_ref(uint64_t n = 1) { outstanding_reqs_.decrement(n); }
     bool is_shutting_down() const { return shutdown_started_; }
@@ -259,4 +397,25 @@ private:
     HomeBlocksImpl* hb_;
 };
 
+//
+// Inline written pages are only persisted in journal until destaged. Destage them in cp flush, so that the journal
+// entries are not truncated before their pages are in index. This relies on homestore flushing the replication
+// service consumer, which truncates the log, after the client consumer.
+//
+class HBCPCallbacks : public homestore::CPCallbacks {
+public:
+    HBCPCallbacks(HomeBlocksImpl* hb) : hb_(hb) {}
+    virtual ~HBCPCallbacks() = default;
+
+    std::unique_ptr< homestore::CPContext > on_switchover_cp(homestore::CP* cur_cp, homestore::CP* new_cp) override {
+        return nullptr;
+    }
+    folly::Future< bool > cp_flush(homestore::CP* cp) override { return hb_->flush_inline_writes(); }
+    void cp_cleanup(homestore::CP* cp) override {}
+    int cp_progress_percent() override { return 100; }
+
+private:
+    HomeBlocksImpl* hb_;
+};
+
 } // namespace homeblocks
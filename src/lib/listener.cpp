@@ -26,8 +26,20 @@ void HBListener::on_commit(int64_t lsn, sisl::blob const& header, sisl::blob con
     const MsgHeader* msg_header = r_cast< const MsgHeader* >(header.cbytes());
     switch (msg_header->msg_type) {
     case MsgType::WRITE:
+    case MsgType::DESTAGE_WRITE:
+    case MsgType::ATOMIC_WRITE:
+        // Records of volumes removed since are left in the group journal until it is truncated, they are skipped in
+        // replay. Their new blks were in the chunks of the removed volume, which are released along with it.
+        if (!ctx && group_id_ != msg_header->volume_id && !hb_->lookup_volume(msg_header->volume_id)) {
+            LOGW("Skipping replay of group journal record lsn: {} of removed volume: {}", lsn,
+                 boost::uuids::to_string(msg_header->volume_id));
+            break;
+        }
         hb_->on_write(lsn, header, key, blkids, ctx);
         break;
+    case MsgType::INLINE_WRITE:
+        hb_->on_inline_write(lsn, header, key, ctx);
+        break;
 
     case MsgType::READ:
         break;
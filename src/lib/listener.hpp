@@ -29,7 +29,7 @@ class HomeBlocksImpl;
 
 class HBListener : public homestore::ReplDevListener {
 public:
-    explicit HBListener(HomeBlocksImpl* hb) : hb_(hb) {}
+    HBListener(HomeBlocksImpl* hb, homestore::group_id_t group_id) : hb_(hb), group_id_(group_id) {}
 
     ~HBListener() = default;
 
@@ -79,5 +79,6 @@ public:
 
 private:
     HomeBlocksImpl* hb_{nullptr};
+    homestore::group_id_t group_id_; // volume id, or the group journal's id for records of many volumes;
 };
 } // namespace homeblocks
@@ -0,0 +1,74 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <functional>
+#include "access_tracker.hpp"
+
+namespace homeblocks {
+
+void AccessTracker::record(lba_t start_lba, lba_count_t nlbas) {
+    auto const first = start_lba / extent_pages_;
+    auto const last = (start_lba + nlbas - 1) / extent_pages_;
+    std::scoped_lock lg(mtx_);
+    for (auto ext = first; ext <= last; ++ext) {
+        auto it = heat_.find(ext);
+        if (it != heat_.end()) {
+            ++it->second;
+        } else if (heat_.size() < MAX_TRACKED_EXTENTS) {
+            heat_.emplace(ext, 1);
+        }
+    }
+}
+
+void AccessTracker::decay() {
+    std::scoped_lock lg(mtx_);
+    std::erase_if(heat_, [](auto& kv) { return (kv.second >>= 1) == 0; });
+}
+
+std::vector< lba_t > AccessTracker::pick_hot(uint32_t max_extents, uint32_t min_heat) {
+    std::vector< std::pair< uint32_t, uint64_t > > hot;
+    std::scoped_lock lg(mtx_);
+    for (auto const& [ext, heat] : heat_) {
+        if (heat >= min_heat) { hot.emplace_back(heat, ext); }
+    }
+
+    auto const n = std::min< size_t >(max_extents, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + n, hot.end(), std::greater<>{});
+    std::vector< lba_t > start_lbas;
+    for (size_t i = 0; i < n; ++i) {
+        heat_.erase(hot[i].second);
+        start_lbas.push_back(hot[i].second * extent_pages_);
+    }
+    return start_lbas;
+}
+
+uint32_t AccessTracker::max_heat(lba_t start_lba, lba_count_t nlbas) const {
+    auto const first = start_lba / extent_pages_;
+    auto const last = (start_lba + nlbas - 1) / extent_pages_;
+    uint32_t heat{0};
+    std::scoped_lock lg(mtx_);
+    for (auto ext = first; ext <= last; ++ext) {
+        auto it = heat_.find(ext);
+        if (it != heat_.end()) { heat = std::max(heat, it->second); }
+    }
+    return heat;
+}
+
+uint64_t AccessTracker::num_extents() const {
+    std::scoped_lock lg(mtx_);
+    return heat_.size();
+}
+
+} // namespace homeblocks
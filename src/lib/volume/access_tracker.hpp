@@ -0,0 +1,55 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+//
+// Access frequency of a volume's lba extents, each extent covering extent_pages pages. Reads are tracked for tiering
+// and warmup, overwrites for hot/cold separation. Heat of an extent is bumped on every access touching it and halved
+// on every decay, so it tracks recent accesses. Number of tracked extents is bounded, accesses of new extents are not
+// tracked once full until cold extents are dropped by decay.
+//
+class AccessTracker {
+    static constexpr uint64_t MAX_TRACKED_EXTENTS = 64 * 1024;
+
+public:
+    explicit AccessTracker(uint32_t extent_pages) : extent_pages_{extent_pages} {}
+
+    void record(lba_t start_lba, lba_count_t nlbas);
+    void decay();
+
+    // Pick start lbas of at most max_extents extents with heat of at least min_heat, hottest first. Picked extents
+    // are forgotten, they have to heat up again to be picked next time.
+    std::vector< lba_t > pick_hot(uint32_t max_extents, uint32_t min_heat);
+
+    // Highest heat of the extents touched by [start_lba, start_lba + nlbas).
+    uint32_t max_heat(lba_t start_lba, lba_count_t nlbas) const;
+
+    uint32_t extent_pages() const { return extent_pages_; }
+    uint64_t num_extents() const;
+
+private:
+    uint32_t const extent_pages_;
+    mutable std::mutex mtx_;
+    std::unordered_map< uint64_t, uint32_t > heat_; // extent index -> heat;
+};
+
+} // namespace homeblocks
@@ -0,0 +1,92 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <bit>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sisl/logging/logging.h>
+#include "bounce_buffer_pool.hpp"
+
+namespace homeblocks {
+
+BounceBufferPool::BounceBufferPool(uint32_t align, uint64_t capacity_bytes) : align_{align} {
+    if (capacity_bytes == 0) { return; }
+    auto const size = (capacity_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    auto region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region == MAP_FAILED) {
+        // No hugepages reserved, ask for transparent hugepages instead.
+        region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region != MAP_FAILED) { madvise(region, size, MADV_HUGEPAGE); }
+    }
+    if (region == MAP_FAILED) {
+        LOGW("Failed to map bounce buffer pool of {} bytes, bounce buffers are allocated on heap", size);
+        return;
+    }
+    region_ = static_cast< uint8_t* >(region);
+    capacity_ = size;
+    LOGI("Bounce buffer pool of {} bytes mapped, align: {}", capacity_, align_);
+}
+
+BounceBufferPool::~BounceBufferPool() {
+    if (region_) { munmap(region_, capacity_); }
+}
+
+uint32_t BounceBufferPool::size_class(uint64_t size) {
+    return std::bit_width(std::max(size, MIN_BUF_SIZE) - 1) - std::bit_width(MIN_BUF_SIZE - 1);
+}
+
+uint8_t* BounceBufferPool::get(uint64_t size) {
+    COUNTER_INCREMENT(metrics_, bounce_buffer_get_count, 1);
+    COUNTER_INCREMENT(metrics_, bounce_buffer_size_total, size);
+    if (size > MAX_BUF_SIZE) { return heap_alloc(size); }
+
+    auto const cls = size_class(size);
+    {
+        auto& free_list = free_lists_[cls];
+        std::scoped_lock lg(free_list.mtx);
+        if (!free_list.bufs.empty()) {
+            auto buf = free_list.bufs.back();
+            free_list.bufs.pop_back();
+            return buf;
+        }
+    }
+
+    // Buffers carved out of the region are never given back to it, only reused from free lists.
+    auto const buf_size = MIN_BUF_SIZE << cls;
+    auto used = used_.load();
+    do {
+        if (used + buf_size > capacity_) { return heap_alloc(buf_size); }
+    } while (!used_.compare_exchange_weak(used, used + buf_size));
+    GAUGE_UPDATE(metrics_, bounce_buffer_pool_used_size, used + buf_size);
+    return region_ + used;
+}
+
+void BounceBufferPool::put(uint8_t* buf, uint64_t size) {
+    if (!owns(buf)) {
+        std::free(buf);
+        return;
+    }
+    auto& free_list = free_lists_[size_class(size)];
+    std::scoped_lock lg(free_list.mtx);
+    free_list.bufs.push_back(buf);
+}
+
+uint8_t* BounceBufferPool::heap_alloc(uint64_t size) {
+    COUNTER_INCREMENT(metrics_, bounce_buffer_heap_alloc_count, 1);
+    auto buf = static_cast< uint8_t* >(std::aligned_alloc(align_, (size + align_ - 1) / align_ * align_));
+    if (!buf) { LOGE("Failed to allocate bounce buffer of {} bytes on heap", size); }
+    return buf;
+}
+
+} // namespace homeblocks
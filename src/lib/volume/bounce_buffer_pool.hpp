@@ -0,0 +1,85 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <sisl/metrics/metrics.hpp>
+#include <homeblks/common.hpp>
+
+namespace homeblocks {
+
+class BounceBufferMetrics : public sisl::MetricsGroupWrapper {
+public:
+    explicit BounceBufferMetrics() : sisl::MetricsGroupWrapper("BounceBufferPool", "homeblks") {
+        REGISTER_COUNTER(bounce_buffer_get_count, "Total IOs of unaligned buffers bounced through aligned buffers");
+        REGISTER_COUNTER(bounce_buffer_size_total, "Total data size of IOs bounced through aligned buffers");
+        REGISTER_COUNTER(bounce_buffer_heap_alloc_count, "Total bounce buffers allocated on heap as pool ran out");
+        REGISTER_GAUGE(bounce_buffer_pool_used_size, "Size of the pool carved into bounce buffers");
+
+        register_me_to_farm();
+    }
+
+    BounceBufferMetrics(const BounceBufferMetrics&) = delete;
+    BounceBufferMetrics(BounceBufferMetrics&&) noexcept = delete;
+    BounceBufferMetrics& operator=(const BounceBufferMetrics&) = delete;
+    BounceBufferMetrics& operator=(BounceBufferMetrics&&) noexcept = delete;
+    ~BounceBufferMetrics() { deregister_me_from_farm(); }
+};
+
+//
+// Aligned buffers to bounce data of IOs issued with buffers not aligned for direct IO. The pool is a hugepage backed
+// region carved into power of two sized buffers on demand. Buffers put back are kept in a free list per size class
+// shared by all reactors, as buffers are often put back on a completion thread other than the one they were got on.
+// Once the region is used up, buffers are allocated on heap.
+//
+class BounceBufferPool {
+    static constexpr uint64_t MIN_BUF_SIZE = 4 * Ki;
+    static constexpr uint64_t MAX_BUF_SIZE = 1 * Mi; // same as volume sub io size;
+    static constexpr uint32_t NUM_SIZE_CLASSES = 9;  // MIN_BUF_SIZE to MAX_BUF_SIZE;
+    static constexpr uint64_t HUGE_PAGE_SIZE = 2 * Mi;
+
+public:
+    BounceBufferPool(uint32_t align, uint64_t capacity_bytes);
+    ~BounceBufferPool();
+
+    bool is_aligned(uint8_t const* buf) const { return (reinterpret_cast< uintptr_t >(buf) & (align_ - 1)) == 0; }
+
+    // Aligned buffer of at least size bytes, put back with the same size. nullptr if it can't be allocated.
+    uint8_t* get(uint64_t size);
+    void put(uint8_t* buf, uint64_t size);
+
+private:
+    static uint32_t size_class(uint64_t size);
+    bool owns(uint8_t const* buf) const { return buf >= region_ && buf < region_ + capacity_; }
+    uint8_t* heap_alloc(uint64_t size);
+
+private:
+    struct FreeList {
+        std::mutex mtx; // held only to push or pop a buffer;
+        std::vector< uint8_t* > bufs;
+    };
+
+    uint32_t const align_;
+    uint64_t capacity_{0};
+    uint8_t* region_{nullptr};
+    std::atomic< uint64_t > used_{0}; // size of the region carved into buffers so far;
+    std::array< FreeList, NUM_SIZE_CLASSES > free_lists_;
+    BounceBufferMetrics metrics_;
+};
+
+} // namespace homeblocks
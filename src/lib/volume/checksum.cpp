@@ -0,0 +1,112 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include "checksum.hpp"
+
+#include <array>
+#include <cstring>
+#include <homestore/crc.h>
+#include <xxhash.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace homeblocks {
+static constexpr homestore::csum_t init_crc_16 = 0x8005;
+static constexpr uint32_t crc32c_poly = 0x82f63b78;  // reflected Castagnoli polynomial
+static constexpr uint8_t wide_index_uuid_ver = 0xc0; // uuid version 12, not defined by RFC 9562
+
+static constexpr auto crc32c_table = []() {
+    std::array< uint32_t, 256 > table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; ++j) {
+            crc = (crc & 1) ? (crc >> 1) ^ crc32c_poly : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+static uint32_t crc32c_sw(uint32_t crc, uint8_t const* buf, size_t size) {
+    while (size--) {
+        crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_hw(uint32_t crc, uint8_t const* buf, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), buf += sizeof(uint64_t)) {
+        uint64_t v;
+        std::memcpy(&v, buf, sizeof(uint64_t));
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = static_cast< uint32_t >(crc64);
+    while (size--) {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint8_t const* buf, size_t size) {
+#if defined(__x86_64__)
+    static bool const has_sse42 = __builtin_cpu_supports("sse4.2");
+    if (has_sse42) { return ~crc32c_hw(~0u, buf, size); }
+#endif
+    return ~crc32c_sw(~0u, buf, size);
+}
+
+uint32_t checksum_size(vol_checksum_type type) {
+    switch (type) {
+    case vol_checksum_type::NONE:
+        return 0;
+    case vol_checksum_type::CRC16:
+        return sizeof(homestore::csum_t);
+    case vol_checksum_type::CRC32C:
+    case vol_checksum_type::XXH3:
+    default:
+        return sizeof(vol_csum_t);
+    }
+}
+
+bool is_wide_checksum(vol_checksum_type type) { return checksum_size(type) > sizeof(homestore::csum_t); }
+
+boost::uuids::uuid wide_checksum_index_uuid(boost::uuids::uuid uuid) {
+    // Version is the high nibble of octet 6.
+    uuid.data[6] = (uuid.data[6] & 0x0f) | wide_index_uuid_ver;
+    return uuid;
+}
+
+bool is_wide_checksum_index(boost::uuids::uuid const& uuid) { return (uuid.data[6] & 0xf0) == wide_index_uuid_ver; }
+
+vol_csum_t compute_checksum(vol_checksum_type type, uint8_t const* buf, uint32_t size) {
+    switch (type) {
+    case vol_checksum_type::NONE:
+        return 0;
+    case vol_checksum_type::CRC16:
+        return crc16_t10dif(init_crc_16, buf, size);
+    case vol_checksum_type::CRC32C:
+        return crc32c(buf, size);
+    case vol_checksum_type::XXH3:
+        return static_cast< vol_csum_t >(XXH3_64bits(buf, size));
+    default:
+        RELEASE_ASSERT(false, "Unknown checksum type {}", static_cast< uint8_t >(type));
+        return 0;
+    }
+}
+
+} // namespace homeblocks
@@ -0,0 +1,44 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+// Checksum of a data block. It is sized for the widest checksum we support, narrower ones are zero extended. Journal
+// entries only carry checksum_size() bytes per lba and index values of volumes with 16 bit checksums keep 16 bits.
+using vol_csum_t = uint32_t;
+
+// Number of bytes of checksum stored per lba in journal entry for the given checksum type.
+uint32_t checksum_size(vol_checksum_type type);
+
+// Whether checksums of the given type are wider than the 16 bits index values of older releases hold.
+bool is_wide_checksum(vol_checksum_type type);
+
+// Index values are laid out by the width of their checksum, which has to be known when homestore recovers the index
+// table, before volume superblks are loaded. Tables holding wide checksums are told apart by the version field of
+// their uuid, random uuids of the other tables are always version 4.
+boost::uuids::uuid wide_checksum_index_uuid(boost::uuids::uuid uuid);
+bool is_wide_checksum_index(boost::uuids::uuid const& uuid);
+
+vol_csum_t compute_checksum(vol_checksum_type type, uint8_t const* buf, uint32_t size);
+
+// crc32c (Castagnoli polynomial), with the standard ~0 initial value and final xor.
+uint32_t crc32c(uint8_t const* buf, size_t size);
+
+} // namespace homeblocks
@@ -0,0 +1,67 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include "compression.hpp"
+
+#include <cstring>
+#include <lz4.h>
+
+namespace homeblocks {
+
+uint32_t compress_page(vol_compression_type type, uint8_t const* page, uint32_t page_size, uint8_t* out,
+                       uint32_t blk_size) {
+    if (page_size <= blk_size) { return 0; }
+    auto const max_compressed = static_cast< int >(page_size - blk_size - sizeof(vol_compressed_hdr));
+
+    auto const src = reinterpret_cast< char const* >(page);
+    auto const dst = reinterpret_cast< char* >(out + sizeof(vol_compressed_hdr));
+    int compressed_size{0};
+    switch (type) {
+    case vol_compression_type::LZ4:
+        compressed_size = LZ4_compress_default(src, dst, static_cast< int >(page_size), max_compressed);
+        break;
+    case vol_compression_type::NONE:
+    default:
+        return 0;
+    }
+    // doesn't fit in one blk less than the page;
+    if (compressed_size <= 0) { return 0; }
+
+    vol_compressed_hdr hdr{static_cast< uint32_t >(compressed_size)};
+    std::memcpy(out, &hdr, sizeof(vol_compressed_hdr));
+    auto const size = static_cast< uint32_t >(sizeof(vol_compressed_hdr) + compressed_size);
+    auto const stored_size = (size + blk_size - 1) / blk_size * blk_size;
+    std::memset(out + size, 0, stored_size - size);
+    return stored_size;
+}
+
+bool decompress_page(vol_compression_type type, uint8_t const* stored, uint32_t stored_size, uint8_t* page,
+                     uint32_t page_size) {
+    vol_compressed_hdr hdr;
+    std::memcpy(&hdr, stored, sizeof(vol_compressed_hdr));
+    if (hdr.compressed_size > stored_size - sizeof(vol_compressed_hdr)) { return false; }
+
+    auto const src = reinterpret_cast< char const* >(stored + sizeof(vol_compressed_hdr));
+    auto const dst = reinterpret_cast< char* >(page);
+    switch (type) {
+    case vol_compression_type::LZ4:
+        return LZ4_decompress_safe(src, dst, static_cast< int >(hdr.compressed_size), static_cast< int >(page_size)) ==
+            static_cast< int >(page_size);
+    case vol_compression_type::NONE:
+    default:
+        return false;
+    }
+}
+
+} // namespace homeblocks
@@ -0,0 +1,37 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+// A compressed page is stored as its compressed length followed by the compressed bytes, zero padded to whole blks. A
+// page is only stored compressed if it saves at least one blk, so a blkid shorter than a page means compressed.
+struct vol_compressed_hdr {
+    uint32_t compressed_size;
+};
+
+// Compress page into out, which has room for page_size - blk_size bytes. Returns the stored size rounded up to
+// blk_size, or 0 if the page doesn't compress enough to save a blk.
+uint32_t compress_page(vol_compression_type type, uint8_t const* page, uint32_t page_size, uint8_t* out,
+                       uint32_t blk_size);
+
+// Decompress a stored page of stored_size bytes into page. Returns false if the stored page is malformed.
+bool decompress_page(vol_compression_type type, uint8_t const* stored, uint32_t stored_size, uint8_t* page,
+                     uint32_t page_size);
+
+} // namespace homeblocks
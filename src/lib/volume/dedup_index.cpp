@@ -0,0 +1,85 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <xxhash.h>
+#include "dedup_index.hpp"
+
+namespace homeblocks {
+
+dedup_hash_t compute_dedup_hash(uint8_t const* buf, uint32_t size) {
+    auto const h = XXH3_128bits(buf, size);
+    return dedup_hash_t{h.low64, h.high64};
+}
+
+std::optional< dedup_blk_t > DedupIndex::acquire(dedup_hash_t const& hash) {
+    std::scoped_lock lg(mtx_);
+    auto it = entries_.find(hash);
+    if (it == entries_.end()) { return std::nullopt; }
+
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+    ++extra_refs_[it->second.blk.blkid.to_integer()];
+    return it->second.blk;
+}
+
+void DedupIndex::add_ref(homestore::BlkId const& blkid, uint32_t n) {
+    std::scoped_lock lg(mtx_);
+    extra_refs_[blkid.to_integer()] += n;
+}
+
+bool DedupIndex::release(homestore::BlkId const& blkid) {
+    auto const key = blkid.to_integer();
+    std::scoped_lock lg(mtx_);
+    auto ref_it = extra_refs_.find(key);
+    if (ref_it != extra_refs_.end()) {
+        if (--ref_it->second == 0) { extra_refs_.erase(ref_it); }
+        return false;
+    }
+
+    // Last reference, the blk is going to be freed and possibly reused, nobody can dedup against it anymore.
+    auto hash_it = blk_hashes_.find(key);
+    if (hash_it != blk_hashes_.end()) {
+        auto it = entries_.find(hash_it->second);
+        lru_.erase(it->second.lru_it);
+        entries_.erase(it);
+        blk_hashes_.erase(hash_it);
+    }
+    return true;
+}
+
+void DedupIndex::insert(dedup_hash_t const& hash, dedup_blk_t const& blk) {
+    std::scoped_lock lg(mtx_);
+    if (entries_.contains(hash)) { return; }
+
+    lru_.push_front(hash);
+    entries_.emplace(hash, Entry{blk, lru_.begin()});
+    blk_hashes_.emplace(blk.blkid.to_integer(), hash);
+    while (entries_.size() > max_entries_) {
+        auto it = entries_.find(lru_.back());
+        blk_hashes_.erase(it->second.blk.blkid.to_integer());
+        entries_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+uint64_t DedupIndex::num_entries() const {
+    std::scoped_lock lg(mtx_);
+    return entries_.size();
+}
+
+uint64_t DedupIndex::num_shared_blks() const {
+    std::scoped_lock lg(mtx_);
+    return extra_refs_.size();
+}
+
+} // namespace homeblocks
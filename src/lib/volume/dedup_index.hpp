@@ -0,0 +1,93 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <homestore/blk.h>
+#include "checksum.hpp"
+
+namespace homeblocks {
+
+// Content hash of a data page, xxh3 128 bits.
+struct dedup_hash_t {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(dedup_hash_t const& other) const = default;
+};
+
+struct dedup_hash_hasher {
+    size_t operator()(dedup_hash_t const& h) const { return h.low; }
+};
+
+dedup_hash_t compute_dedup_hash(uint8_t const* buf, uint32_t size);
+
+// Blk holding a page, with the checksum of what is stored in it as kept in index.
+struct dedup_blk_t {
+    homestore::BlkId blkid;
+    vol_csum_t checksum;
+};
+
+//
+// Deduplication state of a volume. Content hashes of recently written pages are kept in a bounded LRU cache, a page
+// with the same content as a cached one is mapped to its blkid instead of being written. Every lba mapped to a blkid
+// holds a reference on it, only references beyond the first one are tracked, so the blk is freed on overwrite of the
+// last lba mapping it. Lookup takes the reference under the same lock release drops it, so a blk found by lookup can't
+// be freed in between.
+//
+// Nothing of it is persisted. After a restart the cache starts empty, so pages written before are not deduped against
+// until written again, and references beyond the first one are recounted from index, see Volume::rebuild_dedup_refs.
+//
+class DedupIndex {
+    static constexpr uint64_t APPROX_ENTRY_SIZE = 96; // hash, blkid, lru node and hash map overheads;
+
+public:
+    explicit DedupIndex(uint64_t capacity_bytes) :
+            max_entries_{std::max(capacity_bytes / APPROX_ENTRY_SIZE, 1ul)} {}
+
+    // Blk of a page with the given content hash, with a reference taken for the caller. nullopt if not cached.
+    std::optional< dedup_blk_t > acquire(dedup_hash_t const& hash);
+
+    // Take n more references on a blkid, caller should be holding one already.
+    void add_ref(homestore::BlkId const& blkid, uint32_t n = 1);
+
+    // Drop a reference. Returns true if it was the last one, in which case caller frees the blk.
+    bool release(homestore::BlkId const& blkid);
+
+    // Remember content hash of a newly written page. Existing entry of the same hash is kept.
+    void insert(dedup_hash_t const& hash, dedup_blk_t const& blk);
+
+    uint64_t num_entries() const;
+    uint64_t num_shared_blks() const;
+
+private:
+    struct Entry {
+        dedup_blk_t blk;
+        std::list< dedup_hash_t >::iterator lru_it;
+    };
+
+    uint64_t const max_entries_;
+    mutable std::mutex mtx_;
+    std::list< dedup_hash_t > lru_; // most recently used in front;
+    std::unordered_map< dedup_hash_t, Entry, dedup_hash_hasher > entries_;
+    std::unordered_map< uint64_t, dedup_hash_t > blk_hashes_; // blkid -> hash, for blkids in entries_;
+    std::unordered_map< uint64_t, uint32_t > extra_refs_;     // blkid -> references beyond the first one;
+};
+
+} // namespace homeblocks
@@ -5,6 +5,7 @@
 #include <homestore/index/index_internal.hpp>
 #include <homestore/blk.h>
 #include <sisl/fds/buffer.hpp>
+#include "checksum.hpp"
 
 using homestore::BlkId;
 using homestore::BtreeKey;
@@ -17,8 +18,8 @@ struct BlockInfo {
     // Checksum calculated on new data and written to new_blkid.
     homestore::BlkId new_blkid;
     homestore::BlkId old_blkid;
-    homestore::csum_t new_checksum;
-    homestore::csum_t old_checksum{0};
+    vol_csum_t new_checksum;
+    vol_csum_t old_checksum{0};
 };
 
 class VolumeIndexKey : public homestore::BtreeKey {
@@ -97,61 +98,67 @@ public:
     }
 };
 
-class VolumeIndexValue : public homestore::BtreeValue {
+// Index value with checksum of type CsumT. Volumes with checksums wider than 16 bits store vol_csum_t, the others keep
+// the 16 bit checksum of older releases. Values queried are handed out as VolumeIndexValue.
+template < typename CsumT >
+class VolumeIndexValueT : public homestore::BtreeValue {
 private:
 #pragma pack(1)
     // Store blkid and checksum as the value.
     BlkId m_blkid;
-    homestore::csum_t m_checksum;
+    CsumT m_checksum;
 #pragma pack()
 
 public:
-    VolumeIndexValue(const BlkId& base_blkid, homestore::csum_t csum) :
-            homestore::BtreeValue(), m_blkid(base_blkid), m_checksum(csum) {}
-    VolumeIndexValue(const BlkId& base_blkid) : VolumeIndexValue(base_blkid, 0) {}
-    VolumeIndexValue() = default;
-    VolumeIndexValue(const VolumeIndexValue& other) :
+    VolumeIndexValueT(const BlkId& base_blkid, vol_csum_t csum) :
+            homestore::BtreeValue(), m_blkid(base_blkid), m_checksum(static_cast< CsumT >(csum)) {}
+    VolumeIndexValueT(const BlkId& base_blkid) : VolumeIndexValueT(base_blkid, 0) {}
+    VolumeIndexValueT() = default;
+    VolumeIndexValueT(const VolumeIndexValueT& other) :
             homestore::BtreeValue(), m_blkid(other.m_blkid), m_checksum(other.m_checksum) {}
-    VolumeIndexValue(const sisl::blob& b, bool copy) : homestore::BtreeValue() { this->deserialize(b, copy); }
-    virtual ~VolumeIndexValue() = default;
+    VolumeIndexValueT(const sisl::blob& b, bool copy) : homestore::BtreeValue() { this->deserialize(b, copy); }
+    virtual ~VolumeIndexValueT() = default;
 
     homestore::BlkId blkid() const { return m_blkid; }
 
-    homestore::csum_t checksum() const { return m_checksum; }
+    vol_csum_t checksum() const { return m_checksum; }
 
     ///////////////////////////// Overriding methods of BtreeValue //////////////////////////
-    VolumeIndexValue& operator=(const VolumeIndexValue& other) = default;
+    VolumeIndexValueT& operator=(const VolumeIndexValueT& other) = default;
     sisl::blob serialize() const override {
-        sisl::blob b{r_cast< uint8_t const* >(this), sizeof(VolumeIndexValue)};
+        sisl::blob b{r_cast< uint8_t const* >(this), sizeof(VolumeIndexValueT)};
         return b;
     }
 
-    uint32_t serialized_size() const override { return sizeof(VolumeIndexValue); }
-    static uint32_t get_fixed_size() { return sizeof(VolumeIndexValue); }
+    uint32_t serialized_size() const override { return sizeof(VolumeIndexValueT); }
+    static uint32_t get_fixed_size() { return sizeof(VolumeIndexValueT); }
     void deserialize(const sisl::blob& b, bool) {
-        VolumeIndexValue const* other = r_cast< VolumeIndexValue const* >(b.cbytes());
+        VolumeIndexValueT const* other = r_cast< VolumeIndexValueT const* >(b.cbytes());
         m_blkid = other->m_blkid;
         m_checksum = other->m_checksum;
     }
 
     std::string to_string() const override { return fmt::format("{} csum={}", blkid().to_string(), m_checksum); }
 
-    friend std::ostream& operator<<(std::ostream& os, const VolumeIndexValue& v) {
+    friend std::ostream& operator<<(std::ostream& os, const VolumeIndexValueT& v) {
         os << v.to_string();
         return os;
     }
 
-    friend std::istream& operator>>(std::istream& is, VolumeIndexValue& v) {
+    friend std::istream& operator>>(std::istream& is, VolumeIndexValueT& v) {
         uint32_t base_val;
         uint32_t offset;
         char dummy;
         is >> base_val >> dummy >> offset;
-        v = VolumeIndexValue{BlkId{}};
+        v = VolumeIndexValueT{BlkId{}};
         return is;
     }
 
-    bool operator==(VolumeIndexValue const& other) const {
+    bool operator==(VolumeIndexValueT const& other) const {
         return ((m_blkid == other.m_blkid) && (m_checksum == other.m_checksum));
     }
 };
+
+using VolumeIndexValue = VolumeIndexValueT< vol_csum_t >;
+using VolumeIndexValue16 = VolumeIndexValueT< homestore::csum_t >;
 } // namespace homeblocks
\ No newline at end of file
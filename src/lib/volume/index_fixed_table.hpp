@@ -9,26 +9,101 @@ static const auto btree_int_node_type = homestore::btree_node_type::FIXED;
 
 using index_kv_list_t = std::vector< std::pair< VolumeIndexKey, VolumeIndexValue > >;
 using hs_index_table_t = homestore::IndexTable< VolumeIndexKey, VolumeIndexValue >;
+using hs_index_table16_t = homestore::IndexTable< VolumeIndexKey, VolumeIndexValue16 >;
 
+// Index table of a volume. Only one of the homestore tables is set, by the width of the checksums of the volume.
 class VolumeIndexTable {
     std::shared_ptr< hs_index_table_t > hs_index_table_;
+    std::shared_ptr< hs_index_table16_t > hs_index_table16_;
 
 public:
     template < typename... Args >
-    VolumeIndexTable(Args&&... args) :
-            hs_index_table_(std::make_shared< hs_index_table_t >(std::forward< Args >(args)...)) {
-        LOGINFO("Created Fixed Index table, uuid {}", boost::uuids::to_string(hs_index_table_->uuid()));
+    VolumeIndexTable(bool wide_checksum, Args&&... args) {
+        if (wide_checksum) {
+            hs_index_table_ = std::make_shared< hs_index_table_t >(std::forward< Args >(args)...);
+        } else {
+            hs_index_table16_ = std::make_shared< hs_index_table16_t >(std::forward< Args >(args)...);
+        }
+        auto const uuid = wide_checksum ? hs_index_table_->uuid() : hs_index_table16_->uuid();
+        LOGINFO("Created Fixed Index table, uuid {} wide_checksum {}", boost::uuids::to_string(uuid), wide_checksum);
+    }
+
+    std::shared_ptr< homestore::IndexTableBase > index_table() {
+        if (hs_index_table_) { return hs_index_table_; }
+        return hs_index_table16_;
     }
 
-    std::shared_ptr< hs_index_table_t > index_table() { return hs_index_table_; }
+    bool wide_checksum() const { return hs_index_table_ != nullptr; }
 
     VolumeManager::Result< folly::Unit > write_to_index(lba_t start_lba, lba_t end_lba,
                                                         std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+        if (hs_index_table_) { return write_to_index(*hs_index_table_, start_lba, end_lba, blocks_info); }
+        return write_to_index(*hs_index_table16_, start_lba, end_lba, blocks_info);
+    }
+
+    VolumeManager::NullResult read_from_index(const vol_interface_req_ptr& req, index_kv_list_t& index_kvs) {
+        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
+            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{req->lba}, VolumeIndexKey{req->end_lba()}},
+            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY};
+        if (auto ret = query(qreq, index_kvs); ret != homestore::btree_status_t::success) {
+            return std::unexpected(VolumeError::INDEX_ERROR);
+        }
+        return {};
+    }
+
+    // Query at most max_entries mapped lbas within [start_lba, end_lba]. Returns true if there are more mapped lbas in
+    // the range after the last returned one.
+    VolumeManager::Result< bool > query_range(lba_t start_lba, lba_t end_lba, uint32_t max_entries,
+                                              index_kv_list_t& index_kvs) {
+        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
+            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{start_lba}, VolumeIndexKey{end_lba}},
+            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, max_entries};
+        auto ret = query(qreq, index_kvs);
+        if (ret == homestore::btree_status_t::has_more) { return true; }
+        if (ret != homestore::btree_status_t::success) { return std::unexpected(VolumeError::INDEX_ERROR); }
+        return false;
+    }
+
+    void rollback_write(lba_t start_lba, lba_t end_lba, std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+        if (hs_index_table_) {
+            rollback_write(*hs_index_table_, start_lba, end_lba, blocks_info);
+        } else {
+            rollback_write(*hs_index_table16_, start_lba, end_lba, blocks_info);
+        }
+    }
+
+    void destroy() {
+        homestore::hs()->index_service().remove_index_table(index_table());
+        if (hs_index_table_) {
+            hs_index_table_->destroy();
+        } else {
+            hs_index_table16_->destroy();
+        }
+    }
+
+private:
+    homestore::btree_status_t query(homestore::BtreeQueryRequest< VolumeIndexKey >& qreq, index_kv_list_t& index_kvs) {
+        if (hs_index_table_) { return hs_index_table_->query(qreq, index_kvs); }
+
+        // Values with 16 bit checksums are handed out widened.
+        std::vector< std::pair< VolumeIndexKey, VolumeIndexValue16 > > kvs;
+        auto ret = hs_index_table16_->query(qreq, kvs);
+        index_kvs.reserve(index_kvs.size() + kvs.size());
+        for (auto const& [key, value] : kvs) {
+            index_kvs.emplace_back(key, VolumeIndexValue{value.blkid(), value.checksum()});
+        }
+        return ret;
+    }
+
+    template < typename ValueT >
+    VolumeManager::Result< folly::Unit > write_to_index(homestore::IndexTable< VolumeIndexKey, ValueT >& tbl,
+                                                        lba_t start_lba, lba_t end_lba,
+                                                        std::unordered_map< lba_t, BlockInfo >& blocks_info) {
         // Use filter callback to get the old blkid.
         homestore::put_filter_cb_t filter_cb = [&blocks_info](BtreeKey const& key, BtreeValue const& existing_value,
                                                               BtreeValue const& value) {
             auto lba = r_cast< const VolumeIndexKey& >(key).lba();
-            auto& existing_value_vol_idx = r_cast< const VolumeIndexValue& >(existing_value);
+            auto& existing_value_vol_idx = r_cast< const ValueT& >(existing_value);
             blocks_info[lba].old_blkid = existing_value_vol_idx.blkid();
             blocks_info[lba].old_checksum = existing_value_vol_idx.checksum();
             return homestore::put_filter_decision::replace;
@@ -38,10 +113,10 @@ public:
         for (auto lba = start_lba; lba <= end_lba; ++lba) {
             VolumeIndexKey key{lba};
             auto& block_info = blocks_info[lba];
-            VolumeIndexValue value{block_info.new_blkid, block_info.new_checksum};
+            ValueT value{block_info.new_blkid, block_info.new_checksum};
             auto req = homestore::BtreeSinglePutRequest{&key, &value, homestore::btree_put_type::UPSERT,
                                                         nullptr /* existing value, not needed here */, filter_cb};
-            auto result = hs_index_table_->put(req);
+            auto result = tbl.put(req);
 #ifdef _PRERELEASE
             if (iomgr_flip::instance()->test_flip("vol_index_partial_put_failure")) {
                 // this is to simulate failure after partially writing to index.
@@ -51,11 +126,11 @@ public:
                     // simulate failure after writing to half of the index
                     // restore the blkid at this lba to the old value
                     LOGINFO("vol_index_partial_put_failure flip is set, aborting");
-                    value = VolumeIndexValue{blocks_info[lba].old_blkid, blocks_info[lba].old_checksum};
+                    value = ValueT{blocks_info[lba].old_blkid, blocks_info[lba].old_checksum};
                     blocks_info[lba].old_blkid = homestore::BlkId{};
                     blocks_info[lba].old_checksum = 0;
                     auto req1 = homestore::BtreeSinglePutRequest{&key, &value, homestore::btree_put_type::UPSERT};
-                    if (auto restore_lba_result = hs_index_table_->put(req1);
+                    if (auto restore_lba_result = tbl.put(req1);
                         restore_lba_result != homestore::btree_status_t::success) {
                         LOGERROR("Failed to rollback lba {}, put error={}, NOT EXPECTED!", lba, restore_lba_result);
                     }
@@ -66,7 +141,7 @@ public:
             if (result != homestore::btree_status_t::success) {
                 LOGERROR("Failed to put to index {}, error={}", lba, result);
                 // rollback the lbas for which we have already written to the index table
-                rollback_write(start_lba, lba - 1, blocks_info);
+                rollback_write(tbl, start_lba, lba - 1, blocks_info);
                 return std::unexpected(VolumeError::INDEX_ERROR);
             }
         }
@@ -74,40 +149,27 @@ public:
         return folly::Unit();
     }
 
-    VolumeManager::NullResult read_from_index(const vol_interface_req_ptr& req, index_kv_list_t& index_kvs) {
-        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
-            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{req->lba}, VolumeIndexKey{req->end_lba()}},
-            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY};
-        if (auto ret = hs_index_table_->query(qreq, index_kvs); ret != homestore::btree_status_t::success) {
-            return std::unexpected(VolumeError::INDEX_ERROR);
-        }
-        return {};
-    }
-
-    void rollback_write(lba_t start_lba, lba_t end_lba, std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+    template < typename ValueT >
+    void rollback_write(homestore::IndexTable< VolumeIndexKey, ValueT >& tbl, lba_t start_lba, lba_t end_lba,
+                        std::unordered_map< lba_t, BlockInfo >& blocks_info) {
         for (auto lba = start_lba; lba <= end_lba; ++lba) {
             VolumeIndexKey key{lba};
-            VolumeIndexValue value;
+            ValueT value;
             // If old_blk_id is valid, we need to restore it, otherwise remove the entry.
             if (blocks_info[lba].old_blkid.is_valid()) {
-                value = VolumeIndexValue{blocks_info[lba].old_blkid, blocks_info[lba].old_checksum};
+                value = ValueT{blocks_info[lba].old_blkid, blocks_info[lba].old_checksum};
                 auto req = homestore::BtreeSinglePutRequest{&key, &value, homestore::btree_put_type::UPSERT};
-                if (auto result = hs_index_table_->put(req); result != homestore::btree_status_t::success) {
+                if (auto result = tbl.put(req); result != homestore::btree_status_t::success) {
                     LOGERROR("Failed to rollback lba {}, put error={}", lba, result);
                 }
             } else {
                 auto req = homestore::BtreeSingleRemoveRequest{&key, &value};
-                if (auto result = hs_index_table_->remove(req); result != homestore::btree_status_t::success) {
+                if (auto result = tbl.remove(req); result != homestore::btree_status_t::success) {
                     LOGERROR("Failed to rollback lba {}, remove error={}", lba, result);
                 }
             }
         }
     }
-
-    void destroy() {
-        homestore::hs()->index_service().remove_index_table(hs_index_table_);
-        hs_index_table_->destroy();
-    }
 };
 
 } // namespace homeblocks
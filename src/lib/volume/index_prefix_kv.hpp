@@ -20,6 +20,7 @@
 #include <homestore/index/index_internal.hpp>
 #include <homestore/blk.h>
 #include <sisl/fds/buffer.hpp>
+#include "checksum.hpp"
 
 using homestore::BlkId;
 using homestore::BtreeKey;
@@ -32,7 +33,8 @@ struct BlockInfo {
     // Checksum calculated on new data and written to new_blkid.
     homestore::BlkId new_blkid;
     homestore::BlkId old_blkid;
-    homestore::csum_t new_checksum;
+    vol_csum_t new_checksum;
+    vol_csum_t old_checksum{0};
 };
 
 struct IndexValueContext {
@@ -177,7 +179,10 @@ public:
     }
 };
 
-class VolumeIndexValue : public homestore::BtreeIntervalValue {
+// Index value with checksum of type CsumT. Volumes with checksums wider than 16 bits store vol_csum_t, the others keep
+// the 16 bit checksum of older releases. Values queried are handed out as VolumeIndexValue.
+template < typename CsumT >
+class VolumeIndexValueT : public homestore::BtreeIntervalValue {
 private:
 #pragma pack(1)
     // Store blkid and checksum as the value. Most significant 32 bits of BlkId contains chunk_num
@@ -185,24 +190,24 @@ private:
     // contains blk num are unique and used as suffix. Ignore the multiblkid bit.
     uint32_t m_blkid_prefix;
     uint32_t m_blkid_suffix;
-    homestore::csum_t m_checksum;
+    CsumT m_checksum;
 #pragma pack()
 
 public:
-    VolumeIndexValue(const BlkId& base_blkid, homestore::csum_t csum) : homestore::BtreeIntervalValue() {
+    VolumeIndexValueT(const BlkId& base_blkid, vol_csum_t csum) : homestore::BtreeIntervalValue() {
         m_blkid_suffix = uint32_cast(base_blkid.to_integer() & 0xFFFFFFFF) >> 1;
         m_blkid_prefix = uint32_cast(base_blkid.to_integer() >> 32);
-        m_checksum = csum;
+        m_checksum = static_cast< CsumT >(csum);
     }
-    VolumeIndexValue(const BlkId& base_blkid) : VolumeIndexValue(base_blkid, 0) {}
-    VolumeIndexValue() = default;
-    VolumeIndexValue(const VolumeIndexValue& other) :
+    VolumeIndexValueT(const BlkId& base_blkid) : VolumeIndexValueT(base_blkid, 0) {}
+    VolumeIndexValueT() = default;
+    VolumeIndexValueT(const VolumeIndexValueT& other) :
             homestore::BtreeIntervalValue(),
             m_blkid_prefix(other.m_blkid_prefix),
             m_blkid_suffix(other.m_blkid_suffix),
             m_checksum(other.m_checksum) {}
-    VolumeIndexValue(const sisl::blob& b, bool copy) : homestore::BtreeIntervalValue() { this->deserialize(b, copy); }
-    virtual ~VolumeIndexValue() = default;
+    VolumeIndexValueT(const sisl::blob& b, bool copy) : homestore::BtreeIntervalValue() { this->deserialize(b, copy); }
+    virtual ~VolumeIndexValueT() = default;
 
     homestore::BlkId blkid() const {
         homestore::blk_num_t blk_num = m_blkid_suffix;
@@ -211,19 +216,19 @@ public:
         return BlkId{blk_num, nblks, chunk_num};
     }
 
-    homestore::csum_t checksum() const { return m_checksum; }
+    vol_csum_t checksum() const { return m_checksum; }
 
     ///////////////////////////// Overriding methods of BtreeValue //////////////////////////
-    VolumeIndexValue& operator=(const VolumeIndexValue& other) = default;
+    VolumeIndexValueT& operator=(const VolumeIndexValueT& other) = default;
     sisl::blob serialize() const override {
-        sisl::blob b{r_cast< uint8_t const* >(this), sizeof(VolumeIndexValue)};
+        sisl::blob b{r_cast< uint8_t const* >(this), sizeof(VolumeIndexValueT)};
         return b;
     }
 
-    uint32_t serialized_size() const override { return sizeof(VolumeIndexValue); }
-    static uint32_t get_fixed_size() { return sizeof(VolumeIndexValue); }
+    uint32_t serialized_size() const override { return sizeof(VolumeIndexValueT); }
+    static uint32_t get_fixed_size() { return sizeof(VolumeIndexValueT); }
     void deserialize(const sisl::blob& b, bool) {
-        VolumeIndexValue const* other = r_cast< VolumeIndexValue const* >(b.cbytes());
+        VolumeIndexValueT const* other = r_cast< VolumeIndexValueT const* >(b.cbytes());
         m_blkid_prefix = other->m_blkid_prefix;
         m_blkid_suffix = other->m_blkid_suffix;
         m_checksum = other->m_checksum;
@@ -231,17 +236,17 @@ public:
 
     std::string to_string() const override { return fmt::format("{} csum={}", blkid().to_string(), m_checksum); }
 
-    friend std::ostream& operator<<(std::ostream& os, const VolumeIndexValue& v) {
+    friend std::ostream& operator<<(std::ostream& os, const VolumeIndexValueT& v) {
         os << v.to_string();
         return os;
     }
 
-    friend std::istream& operator>>(std::istream& is, VolumeIndexValue& v) {
+    friend std::istream& operator>>(std::istream& is, VolumeIndexValueT& v) {
         uint32_t base_val;
         uint32_t offset;
         char dummy;
         is >> base_val >> dummy >> offset;
-        v = VolumeIndexValue{BlkId{}};
+        v = VolumeIndexValueT{BlkId{}};
         return is;
     }
 
@@ -250,11 +255,11 @@ public:
         auto ctx = r_cast< IndexValueContext* >(app_ctx);
         DEBUG_ASSERT(ctx, "Context null");
 
-        // Get the next blk num and checksum
-        m_blkid_suffix += n;
+        // Get the next blk num and checksum, every lba maps to a page of nblks blocks
+        m_blkid_suffix += n * (m_blkid_prefix & 0xFFFF);
         auto curr_lba = ctx->start_lba + n;
         DEBUG_ASSERT(ctx->block_info->find(curr_lba) != ctx->block_info->end(), "Invalid index");
-        m_checksum = (*ctx->block_info)[curr_lba].new_checksum;
+        m_checksum = static_cast< CsumT >((*ctx->block_info)[curr_lba].new_checksum);
     }
 
     sisl::blob serialize_prefix() const override {
@@ -263,25 +268,25 @@ public:
     sisl::blob serialize_suffix() const override {
         // Include both m_blkid_suffix and checksum in the suffix.
         return sisl::blob{uintptr_cast(const_cast< uint32_t* >(&m_blkid_suffix)),
-                          uint32_cast(sizeof(uint32_t) + sizeof(homestore::csum_t))};
+                          uint32_cast(sizeof(uint32_t) + sizeof(CsumT))};
     }
     uint32_t serialized_prefix_size() const override { return uint32_cast(sizeof(uint32_t)); }
-    uint32_t serialized_suffix_size() const override {
-        return uint32_cast(sizeof(uint32_t) + sizeof(homestore::csum_t));
-    }
+    uint32_t serialized_suffix_size() const override { return uint32_cast(sizeof(uint32_t) + sizeof(CsumT)); }
 
     void deserialize(sisl::blob const& prefix, sisl::blob const& suffix, bool) override {
         DEBUG_ASSERT_EQ(prefix.size(), sizeof(uint32_t), "Invalid prefix size on deserialize");
-        DEBUG_ASSERT_EQ(suffix.size(), sizeof(uint32_t) + sizeof(homestore::csum_t),
-                        "Invalid suffix size on deserialize");
+        DEBUG_ASSERT_EQ(suffix.size(), sizeof(uint32_t) + sizeof(CsumT), "Invalid suffix size on deserialize");
         m_blkid_prefix = *(r_cast< uint32_t const* >(prefix.cbytes()));
         m_blkid_suffix = *(r_cast< uint32_t const* >(suffix.cbytes()));
-        m_checksum = *(r_cast< homestore::csum_t const* >(suffix.cbytes() + sizeof(uint32_t)));
+        m_checksum = *(r_cast< CsumT const* >(suffix.cbytes() + sizeof(uint32_t)));
     }
 
-    bool operator==(VolumeIndexValue const& other) const {
+    bool operator==(VolumeIndexValueT const& other) const {
         return ((m_blkid_prefix == other.m_blkid_prefix) && (m_blkid_suffix == other.m_blkid_suffix) &&
                 (m_checksum == other.m_checksum));
     }
 };
+
+using VolumeIndexValue = VolumeIndexValueT< vol_csum_t >;
+using VolumeIndexValue16 = VolumeIndexValueT< homestore::csum_t >;
 } // namespace homeblocks
\ No newline at end of file
@@ -9,26 +9,103 @@ static const auto btree_int_node_type = homestore::btree_node_type::FIXED;
 
 using index_kv_list_t = std::vector< std::pair< VolumeIndexKey, VolumeIndexValue > >;
 using hs_index_table_t = homestore::IndexTable< VolumeIndexKey, VolumeIndexValue >;
+using hs_index_table16_t = homestore::IndexTable< VolumeIndexKey, VolumeIndexValue16 >;
 
+// Index table of a volume. Only one of the homestore tables is set, by the width of the checksums of the volume.
 class VolumeIndexTable {
     std::shared_ptr< hs_index_table_t > hs_index_table_;
+    std::shared_ptr< hs_index_table16_t > hs_index_table16_;
 
 public:
     template < typename... Args >
-    VolumeIndexTable(Args&&... args) :
-            hs_index_table_(std::make_shared< hs_index_table_t >(std::forward< Args >(args)...)) {
-        LOGINFO("Created Prefix Index table, uuid {}", boost::uuids::to_string(hs_index_table_->uuid()));
+    VolumeIndexTable(bool wide_checksum, Args&&... args) {
+        if (wide_checksum) {
+            hs_index_table_ = std::make_shared< hs_index_table_t >(std::forward< Args >(args)...);
+        } else {
+            hs_index_table16_ = std::make_shared< hs_index_table16_t >(std::forward< Args >(args)...);
+        }
+        auto const uuid = wide_checksum ? hs_index_table_->uuid() : hs_index_table16_->uuid();
+        LOGINFO("Created Prefix Index table, uuid {} wide_checksum {}", boost::uuids::to_string(uuid), wide_checksum);
+    }
+
+    std::shared_ptr< homestore::IndexTableBase > index_table() {
+        if (hs_index_table_) { return hs_index_table_; }
+        return hs_index_table16_;
     }
 
-    std::shared_ptr< hs_index_table_t > index_table() { return hs_index_table_; }
+    bool wide_checksum() const { return hs_index_table_ != nullptr; }
 
     VolumeManager::Result< folly::Unit > write_to_index(lba_t start_lba, lba_t end_lba,
                                                         std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+        if (hs_index_table_) { return write_to_index(*hs_index_table_, start_lba, end_lba, blocks_info); }
+        return write_to_index(*hs_index_table16_, start_lba, end_lba, blocks_info);
+    }
+
+    VolumeManager::Result< folly::Unit > read_from_index(const vol_interface_req_ptr& req, index_kv_list_t& index_kvs) {
+        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
+            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{req->lba}, VolumeIndexKey{req->end_lba()}},
+            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY};
+        if (auto ret = query(qreq, index_kvs); ret != homestore::btree_status_t::success) {
+            return std::unexpected(VolumeError::INDEX_ERROR);
+        }
+        return folly::Unit();
+    }
+
+    // Query at most max_entries mapped lbas within [start_lba, end_lba]. Returns true if there are more mapped lbas in
+    // the range after the last returned one.
+    VolumeManager::Result< bool > query_range(lba_t start_lba, lba_t end_lba, uint32_t max_entries,
+                                              index_kv_list_t& index_kvs) {
+        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
+            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{start_lba}, VolumeIndexKey{end_lba}},
+            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY, max_entries};
+        auto ret = query(qreq, index_kvs);
+        if (ret == homestore::btree_status_t::has_more) { return true; }
+        if (ret != homestore::btree_status_t::success) { return std::unexpected(VolumeError::INDEX_ERROR); }
+        return false;
+    }
+
+    void rollback_write(lba_t start_lba, lba_t end_lba, std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+        if (hs_index_table_) {
+            rollback_write(*hs_index_table_, start_lba, end_lba, blocks_info);
+        } else {
+            rollback_write(*hs_index_table16_, start_lba, end_lba, blocks_info);
+        }
+    }
+
+    void destroy() {
+        homestore::hs()->index_service().remove_index_table(index_table());
+        if (hs_index_table_) {
+            hs_index_table_->destroy();
+        } else {
+            hs_index_table16_->destroy();
+        }
+    }
+
+private:
+    homestore::btree_status_t query(homestore::BtreeQueryRequest< VolumeIndexKey >& qreq, index_kv_list_t& index_kvs) {
+        if (hs_index_table_) { return hs_index_table_->query(qreq, index_kvs); }
+
+        // Values with 16 bit checksums are handed out widened.
+        std::vector< std::pair< VolumeIndexKey, VolumeIndexValue16 > > kvs;
+        auto ret = hs_index_table16_->query(qreq, kvs);
+        index_kvs.reserve(index_kvs.size() + kvs.size());
+        for (auto const& [key, value] : kvs) {
+            index_kvs.emplace_back(key, VolumeIndexValue{value.blkid(), value.checksum()});
+        }
+        return ret;
+    }
+
+    template < typename ValueT >
+    VolumeManager::Result< folly::Unit > write_to_index(homestore::IndexTable< VolumeIndexKey, ValueT >& tbl,
+                                                        lba_t start_lba, lba_t end_lba,
+                                                        std::unordered_map< lba_t, BlockInfo >& blocks_info) {
         // Use filter callback to get the old blkid.
         homestore::put_filter_cb_t filter_cb = [&blocks_info](BtreeKey const& key, BtreeValue const& existing_value,
                                                               BtreeValue const& value) {
             auto lba = r_cast< const VolumeIndexKey& >(key).key();
-            blocks_info[lba].old_blkid = r_cast< const VolumeIndexValue& >(existing_value).blkid();
+            auto& existing_value_vol_idx = r_cast< const ValueT& >(existing_value);
+            blocks_info[lba].old_blkid = existing_value_vol_idx.blkid();
+            blocks_info[lba].old_checksum = existing_value_vol_idx.checksum();
             return homestore::put_filter_decision::replace;
         };
 
@@ -36,16 +113,16 @@ public:
         // For value shift() will get the blk_num and checksum for each lba.
         IndexValueContext app_ctx{&blocks_info, start_lba};
         const BlkId& start_blkid = blocks_info[start_lba].new_blkid;
-        VolumeIndexValue value{start_blkid, blocks_info[start_lba].new_checksum};
+        ValueT value{start_blkid, blocks_info[start_lba].new_checksum};
 
         auto req = homestore::BtreeRangePutRequest< VolumeIndexKey >{
             homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{start_lba}, true, VolumeIndexKey{end_lba}, true},
             homestore::btree_put_type::UPSERT,
-            r_cast< VolumeIndexValue* >(&value),
+            r_cast< ValueT* >(&value),
             r_cast< void* >(&app_ctx),
             std::numeric_limits< uint32_t >::max() /* batch_size */,
             filter_cb};
-        auto result = hs_index_table_->put(req);
+        auto result = tbl.put(req);
         if (result != homestore::btree_status_t::success) {
             LOGERROR("Failed to put to index range=({},{}) error={}", start_lba, end_lba, result);
             return std::unexpected(VolumeError::INDEX_ERROR);
@@ -54,19 +131,30 @@ public:
         return folly::Unit();
     }
 
-    VolumeManager::Result< folly::Unit > read_from_index(const vol_interface_req_ptr& req, index_kv_list_t& index_kvs) {
-        homestore::BtreeQueryRequest< VolumeIndexKey > qreq{
-            homestore::BtreeKeyRange< VolumeIndexKey >{VolumeIndexKey{req->lba}, VolumeIndexKey{req->end_lba()}},
-            homestore::BtreeQueryType::SWEEP_NON_INTRUSIVE_PAGINATION_QUERY};
-        if (auto ret = hs_index_table_->query(qreq, index_kvs); ret != homestore::btree_status_t::success) {
-            return std::unexpected(VolumeError::INDEX_ERROR);
+    template < typename ValueT >
+    void rollback_write(homestore::IndexTable< VolumeIndexKey, ValueT >& tbl, lba_t start_lba, lba_t end_lba,
+                        std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+        for (auto lba = start_lba; lba <= end_lba; ++lba) {
+            homestore::BtreeKeyRange< VolumeIndexKey > range{VolumeIndexKey{lba}, true, VolumeIndexKey{lba}, true};
+            // If old_blk_id is valid, we need to restore it, otherwise remove the entry.
+            if (blocks_info[lba].old_blkid.is_valid()) {
+                std::unordered_map< lba_t, BlockInfo > old_info{
+                    {lba, BlockInfo{blocks_info[lba].old_blkid, BlkId{}, blocks_info[lba].old_checksum}}};
+                IndexValueContext app_ctx{&old_info, lba};
+                ValueT value{blocks_info[lba].old_blkid, blocks_info[lba].old_checksum};
+                auto req = homestore::BtreeRangePutRequest< VolumeIndexKey >{
+                    std::move(range), homestore::btree_put_type::UPSERT, r_cast< ValueT* >(&value),
+                    r_cast< void* >(&app_ctx), std::numeric_limits< uint32_t >::max() /* batch_size */};
+                if (auto result = tbl.put(req); result != homestore::btree_status_t::success) {
+                    LOGERROR("Failed to rollback lba {}, put error={}", lba, result);
+                }
+            } else {
+                auto req = homestore::BtreeRangeRemoveRequest< VolumeIndexKey >{std::move(range)};
+                if (auto result = tbl.remove(req); result != homestore::btree_status_t::success) {
+                    LOGERROR("Failed to rollback lba {}, remove error={}", lba, result);
+                }
+            }
         }
-        return folly::Unit();
-    }
-
-    void destroy() {
-        homestore::hs()->index_service().remove_index_table(hs_index_table_);
-        hs_index_table_->destroy();
     }
 };
 
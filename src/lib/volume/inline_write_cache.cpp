@@ -0,0 +1,137 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include "inline_write_cache.hpp"
+
+namespace homeblocks {
+
+void InlineWriteCache::insert(lba_t start_lba, lba_count_t nlbas, uint8_t const* data, int64_t lsn) {
+    std::scoped_lock lg(mtx_);
+    for (lba_t lba = start_lba; lba < start_lba + nlbas; ++lba, data += page_size_) {
+        auto it = pages_.find(lba);
+        if (it != pages_.end() && it->second.lsn > lsn) { continue; }
+
+        Page page{.lsn = lsn, .seq = ++seq_, .data = sisl::io_blob_safe{page_size_, 512}};
+        std::memcpy(page.data.bytes(), data, page_size_);
+        if (it == pages_.end()) {
+            pages_.emplace(lba, std::move(page));
+            ++num_pages_;
+        } else {
+            it->second = std::move(page);
+        }
+    }
+}
+
+void InlineWriteCache::read(lba_t start_lba, lba_t end_lba,
+                            std::vector< std::pair< lba_t, sisl::io_blob_safe > >& pages) const {
+    std::scoped_lock lg(mtx_);
+    for (auto it = pages_.lower_bound(start_lba); it != pages_.end() && it->first <= end_lba; ++it) {
+        sisl::io_blob_safe buf{page_size_, 512};
+        std::memcpy(buf.bytes(), it->second.data.cbytes(), page_size_);
+        pages.emplace_back(it->first, std::move(buf));
+    }
+}
+
+bool InlineWriteCache::overlaps(lba_t start_lba, lba_t end_lba) const {
+    if (num_pages_.load() == 0) { return false; }
+    std::scoped_lock lg(mtx_);
+    auto it = pages_.lower_bound(start_lba);
+    return (it != pages_.end() && it->first <= end_lba);
+}
+
+std::vector< InlineWriteCache::DestageRun > InlineWriteCache::pick_for_destage(uint32_t max_pages,
+                                                                               uint32_t max_run_pages) {
+    std::vector< DestageRun > runs;
+    std::vector< std::pair< lba_t, Page* > > picked;
+    {
+        std::scoped_lock lg(mtx_);
+        for (auto& [lba, page] : pages_) {
+            if (picked.size() >= max_pages) { break; }
+            if (page.destaging) { continue; }
+            page.destaging = true;
+            picked.emplace_back(lba, &page);
+        }
+
+        // group the picked pages into runs of contiguous lbas and copy them out while holding the lock, the page
+        // could be replaced by a newer inline write as soon as we release it;
+        for (size_t i = 0; i < picked.size();) {
+            size_t j = i + 1;
+            while (j < picked.size() && (j - i) < max_run_pages && picked[j].first == picked[j - 1].first + 1) {
+                ++j;
+            }
+
+            auto& run = runs.emplace_back();
+            run.start_lba = picked[i].first;
+            run.nlbas = j - i;
+            run.buf = sisl::io_blob_safe{uint32_cast(run.nlbas * page_size_), 512};
+            auto buf = run.buf.bytes();
+            for (; i < j; ++i, buf += page_size_) {
+                auto const* page = picked[i].second;
+                std::memcpy(buf, page->data.cbytes(), page_size_);
+                run.seqs.push_back(page->seq);
+                run.max_lsn = std::max(run.max_lsn, page->lsn);
+            }
+        }
+    }
+    return runs;
+}
+
+void InlineWriteCache::complete_destage(DestageRun const& run) {
+    std::scoped_lock lg(mtx_);
+    for (lba_count_t i = 0; i < run.nlbas; ++i) {
+        auto it = pages_.find(run.start_lba + i);
+        if (it != pages_.end() && it->second.seq == run.seqs[i]) {
+            pages_.erase(it);
+            --num_pages_;
+        }
+    }
+}
+
+void InlineWriteCache::abort_destage(DestageRun const& run) {
+    std::scoped_lock lg(mtx_);
+    for (lba_count_t i = 0; i < run.nlbas; ++i) {
+        auto it = pages_.find(run.start_lba + i);
+        if (it != pages_.end() && it->second.seq == run.seqs[i]) { it->second.destaging = false; }
+    }
+}
+
+void InlineWriteCache::erase(lba_t start_lba, lba_t end_lba, int64_t lsn) {
+    std::scoped_lock lg(mtx_);
+    for (auto it = pages_.lower_bound(start_lba); it != pages_.end() && it->first <= end_lba;) {
+        if (it->second.lsn <= lsn) {
+            it = pages_.erase(it);
+            --num_pages_;
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool InlineWriteCache::has_pages_upto(uint64_t seq) const {
+    if (num_pages_.load() == 0) { return false; }
+    std::scoped_lock lg(mtx_);
+    for (auto const& [_, page] : pages_) {
+        if (page.seq <= seq) { return true; }
+    }
+    return false;
+}
+
+uint64_t InlineWriteCache::cur_seq() const {
+    std::scoped_lock lg(mtx_);
+    return seq_;
+}
+
+} // namespace homeblocks
@@ -0,0 +1,85 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <sisl/fds/buffer.hpp>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+//
+// Pages of small writes which carry their payload inline in the journal entry. They are acked once the log is flushed
+// and kept here until the destager writes them to data device and index through the regular write path. Reads of
+// these lbas are served from here since they are newer than what index maps.
+//
+class InlineWriteCache {
+public:
+    struct Page {
+        int64_t lsn;  // lsn of the journal entry carrying this page;
+        uint64_t seq; // insertion order, tells a re-written page apart from the copy being destaged;
+        bool destaging{false};
+        sisl::io_blob_safe data;
+    };
+
+    // Contiguous pages picked by destager, to be written with a single IO.
+    struct DestageRun {
+        lba_t start_lba;
+        lba_count_t nlbas{0};
+        int64_t max_lsn{0}; // pages of journal entries up to this lsn are covered by this run;
+        sisl::io_blob_safe buf;
+        std::vector< uint64_t > seqs;
+    };
+
+    explicit InlineWriteCache(uint32_t page_size) : page_size_{page_size} {}
+
+    // Insert pages of a committed inline write, replacing older copies of the same lbas.
+    void insert(lba_t start_lba, lba_count_t nlbas, uint8_t const* data, int64_t lsn);
+
+    // Copy out the cached pages within [start_lba, end_lba].
+    void read(lba_t start_lba, lba_t end_lba, std::vector< std::pair< lba_t, sisl::io_blob_safe > >& pages) const;
+
+    bool overlaps(lba_t start_lba, lba_t end_lba) const;
+
+    // Pick at most max_pages pages in lba order, which are not being destaged, grouped in runs of contiguous lbas with
+    // at most max_run_pages pages each.
+    std::vector< DestageRun > pick_for_destage(uint32_t max_pages, uint32_t max_run_pages);
+
+    // Pages of the run are now in index, drop them unless re-written in the meantime.
+    void complete_destage(DestageRun const& run);
+    void abort_destage(DestageRun const& run);
+
+    // Used in log replay, drop pages in [start_lba, end_lba] of journal entries up to lsn, they are destaged already.
+    void erase(lba_t start_lba, lba_t end_lba, int64_t lsn);
+
+    // Whether any page inserted before seq is still pending destage.
+    bool has_pages_upto(uint64_t seq) const;
+    uint64_t cur_seq() const;
+
+    uint64_t num_pages() const { return num_pages_.load(); }
+    uint64_t size_bytes() const { return num_pages() * page_size_; }
+
+private:
+    uint32_t const page_size_;
+    mutable std::mutex mtx_;
+    std::map< lba_t, Page > pages_;
+    uint64_t seq_{0};
+    std::atomic< uint64_t > num_pages_{0};
+};
+
+} // namespace homeblocks
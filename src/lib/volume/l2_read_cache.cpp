@@ -0,0 +1,150 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstring>
+#include <sisl/logging/logging.h>
+#include <homestore/homestore.hpp>
+#include "l2_read_cache.hpp"
+
+namespace homeblocks {
+
+void L2ReadCache::create() {
+    auto& logstore_svc = homestore::hs()->logstore_service();
+    auto const logdev_id = logstore_svc.create_new_logdev(homestore::flush_mode_t::TIMER);
+    log_store_ = logstore_svc.create_new_log_store(logdev_id, true /* append_mode */);
+
+    sb_.create(sizeof(l2_cache_sb_t));
+    sb_->magic = L2_CACHE_SB_MAGIC;
+    sb_->version = L2_CACHE_SB_VER;
+    sb_->logdev_id = logdev_id;
+    sb_->store_id = log_store_->get_store_id();
+    sb_.write();
+    LOGI("L2 read cache created on logdev: {}, log store: {}, capacity: {}", sb_->logdev_id, sb_->store_id, capacity_);
+}
+
+void L2ReadCache::on_meta_blk_found(sisl::byte_view const& buf, void* cookie) {
+    sb_.load(buf, cookie);
+    RELEASE_ASSERT_EQ(sb_->magic, L2_CACHE_SB_MAGIC);
+    RELEASE_ASSERT_EQ(sb_->version, L2_CACHE_SB_VER);
+
+    // Every record replayed is a page cached before restart, records over capacity are dropped as they are added.
+    auto& logstore_svc = homestore::hs()->logstore_service();
+    logstore_svc.open_logdev(sb_->logdev_id, homestore::flush_mode_t::TIMER);
+    logstore_svc
+        .open_log_store(sb_->logdev_id, sb_->store_id, true /* append_mode */,
+                        [this](homestore::logstore_seq_num_t lsn, homestore::log_buffer rec, void*) {
+                            if (rec.size() < sizeof(l2_cache_record_t)) { return; }
+                            add_record(lsn, *r_cast< l2_cache_record_t const* >(rec.bytes()));
+                        })
+        .thenValue([this](std::shared_ptr< homestore::HomeLogStore > log_store) {
+            log_store_ = std::move(log_store);
+            LOGI("L2 read cache recovered on logdev: {}, log store: {}, pages: {}", sb_->logdev_id, sb_->store_id,
+                 num_pages());
+        });
+}
+
+bool L2ReadCache::contains(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid) const {
+    std::scoped_lock lg(mtx_);
+    auto it = entries_.find(key_t{vol_ordinal, lba});
+    return it != entries_.end() && it->second.blkid == blkid.to_integer();
+}
+
+bool L2ReadCache::read(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid, vol_checksum_type csum_type,
+                       vol_csum_t checksum, uint8_t* buf, uint32_t page_size) {
+    homestore::logstore_seq_num_t lsn;
+    {
+        std::scoped_lock lg(mtx_);
+        auto it = entries_.find(key_t{vol_ordinal, lba});
+        if (it == entries_.end() || it->second.blkid != blkid.to_integer() || it->second.checksum != checksum) {
+            return false;
+        }
+        lsn = it->second.lsn;
+    }
+
+    // The record could be truncated since looked up, it is a miss then.
+    homestore::log_buffer rec;
+    try {
+        rec = log_store_->read_sync(lsn);
+    } catch (std::exception const& e) {
+        LOGD("Failed to read L2 cached page of lba: {} at lsn: {}, error: {}", lba, lsn, e.what());
+        return false;
+    }
+    if (rec.size() != sizeof(l2_cache_record_t) + page_size) { return false; }
+    auto const* hdr = r_cast< l2_cache_record_t const* >(rec.bytes());
+    if (hdr->vol_ordinal != vol_ordinal || hdr->lba != lba || hdr->blkid != blkid.to_integer()) { return false; }
+
+    auto const* page = rec.bytes() + sizeof(l2_cache_record_t);
+    if (compute_checksum(csum_type, page, page_size) != checksum) {
+        LOGW("crc mismatch for L2 cached page of lba: {} at lsn: {}, reading it from data device", lba, lsn);
+        return false;
+    }
+    std::memcpy(buf, page, page_size);
+    return true;
+}
+
+void L2ReadCache::insert(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid, vol_csum_t checksum,
+                         uint8_t const* page, uint32_t page_size) {
+    if (!log_store_ || contains(vol_ordinal, lba, blkid)) { return; }
+
+    auto rec = std::make_shared< sisl::io_blob_safe >(sizeof(l2_cache_record_t) + page_size, 512);
+    new (rec->bytes()) l2_cache_record_t{vol_ordinal, lba, blkid.to_integer(), checksum, page_size};
+    std::memcpy(rec->bytes() + sizeof(l2_cache_record_t), page, page_size);
+    log_store_->append_async(
+        *rec, nullptr /* cookie */,
+        [this, rec](homestore::logstore_seq_num_t lsn, sisl::io_blob&, homestore::logdev_key, void*) {
+            add_record(lsn, *r_cast< l2_cache_record_t const* >(rec->cbytes()));
+        });
+}
+
+void L2ReadCache::add_record(homestore::logstore_seq_num_t lsn, l2_cache_record_t const& rec) {
+    auto const key = key_t{rec.vol_ordinal, rec.lba};
+    auto const size = uint32_cast(sizeof(l2_cache_record_t) + rec.page_size);
+    std::scoped_lock lg(mtx_);
+    entries_[key] = Entry{lsn, rec.blkid, rec.checksum};
+    records_.emplace(lsn, std::pair{key, size});
+    size_bytes_ += size;
+    truncate();
+}
+
+void L2ReadCache::truncate() {
+    homestore::logstore_seq_num_t upto{-1};
+    while (size_bytes_ > capacity_ && !records_.empty()) {
+        auto it = records_.begin();
+        auto const& [key, size] = it->second;
+        if (auto e = entries_.find(key); e != entries_.end() && e->second.lsn == it->first) { entries_.erase(e); }
+        size_bytes_ -= size;
+        upto = it->first;
+        records_.erase(it);
+    }
+    // Log store space is reclaimed by the next log device truncation.
+    if (upto >= 0 && log_store_) { log_store_->truncate(upto); }
+}
+
+void L2ReadCache::invalidate(uint64_t vol_ordinal, lba_t start_lba, lba_t end_lba) {
+    std::scoped_lock lg(mtx_);
+    entries_.erase(entries_.lower_bound(key_t{vol_ordinal, start_lba}),
+                   entries_.upper_bound(key_t{vol_ordinal, end_lba}));
+}
+
+uint64_t L2ReadCache::num_pages() const {
+    std::scoped_lock lg(mtx_);
+    return entries_.size();
+}
+
+uint64_t L2ReadCache::size_bytes() const {
+    std::scoped_lock lg(mtx_);
+    return size_bytes_;
+}
+
+} // namespace homeblocks
@@ -0,0 +1,106 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <homestore/blk.h>
+#include <homestore/logstore_service.hpp>
+#include <homestore/logstore/log_store.hpp>
+#include <homestore/superblk_handler.hpp>
+#include <homeblks/volume_mgr.hpp>
+#include "checksum.hpp"
+
+namespace homeblocks {
+
+// Header of a page in the L2 read cache log store, the page follows it in the same log record.
+struct l2_cache_record_t {
+    uint64_t vol_ordinal;
+    lba_t lba;
+    uint64_t blkid; // blk the page was read from, BlkId::to_integer();
+    vol_csum_t checksum;
+    uint32_t page_size;
+};
+
+//
+// Second level read cache of pages of volumes on HDD data device, kept on a log store on the fast device. Pages read
+// from data device are appended to the log store, the oldest records are truncated once it grows over capacity. A page
+// is keyed by volume ordinal and lba and served only if index still maps the lba to the blk it was read from and what
+// is read back passes the checksum kept in index, so overwrite and volume destroy need no invalidation on the device.
+// The log store is replayed on restart to rebuild the cache map, so the cache doesn't start cold.
+//
+class L2ReadCache {
+    struct l2_cache_sb_t {
+        uint64_t magic;
+        uint32_t version;
+        homestore::logdev_id_t logdev_id;
+        homestore::logstore_id_t store_id;
+    };
+
+public:
+    inline static auto const L2_CACHE_META_NAME = std::string("HomeBlksL2Cache");
+    static constexpr uint64_t L2_CACHE_SB_MAGIC{0xCA2EC0DE};
+    static constexpr uint32_t L2_CACHE_SB_VER{0x1};
+
+    explicit L2ReadCache(uint64_t capacity_bytes) : capacity_{capacity_bytes}, sb_{L2_CACHE_META_NAME} {}
+
+    // Create the log store on the fast device, on first enable.
+    void create();
+
+    // Open the log store found on recovery and replay it, called from meta blk found callback before log service
+    // starts.
+    void on_meta_blk_found(sisl::byte_view const& buf, void* cookie);
+
+    // Whether the page of lba is cached from blkid, without reading it.
+    bool contains(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid) const;
+
+    // Copy the page of lba to buf only if it is cached from blkid and passes checksum. It is a sync read of the log
+    // store, not to be called on reactors.
+    bool read(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid, vol_checksum_type csum_type,
+              vol_csum_t checksum, uint8_t* buf, uint32_t page_size);
+
+    // Append a page read from data device. It is cached once the append completes.
+    void insert(uint64_t vol_ordinal, lba_t lba, homestore::BlkId const& blkid, vol_csum_t checksum,
+                uint8_t const* page, uint32_t page_size);
+
+    // Drop pages of [start_lba, end_lba] of a volume, their records are left to be truncated.
+    void invalidate(uint64_t vol_ordinal, lba_t start_lba, lba_t end_lba);
+
+    uint64_t num_pages() const;
+    uint64_t size_bytes() const;
+
+private:
+    void add_record(homestore::logstore_seq_num_t lsn, l2_cache_record_t const& rec);
+    void truncate();
+
+private:
+    using key_t = std::pair< uint64_t, lba_t >; // volume ordinal, lba;
+
+    struct Entry {
+        homestore::logstore_seq_num_t lsn;
+        uint64_t blkid;
+        vol_csum_t checksum;
+    };
+
+    uint64_t const capacity_;
+    homestore::superblk< l2_cache_sb_t > sb_;
+    std::shared_ptr< homestore::HomeLogStore > log_store_;
+    mutable std::mutex mtx_;
+    std::map< key_t, Entry > entries_;
+    std::map< homestore::logstore_seq_num_t, std::pair< key_t, uint32_t > > records_; // lsn -> key, record size;
+    uint64_t size_bytes_{0};
+};
+
+} // namespace homeblocks
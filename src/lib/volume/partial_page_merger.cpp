@@ -0,0 +1,58 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include "partial_page_merger.hpp"
+
+namespace homeblocks {
+
+std::pair< std::shared_ptr< partial_write_t >, bool >
+PartialPageMerger::add(lba_t start_page, uint32_t offset, uint32_t size, uint8_t const* data, bool fua) {
+    auto const npages = (offset + size + page_size_ - 1) / page_size_;
+    std::scoped_lock lg(mtx_);
+    if (npages == 1) {
+        if (auto it = pending_.find(start_page); it != pending_.end()) {
+            it->second->sectors.push_back({offset, size, data});
+            it->second->fua |= fua;
+            return {it->second, false};
+        }
+    } else {
+        pending_.erase(pending_.lower_bound(start_page), pending_.upper_bound(start_page + npages - 1));
+    }
+
+    auto pw = std::make_shared< partial_write_t >();
+    pw->start_page = start_page;
+    pw->npages = npages;
+    pw->sectors.push_back({offset, size, data});
+    pw->fua = fua;
+    if (npages == 1) { pending_.emplace(start_page, pw); }
+    return {pw, true};
+}
+
+void PartialPageMerger::start(std::shared_ptr< partial_write_t > const& pw) {
+    std::scoped_lock lg(mtx_);
+    if (auto it = pending_.find(pw->start_page); it != pending_.end() && it->second == pw) { pending_.erase(it); }
+}
+
+void PartialPageMerger::seal(lba_t start_page, lba_t end_page) {
+    std::scoped_lock lg(mtx_);
+    pending_.erase(pending_.lower_bound(start_page), pending_.upper_bound(end_page));
+}
+
+void PartialPageMerger::cache(lba_t page, uint8_t const* data) {
+    // Cached page is replaced, insert keeps an existing one as is.
+    cache_.invalidate(page, page);
+    cache_.insert(page, data, cache_.generation());
+}
+
+} // namespace homeblocks
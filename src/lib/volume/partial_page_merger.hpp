@@ -0,0 +1,82 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <folly/futures/SharedPromise.h>
+#include <homeblks/volume_mgr.hpp>
+#include "read_cache.hpp"
+
+namespace homeblocks {
+
+// Pages written by one or more partial writes merged together. Sectors are applied in arrival order after the pages
+// not fully written are read.
+struct partial_write_t {
+    struct sectors_t {
+        uint32_t offset; // in bytes from the start of the first page;
+        uint32_t size;
+        uint8_t const* data; // buffer of the write, valid until done is fulfilled;
+    };
+
+    lba_t start_page;
+    lba_count_t npages;
+    std::vector< sectors_t > sectors;
+    bool fua{false};
+    folly::SharedPromise< VolumeManager::NullResult > done;
+};
+
+//
+// Partial page writes of a volume with sectors smaller than pages, which are merged into the pages by read-modify-write
+// under the range lock of the pages. A write within a single page joins a write of the same page still waiting for its
+// range lock, so writes of neighbouring sectors issued together cost a single read and write of the page. Pages written
+// are kept in a small LRU cache, so that back to back writes of a page don't read it again.
+//
+class PartialPageMerger {
+public:
+    PartialPageMerger(uint32_t page_size, uint64_t cache_bytes) :
+            page_size_{page_size}, cache_{page_size, cache_bytes} {}
+
+    // Add a write of size bytes at offset in start_page. Returns the partial write it is part of, and whether it is a
+    // new one which the caller issues.
+    std::pair< std::shared_ptr< partial_write_t >, bool > add(lba_t start_page, uint32_t offset, uint32_t size,
+                                                              uint8_t const* data, bool fua);
+
+    // Called once the range lock of the write is granted, nothing is merged into it after.
+    void start(std::shared_ptr< partial_write_t > const& pw);
+
+    // Called on issue of any other write of the pages. Writes issued after it are not merged into ones issued before,
+    // which would apply them out of issue order.
+    void seal(lba_t start_page, lba_t end_page);
+
+    // Copy a cached page to buf, false if not cached.
+    bool read_cached(lba_t page, uint8_t* buf) { return cache_.read(page, 1, buf); }
+
+    // Cache a page as written by a partial write, pages written otherwise are invalidated. Called under the range lock
+    // of the page.
+    void cache(lba_t page, uint8_t const* data);
+    void invalidate(lba_t start_page, lba_t end_page) { cache_.invalidate(start_page, end_page); }
+
+    uint64_t num_cached_pages() const { return cache_.num_pages(); }
+
+private:
+    uint32_t const page_size_;
+    std::mutex mtx_;
+    std::map< lba_t, std::shared_ptr< partial_write_t > > pending_; // single page writes not started yet;
+    ReadCache cache_;
+};
+
+} // namespace homeblocks
@@ -0,0 +1,84 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <folly/executors/InlineExecutor.h>
+#include "range_lock.hpp"
+
+namespace homeblocks {
+
+std::pair< uint64_t, folly::Future< folly::Unit > > RangeLock::lock(lba_t start_lba, lba_t end_lba,
+                                                                   uint8_t const* data) {
+    std::scoped_lock lg(mtx_);
+    auto const id = next_id_++;
+    uint32_t blockers{0};
+    for (auto const& [_, e] : locks_) {
+        if (e.start_lba <= end_lba && start_lba <= e.end_lba) { ++blockers; }
+    }
+
+    auto& entry = locks_.emplace(id, Entry{start_lba, end_lba, blockers, data, nullptr}).first->second;
+    if (blockers == 0) { return {id, folly::makeFuture()}; }
+    entry.waiter = std::make_unique< folly::Promise< folly::Unit > >();
+    return {id, entry.waiter->getSemiFuture().via(&folly::InlineExecutor::instance())};
+}
+
+void RangeLock::unlock(uint64_t id) {
+    std::vector< std::unique_ptr< folly::Promise< folly::Unit > > > granted;
+    {
+        std::scoped_lock lg(mtx_);
+        auto it = locks_.find(id);
+        if (it == locks_.end()) { return; }
+        auto const start_lba = it->second.start_lba;
+        auto const end_lba = it->second.end_lba;
+        // Only locks requested later could be waiting on this one.
+        for (auto next = locks_.erase(it); next != locks_.end(); ++next) {
+            auto& e = next->second;
+            if (e.start_lba > end_lba || start_lba > e.end_lba) { continue; }
+            if (--e.blockers == 0) { granted.emplace_back(std::move(e.waiter)); }
+        }
+    }
+
+    // Granted writes continue inline, outside of the lock.
+    for (auto& waiter : granted) {
+        waiter->setValue();
+    }
+}
+
+void RangeLock::read(lba_t start_lba, lba_t end_lba, uint32_t page_size,
+                     std::vector< std::pair< lba_t, sisl::io_blob_safe > >& pages) const {
+    std::scoped_lock lg(mtx_);
+    if (locks_.empty()) { return; }
+
+    // Overlapping writes are done in arrival order, the latest one of an lba has its final data.
+    std::unordered_set< lba_t > found;
+    for (auto it = locks_.rbegin(); it != locks_.rend(); ++it) {
+        auto const& e = it->second;
+        if (e.data == nullptr || e.start_lba > end_lba || start_lba > e.end_lba) { continue; }
+        for (auto lba = std::max(start_lba, e.start_lba); lba <= std::min(end_lba, e.end_lba); ++lba) {
+            if (!found.insert(lba).second) { continue; }
+            sisl::io_blob_safe buf{page_size, 512};
+            std::memcpy(buf.bytes(), e.data + (lba - e.start_lba) * page_size, page_size);
+            pages.emplace_back(lba, std::move(buf));
+        }
+    }
+}
+
+uint64_t RangeLock::num_locks() const {
+    std::scoped_lock lg(mtx_);
+    return locks_.size();
+}
+
+} // namespace homeblocks
@@ -0,0 +1,62 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <folly/futures/Future.h>
+#include <sisl/fds/buffer.hpp>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+//
+// Lba range locks of a volume, held by writes from blk allocation until commit. A lock is granted once every lock
+// requested before it on an overlapping range is released, so overlapping writes are done in arrival order while
+// non overlapping ones run in parallel. Waiting doesn't block the caller, the returned future completes on grant.
+// Data of the writes holding or waiting for a lock is kept by reference, so reads can be served the latest data of
+// lbas being written.
+//
+class RangeLock {
+public:
+    // Lock [start_lba, end_lba]. Returns the id to unlock it with and a future completed once it is granted. data, if
+    // not null, is the pages being written which must stay valid until unlock.
+    std::pair< uint64_t, folly::Future< folly::Unit > > lock(lba_t start_lba, lba_t end_lba,
+                                                             uint8_t const* data = nullptr);
+    void unlock(uint64_t id);
+
+    // Copy out the pages within [start_lba, end_lba] of the latest write of each lba still holding or waiting for a
+    // lock.
+    void read(lba_t start_lba, lba_t end_lba, uint32_t page_size,
+              std::vector< std::pair< lba_t, sisl::io_blob_safe > >& pages) const;
+
+    uint64_t num_locks() const;
+
+private:
+    struct Entry {
+        lba_t start_lba;
+        lba_t end_lba;
+        uint32_t blockers;   // earlier overlapping locks not released yet;
+        uint8_t const* data; // pages being written, null if not to be read;
+        std::unique_ptr< folly::Promise< folly::Unit > > waiter;
+    };
+
+    mutable std::mutex mtx_;
+    std::map< uint64_t, Entry > locks_; // held and waiting locks in arrival order;
+    uint64_t next_id_{0};
+};
+
+} // namespace homeblocks
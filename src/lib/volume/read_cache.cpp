@@ -0,0 +1,88 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#include <cstring>
+#include "read_cache.hpp"
+
+namespace homeblocks {
+
+uint64_t ReadCache::generation() const {
+    std::scoped_lock lg(mtx_);
+    return gen_;
+}
+
+bool ReadCache::read(lba_t start_lba, lba_count_t nlbas, uint8_t* buf) {
+    std::scoped_lock lg(mtx_);
+    for (lba_t lba = start_lba; lba < start_lba + nlbas; ++lba) {
+        if (!pages_.contains(lba)) { return false; }
+    }
+
+    for (lba_t lba = start_lba; lba < start_lba + nlbas; ++lba, buf += page_size_) {
+        auto& entry = pages_[lba];
+        std::memcpy(buf, entry.data.cbytes(), page_size_);
+        lru_.splice(lru_.begin(), lru_, entry.lru_it);
+    }
+    return true;
+}
+
+bool ReadCache::contains(lba_t start_lba, lba_count_t nlbas) const {
+    std::scoped_lock lg(mtx_);
+    for (lba_t lba = start_lba; lba < start_lba + nlbas; ++lba) {
+        if (!pages_.contains(lba)) { return false; }
+    }
+    return true;
+}
+
+void ReadCache::insert(lba_t lba, uint8_t const* data, uint64_t gen) {
+    std::scoped_lock lg(mtx_);
+    if (gen != gen_) { return; }
+
+    auto it = pages_.find(lba);
+    if (it != pages_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+        return;
+    }
+
+    lru_.push_front(lba);
+    Entry entry{.lru_it = lru_.begin(), .data = sisl::io_blob_safe{page_size_, 512}};
+    std::memcpy(entry.data.bytes(), data, page_size_);
+    pages_.emplace(lba, std::move(entry));
+    evict();
+}
+
+void ReadCache::invalidate(lba_t start_lba, lba_t end_lba) {
+    std::scoped_lock lg(mtx_);
+    ++gen_;
+    if (pages_.empty()) { return; }
+    for (lba_t lba = start_lba; lba <= end_lba; ++lba) {
+        auto it = pages_.find(lba);
+        if (it == pages_.end()) { continue; }
+        lru_.erase(it->second.lru_it);
+        pages_.erase(it);
+    }
+}
+
+uint64_t ReadCache::num_pages() const {
+    std::scoped_lock lg(mtx_);
+    return pages_.size();
+}
+
+void ReadCache::evict() {
+    while (pages_.size() > max_pages_) {
+        pages_.erase(lru_.back());
+        lru_.pop_back();
+    }
+}
+
+} // namespace homeblocks
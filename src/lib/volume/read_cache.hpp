@@ -0,0 +1,67 @@
+/*********************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ *
+ *********************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <sisl/fds/buffer.hpp>
+#include <homeblks/volume_mgr.hpp>
+
+namespace homeblocks {
+
+//
+// LRU cache of recently read pages of a volume, to save seeks on HDD data devices. Pages are keyed by lba and dropped
+// whenever index maps the lba to a new blkid. A read which raced with such a remap can't insert what it read, which is
+// detected by the generation being bumped in between.
+//
+class ReadCache {
+public:
+    ReadCache(uint32_t page_size, uint64_t capacity_bytes) :
+            page_size_{page_size}, max_pages_{std::max(capacity_bytes / page_size, 1ul)} {}
+
+    // Taken before index lookup of a read, passed back to insert.
+    uint64_t generation() const;
+
+    // Copy [start_lba, start_lba + nlbas) to buf only if all the pages are cached.
+    bool read(lba_t start_lba, lba_count_t nlbas, uint8_t* buf);
+
+    // Whether all the pages in [start_lba, start_lba + nlbas) are cached.
+    bool contains(lba_t start_lba, lba_count_t nlbas) const;
+
+    void insert(lba_t lba, uint8_t const* data, uint64_t gen);
+    void invalidate(lba_t start_lba, lba_t end_lba);
+
+    uint64_t num_pages() const;
+
+private:
+    void evict();
+
+private:
+    struct Entry {
+        std::list< lba_t >::iterator lru_it;
+        sisl::io_blob_safe data;
+    };
+
+    uint32_t const page_size_;
+    uint64_t const max_pages_;
+    mutable std::mutex mtx_;
+    std::list< lba_t > lru_; // most recently used in front;
+    std::unordered_map< lba_t, Entry > pages_;
+    uint64_t gen_{0};
+};
+
+} // namespace homeblocks
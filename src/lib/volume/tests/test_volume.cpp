@@ -236,6 +236,19 @@ TEST_F(VolumeTest, CreateDestroyVolume) {
     g_helper->restart(2);
 }
 
+TEST_F(VolumeTest, CreateVolumeInvalidPageSize) {
+    auto vol_mgr = g_helper->inst()->volume_manager();
+    for (uint64_t page_size : {512ul, 6144ul, 256 * 1024ul}) {
+        auto vinfo = gen_vol_info(0);
+        vinfo.page_size = page_size;
+        auto id = vinfo.id;
+        auto ret = vol_mgr->create_volume(std::move(vinfo)).get();
+        ASSERT_FALSE(ret);
+        ASSERT_EQ(ret.error(), VolumeError::INVALID_ARG);
+        ASSERT_TRUE(vol_mgr->lookup_volume(id) == nullptr);
+    }
+}
+
 TEST_F(VolumeTest, CreateVolumeThenRecover) {
     std::vector< volume_id_t > vol_ids;
     {
@@ -214,6 +214,90 @@ TEST_F(ChunkSelectorTest, ResizeNumChunksTest) {
 }
 #endif
 
+TEST_F(ChunkSelectorTest, MirrorChunksTest) {
+    auto chunk_sel =
+        std::make_shared< VolumeChunkSelector >("test", [this](uint64_t, const std::vector< chunk_num_t >&) {});
+    uint32_t pdevs = 3, num_chunks_per_pdev = 20, pdev_id, mirror_pdev_id;
+    // Add chunks to chunk selector, each chunk is 16KB, so 3 * 20 * 16KB = 960KB
+    auto all_chunks = add_chunks_per_pdev(chunk_sel, pdevs, num_chunks_per_pdev);
+    auto init_num_free_chunks = chunk_sel->num_free_chunks();
+
+    // Mirror chunks pair up with all the chunks of the volume, on another pdev.
+    auto chunk_ids = chunk_sel->allocate_init_chunks(0 /* ordinal */, 180 * Ki, pdev_id, false /* lazy alloc */);
+    RELEASE_ASSERT(!chunk_ids.empty(), "no chunks");
+    auto mirror_chunk_ids = chunk_sel->allocate_mirror_chunks(0 /* ordinal */, mirror_pdev_id);
+    RELEASE_ASSERT_EQ(mirror_chunk_ids.size(), chunk_ids.size(), "mirror chunks not paired");
+    RELEASE_ASSERT_NE(mirror_pdev_id, pdev_id, "mirror chunks on the same pdev");
+    for (auto chunk_id : mirror_chunk_ids) {
+        RELEASE_ASSERT_EQ(all_chunks[chunk_id]->get_pdev_id(), mirror_pdev_id, "mirror chunk on wrong pdev");
+    }
+    RELEASE_ASSERT_EQ(chunk_sel->num_free_chunks(), init_num_free_chunks - 2 * chunk_ids.size(), "free chunks");
+
+    // Blks are never allocated from mirror chunks.
+    std::unordered_set< homestore::chunk_num_t > mirror_set(mirror_chunk_ids.begin(), mirror_chunk_ids.end());
+    for (int i = 0; i < 20; i++) {
+        homestore::blk_alloc_hints hints;
+        hints.application_hint = 0;
+        auto chunk = chunk_sel->select_chunk(1 /* nblks */, hints);
+        RELEASE_ASSERT(chunk, "Chunk not available");
+        RELEASE_ASSERT(!mirror_set.contains(chunk->get_chunk_id()), "mirror chunk selected");
+    }
+
+    // Release and recover both sets of chunks.
+    chunk_sel->release_chunks(0 /* ordinal */);
+    RELEASE_ASSERT_EQ(chunk_sel->num_free_chunks(), init_num_free_chunks, "num free chunks mismatch");
+    RELEASE_ASSERT(chunk_sel->recover_chunks(0 /* ordinal */, pdev_id, 180 * Ki, chunk_ids), "recover failed");
+    RELEASE_ASSERT(chunk_sel->recover_mirror_chunks(0 /* ordinal */, mirror_pdev_id, mirror_chunk_ids),
+                   "recover mirror failed");
+    RELEASE_ASSERT_EQ(chunk_sel->num_free_chunks(), init_num_free_chunks - 2 * chunk_ids.size(), "free chunks");
+}
+
+TEST_F(ChunkSelectorTest, HotColdChunksTest) {
+    auto chunk_sel =
+        std::make_shared< VolumeChunkSelector >("test", [this](uint64_t, const std::vector< chunk_num_t >&) {});
+    uint32_t pdevs = 3, num_chunks_per_pdev = 20, pdev_id;
+    // Add chunks to chunk selector, each chunk is 16KB, so 3 * 20 * 16KB = 960KB
+    auto all_chunks = add_chunks_per_pdev(chunk_sel, pdevs, num_chunks_per_pdev);
+    auto chunk_ids = chunk_sel->allocate_init_chunks(0 /* ordinal */, 180 * Ki, pdev_id, false /* lazy alloc */);
+    RELEASE_ASSERT_GT(chunk_ids.size(), 2ul, "not enough chunks");
+
+    // Hot blks are all allocated from one chunk, cold ones from the others.
+    homestore::blk_alloc_hints hot_hints, cold_hints;
+    hot_hints.application_hint = VolumeChunkSelector::alloc_hint(0 /* ordinal */, true /* hot */);
+    cold_hints.application_hint = VolumeChunkSelector::alloc_hint(0 /* ordinal */, false /* hot */);
+    auto const hot_chunk_id = chunk_sel->select_chunk(1 /* nblks */, hot_hints)->get_chunk_id();
+    for (int i = 0; i < 20; i++) {
+        RELEASE_ASSERT_EQ(chunk_sel->select_chunk(1 /* nblks */, hot_hints)->get_chunk_id(), hot_chunk_id,
+                          "hot blks spread over chunks");
+        RELEASE_ASSERT_NE(chunk_sel->select_chunk(1 /* nblks */, cold_hints)->get_chunk_id(), hot_chunk_id,
+                          "cold blks in hot chunk");
+    }
+
+    // Hot blks move to another chunk once the hot chunk is full.
+    all_chunks[hot_chunk_id]->set_available_blks(0);
+    auto const next_hot_chunk_id = chunk_sel->select_chunk(1 /* nblks */, hot_hints)->get_chunk_id();
+    RELEASE_ASSERT_NE(next_hot_chunk_id, hot_chunk_id, "full hot chunk selected");
+
+    // With log structured allocation, cold blks are appended to a single chunk, apart from the hot one. The cleaner
+    // picks neither of them.
+    chunk_sel->set_log_structured(0 /* ordinal */);
+    auto const append_chunk_id = chunk_sel->select_chunk(1 /* nblks */, cold_hints)->get_chunk_id();
+    RELEASE_ASSERT_NE(append_chunk_id, next_hot_chunk_id, "cold blks in hot chunk");
+    for (int i = 0; i < 20; i++) {
+        RELEASE_ASSERT_EQ(chunk_sel->select_chunk(1 /* nblks */, cold_hints)->get_chunk_id(), append_chunk_id,
+                          "cold blks not appended");
+    }
+    for (auto chunk_id : chunk_ids) {
+        if (chunk_id == append_chunk_id || chunk_id == next_hot_chunk_id) { continue; }
+        all_chunks[chunk_id]->set_available_blks(all_chunks[chunk_id]->get_total_blks() - 1);
+    }
+    all_chunks[append_chunk_id]->set_available_blks(1);
+    all_chunks[next_hot_chunk_id]->set_available_blks(1);
+    auto victim = chunk_sel->select_victim_chunk(0 /* ordinal */, 50 /* max_live_pct */);
+    RELEASE_ASSERT(victim, "no chunk to clean");
+    RELEASE_ASSERT(*victim != append_chunk_id && *victim != next_hot_chunk_id, "chunk in use picked to clean");
+}
+
 TEST_F(ChunkSelectorTest, RecoverChunksTest) {
     auto chunk_sel =
         std::make_shared< VolumeChunkSelector >("test", [this](uint64_t, const std::vector< chunk_num_t >&) {});
@@ -21,9 +21,11 @@
 #include <sisl/options/options.h>
 #include <sisl/flip/flip_client.hpp>
 #include <iomgr/iomgr_flip.hpp>
+#include <homestore/checkpoint/cp_mgr.hpp>
 #include <homeblks/home_blks.hpp>
 #include <homeblks/volume_mgr.hpp>
 #include <volume/volume.hpp>
+#include "home_blks_config.hpp"
 #include "test_common.hpp"
 
 SISL_LOGGING_INIT(HOMEBLOCKS_LOG_MODS)
@@ -93,7 +95,18 @@ static void get_random_nblks(uint32_t& nblks) {
 
 class VolumeIOImpl {
 public:
-    VolumeIOImpl() {
+    explicit VolumeIOImpl(vol_checksum_type csum_type = vol_checksum_type::CRC16, uint64_t page_size = g_page_size,
+                          bool dedup = false, vol_compression_type compression_type = vol_compression_type::NONE,
+                          bool write_back_ack = false, bool shared_journal = false, bool mirrored = false,
+                          uint32_t sector_size = 0) :
+            m_csum_type{csum_type},
+            m_page_size{page_size},
+            m_dedup{dedup},
+            m_compression_type{compression_type},
+            m_write_back_ack{write_back_ack},
+            m_shared_journal{shared_journal},
+            m_mirrored{mirrored},
+            m_sector_size{sector_size} {
         auto write_num_io = SISL_OPTIONS["write_num_io"].as< uint64_t >();
         auto write_qdepth = SISL_OPTIONS["write_qdepth"].as< uint32_t >();
         auto read_num_io = SISL_OPTIONS["read_num_io"].as< uint64_t >();
@@ -109,8 +122,15 @@ private:
         VolumeInfo vol_info;
         vol_info.name = "vol_" + std::to_string(vol_idx);
         vol_info.size_bytes = SISL_OPTIONS["vol_size_gb"].as< uint32_t >() * Gi;
-        vol_info.page_size = g_page_size;
+        vol_info.page_size = m_page_size;
         vol_info.id = hb_utils::gen_random_uuid();
+        vol_info.checksum_type = m_csum_type;
+        vol_info.dedup = m_dedup;
+        vol_info.compression_type = m_compression_type;
+        vol_info.write_back_ack = m_write_back_ack;
+        vol_info.shared_journal = m_shared_journal;
+        vol_info.mirrored = m_mirrored;
+        vol_info.sector_size = m_sector_size;
         return vol_info;
     }
 
@@ -336,6 +356,196 @@ public:
         LOGINFO("Verified {} lbas for volume {}", num_lbas_verified, m_vol_ptr->info()->name);
     }
 
+    // Scrub the whole volume from the current cursor until it wraps around. Returns the number of scrub batches.
+    // Batches reporting CRC_MISMATCH are counted in num_mismatched if given, any other failure is fatal.
+    uint64_t scrub_full_pass(uint64_t batch_bytes, uint64_t* num_mismatched = nullptr) {
+        uint64_t num_batches{0};
+        while (true) {
+            auto ret = m_vol_ptr->scrub(batch_bytes).get();
+            if (!ret.has_value() && ret.error() == VolumeError::UNSUPPORTED_OP) {
+                // background scrubber is working on this volume, retry later;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            ++num_batches;
+            if (!ret.has_value() && ret.error() == VolumeError::CRC_MISMATCH && num_mismatched) {
+                // cursor is persisted before the mismatch is reported;
+                ++(*num_mismatched);
+                if (scrub_cursor() == 0) { break; }
+                continue;
+            }
+            RELEASE_ASSERT(ret.has_value(), "Scrub failed for volume {}, error: {}", m_vol_name, ret.error());
+            if (ret.value() == 0) { break; }
+        }
+        return num_batches;
+    }
+
+    // Scrub one batch from the current cursor, returns the next cursor.
+    lba_t scrub_batch(uint64_t batch_bytes) {
+        auto ret = m_vol_ptr->scrub(batch_bytes).get();
+        RELEASE_ASSERT(ret.has_value(), "Scrub failed for volume {}, error: {}", m_vol_name, ret.error());
+        return ret.value();
+    }
+    lba_t scrub_cursor() const { return m_vol_ptr->scrub_cursor(); }
+    uint64_t mirror_repaired_pages() const { return m_vol_ptr->mirror_repaired_pages(); }
+    uint32_t num_mirror_dirty_ranges() const { return m_vol_ptr->num_mirror_dirty_ranges(); }
+    vol_checksum_type checksum_type() const { return m_vol_ptr->checksum_type(); }
+    bool is_online() const { return m_vol_ptr->is_online(); }
+
+    // Write the same data pattern to every sector of the range on a volume with sectors smaller than pages. Expected
+    // data is kept by sector in m_lba_data, updated when the write is issued.
+    VolumeManager::NullAsyncResult write_sectors_async(lba_t start_sector, uint32_t nsectors, uint64_t data_pattern) {
+        auto const sector_size = m_vol_ptr->info()->sector_size;
+        auto data = sisl::make_byte_array(nsectors * sector_size, 512);
+        for (uint32_t i = 0; i < nsectors; i++) {
+            test_common::HBTestHelper::fill_data_buf(data->bytes() + i * sector_size, sector_size, data_pattern);
+            std::lock_guard lock(m_mutex);
+            m_lba_data[start_sector + i] = data_pattern;
+        }
+
+        vol_interface_req_ptr req(new vol_interface_req{data->bytes(), start_sector, nsectors, m_vol_ptr});
+        return g_helper->inst()->volume_manager()->write(m_vol_ptr, req).thenValue([data, req](auto&& result) {
+            return result;
+        });
+    }
+
+    void verify_sectors(lba_t start_sector, uint32_t nsectors) {
+        auto const sector_size = m_vol_ptr->info()->sector_size;
+        sisl::io_blob_safe read_blob(nsectors * sector_size, 512);
+        vol_interface_req_ptr req(new vol_interface_req{read_blob.bytes(), start_sector, nsectors, m_vol_ptr});
+        auto ret = g_helper->inst()->volume_manager()->read(m_vol_ptr, req).get();
+        RELEASE_ASSERT(ret.has_value(), "Read failed for volume {}, error: {}", m_vol_name, ret.error());
+        for (uint32_t i = 0; i < nsectors; i++) {
+            auto const buf = read_blob.cbytes() + i * sector_size;
+            if (auto it = m_lba_data.find(start_sector + i); it != m_lba_data.end()) {
+                test_common::HBTestHelper::validate_data_buf(buf, sector_size, it->second);
+            } else {
+                test_common::HBTestHelper::validate_zeros(buf, sector_size);
+            }
+        }
+    }
+
+    VolumeManager::NullResult read_raw(lba_t start_lba, uint32_t nlbas, uint8_t* buf) {
+        vol_interface_req_ptr req(new vol_interface_req{buf, start_lba, nlbas, m_vol_ptr});
+        return g_helper->inst()->volume_manager()->read(m_vol_ptr, req).get();
+    }
+
+    uint64_t partial_cached_pages() { return m_vol_ptr->partial_pages()->num_cached_pages(); }
+
+    // Write the same data pattern to every page of the range from a buffer not aligned for direct io, then read it
+    // back into another unaligned buffer.
+    void write_read_unaligned(lba_t start_lba, uint32_t nblks, uint64_t data_pattern) {
+        auto const page_size = m_vol_ptr->info()->page_size;
+        auto const size = nblks * page_size;
+        auto data = sisl::make_byte_array(size + 8, 512);
+        auto buf = data->bytes() + 8;
+        for (uint32_t i = 0; i < nblks; i++) {
+            test_common::HBTestHelper::fill_data_buf(buf + i * page_size, page_size, data_pattern);
+            std::lock_guard lock(m_mutex);
+            m_lba_data[start_lba + i] = data_pattern;
+        }
+        auto vol_mgr = g_helper->inst()->volume_manager();
+        vol_interface_req_ptr req(new vol_interface_req{buf, start_lba, nblks, m_vol_ptr});
+        auto ret = vol_mgr->write(m_vol_ptr, req).get();
+        RELEASE_ASSERT(ret.has_value(), "Write failed for volume {}, error: {}", m_vol_name, ret.error());
+        RELEASE_ASSERT(req->buffer == buf, "Buffer of write req not restored");
+
+        sisl::io_blob_safe read_blob(size + 8, 512);
+        auto read_buf = read_blob.bytes() + 8;
+        req = new vol_interface_req{read_buf, start_lba, nblks, m_vol_ptr};
+        ret = vol_mgr->read(m_vol_ptr, req).get();
+        RELEASE_ASSERT(ret.has_value(), "Read failed for volume {}, error: {}", m_vol_name, ret.error());
+        RELEASE_ASSERT(req->buffer == read_buf, "Buffer of read req not restored");
+        for (uint32_t i = 0; i < nblks; i++) {
+            test_common::HBTestHelper::validate_data_buf(read_buf + i * page_size, page_size, data_pattern);
+        }
+    }
+
+    uint64_t inline_pending_pages() { return m_vol_ptr->inline_cache()->num_pages(); }
+    bool flush_inline_writes() { return m_vol_ptr->flush_inline_writes().get(); }
+    bool inline_write_degraded() { return m_vol_ptr->inline_write_degraded(); }
+
+    void enable_read_cache(uint64_t capacity_bytes) { m_vol_ptr->enable_read_cache(capacity_bytes); }
+    uint64_t read_cache_pages() { return m_vol_ptr->read_cache() ? m_vol_ptr->read_cache()->num_pages() : 0; }
+
+    VolumeManager::NullResult advise(lba_t lba, lba_count_t nlbas, vol_advice advice) {
+        auto vol_mgr = g_helper->inst()->volume_manager();
+        return vol_mgr->advise(m_vol_ptr, lba, nlbas, advice).get();
+    }
+
+    uint64_t promote_hot_extents(uint64_t max_bytes) {
+        auto ret = m_vol_ptr->promote_hot_extents(max_bytes).get();
+        RELEASE_ASSERT(ret.has_value(), "Promote failed for volume {}, error: {}", m_vol_name, ret.error());
+        return ret.value();
+    }
+
+    void enable_log_structured() { m_vol_ptr->enable_log_structured(); }
+
+    uint64_t clean(uint64_t max_bytes) {
+        auto ret = m_vol_ptr->clean(max_bytes).get();
+        RELEASE_ASSERT(ret.has_value(), "Clean failed for volume {}, error: {}", m_vol_name, ret.error());
+        return ret.value();
+    }
+
+    // Write the same data pattern to every page of the range.
+    void write_pattern(lba_t start_lba, uint32_t nblks, uint64_t data_pattern, bool fua = false) {
+        auto ret = write_pattern_async(start_lba, nblks, data_pattern, fua).get();
+        RELEASE_ASSERT(ret.has_value(), "Write failed for volume {}, error: {}", m_vol_name, ret.error());
+    }
+
+    void flush() {
+        auto ret = g_helper->inst()->volume_manager()->flush(m_vol_ptr).get();
+        RELEASE_ASSERT(ret.has_value(), "Flush failed for volume {}, error: {}", m_vol_name, ret.error());
+    }
+
+    // Expected data is updated when the write is issued, writes issued one after another are expected to land in
+    // the same order.
+    VolumeManager::NullAsyncResult write_pattern_async(lba_t start_lba, uint32_t nblks, uint64_t data_pattern,
+                                                       bool fua = false) {
+        auto const page_size = m_vol_ptr->info()->page_size;
+        auto data = sisl::make_byte_array(nblks * page_size, 512);
+        for (uint32_t i = 0; i < nblks; i++) {
+            test_common::HBTestHelper::fill_data_buf(data->bytes() + i * page_size, page_size, data_pattern);
+            std::lock_guard lock(m_mutex);
+            m_lba_data[start_lba + i] = data_pattern;
+        }
+
+        vol_interface_req_ptr req(new vol_interface_req{data->bytes(), start_lba, nblks, m_vol_ptr});
+        req->fua = fua;
+        return g_helper->inst()->volume_manager()->write(m_vol_ptr, req).thenValue([data, req](auto&& result) {
+            return result;
+        });
+    }
+
+    // Write the ranges with a single atomic write, every page filled with the same data pattern. The expected data is
+    // only updated if the write is expected to be visible after it. With a crash simulated, the write never completes
+    // successfully and its result is ignored.
+    VolumeManager::NullResult atomic_write_pattern(std::vector< std::pair< lba_t, uint32_t > > const& ranges,
+                                                   uint64_t data_pattern, bool store = true, bool crash = false) {
+        auto const page_size = m_vol_ptr->info()->page_size;
+        std::vector< vol_interface_req_ptr > reqs;
+        std::vector< sisl::byte_array > bufs;
+        for (auto const& [start_lba, nblks] : ranges) {
+            auto const& data = bufs.emplace_back(sisl::make_byte_array(nblks * page_size, 512));
+            for (uint32_t i = 0; i < nblks; i++) {
+                test_common::HBTestHelper::fill_data_buf(data->bytes() + i * page_size, page_size, data_pattern);
+                if (!store) { continue; }
+                std::lock_guard lock(m_mutex);
+                m_lba_data[start_lba + i] = data_pattern;
+            }
+            reqs.emplace_back(new vol_interface_req{data->bytes(), start_lba, nblks, m_vol_ptr});
+        }
+
+        auto fut = g_helper->inst()->volume_manager()->atomic_write(m_vol_ptr, reqs);
+        if (crash) {
+            fut.wait();
+            return VolumeManager::NullResult();
+        }
+        return std::move(fut).get();
+    }
+
+    uint64_t dedup_shared_blks() { return m_vol_ptr->dedup_index()->num_shared_blks(); }
+
     uint64_t read_count() { return m_read_count.load(); }
     uint64_t write_count() { return m_write_count.load(); }
 
@@ -344,6 +554,14 @@ private:
     std::string m_vol_name;
     VolumePtr m_vol_ptr;
     volume_id_t m_vol_id;
+    vol_checksum_type m_csum_type;
+    uint64_t m_page_size;
+    bool m_dedup;
+    vol_compression_type m_compression_type;
+    bool m_write_back_ack;
+    bool m_shared_journal;
+    bool m_mirrored;
+    uint32_t m_sector_size;
     static inline uint32_t m_volume_id_{1};
     // Mapping from lba to data patttern.
     std::map< lba_t, uint64_t > m_lba_data;
@@ -461,6 +679,15 @@ public:
 
     std::vector< shared< VolumeIOImpl > >& volume_list() { return m_vols_impl; }
 
+    shared< VolumeIOImpl > add_volume(vol_checksum_type csum_type, uint64_t page_size = g_page_size,
+                                      bool dedup = false,
+                                      vol_compression_type compression_type = vol_compression_type::NONE,
+                                      bool write_back_ack = false, bool shared_journal = false, bool mirrored = false,
+                                      uint32_t sector_size = 0) {
+        return m_vols_impl.emplace_back(std::make_shared< VolumeIOImpl >(
+            csum_type, page_size, dedup, compression_type, write_back_ack, shared_journal, mirrored, sector_size));
+    }
+
     template < typename T >
     T get_random_number(T min, T max) {
         std::uniform_int_distribution< T > dis(min, max);
@@ -557,6 +784,470 @@ TEST_F(VolumeIOTest, SingleVolumeReadHoles) {
     vol->verify_data(20000, 20100, 50);
 }
 
+TEST_F(VolumeIOTest, ScrubVolume) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 100 /* start_lba */, 1000 /* nblks */);
+    generate_write_io_single(vol, 5000 /* start_lba */, 200 /* nblks */);
+
+    // Background scrubber may have moved the cursor already, so only check that a full pass completes cleanly.
+    auto num_batches = vol->scrub_full_pass(64 * 4096);
+    LOGINFO("Scrubbed volume in {} batches", num_batches);
+    ASSERT_GT(num_batches, 0);
+
+#ifdef _PRERELEASE
+    // A page corrupted on its way to the device is found by scrub, which reports the mismatch.
+    g_helper->set_flip_point("vol_write_corrupt_data", 1 /* count */);
+    generate_write_io_single(vol, 3000 /* start_lba */, 1 /* nblks */);
+    g_helper->remove_flip("vol_write_corrupt_data");
+    uint64_t num_mismatched{0};
+    vol->scrub_full_pass(64 * 4096, &num_mismatched);
+    ASSERT_EQ(num_mismatched, 1ul);
+
+    // Rewritten page is good again.
+    generate_write_io_single(vol, 3000 /* start_lba */, 1 /* nblks */);
+    num_mismatched = 0;
+    vol->scrub_full_pass(64 * 4096, &num_mismatched);
+    ASSERT_EQ(num_mismatched, 0ul);
+#endif
+
+    // Scrub position is persisted every so many batches, scrub resumes from it after restart rather than from 0.
+    ASSERT_EQ(vol->scrub_cursor(), 0ul);
+    for (uint32_t i = 0; i < 20; ++i) {
+        ASSERT_NE(vol->scrub_batch(16 * g_page_size), 0ul);
+    }
+    restart(5);
+    ASSERT_GT(vol->scrub_cursor(), 0ul);
+    vol->scrub_full_pass(Mi);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, VolumeChecksumTypes) {
+    std::vector< shared< VolumeIOImpl > > vols;
+    for (auto csum_type : {vol_checksum_type::NONE, vol_checksum_type::CRC32C, vol_checksum_type::XXH3}) {
+        vols.push_back(add_volume(csum_type));
+    }
+
+    for (auto& vol : vols) {
+        generate_write_io_single(vol, 100 /* start_lba */, 500 /* nblks */);
+        verify_all_data(vol, 40 /* nlbas_per_io */);
+    }
+
+    // Checksum type is recovered from volume superblk and journal replay parses checksums of the right size.
+    restart(5);
+    for (auto& vol : vols) {
+        verify_all_data(vol, 40 /* nlbas_per_io */);
+    }
+}
+
+TEST_F(VolumeIOTest, LargePageVolume) {
+    std::vector< shared< VolumeIOImpl > > vols;
+    for (uint64_t page_size : {16 * Ki, 64 * Ki, 128 * Ki}) {
+        vols.push_back(add_volume(vol_checksum_type::CRC32C, page_size));
+    }
+
+    for (auto& vol : vols) {
+        // sequential pages followed by an overwrite in the middle and a few holes
+        generate_write_io_single(vol, 10 /* start_lba */, 8 /* nblks */);
+        generate_write_io_single(vol, 13 /* start_lba */, 2 /* nblks */);
+        generate_write_io_single(vol, 30 /* start_lba */, 1 /* nblks */);
+        vol->verify_data(0, 40, 7 /* nlbas_per_io */);
+        vol->scrub_full_pass(Mi);
+    }
+
+    restart(5);
+    for (auto& vol : vols) {
+        vol->verify_data(0, 40, 5 /* nlbas_per_io */);
+    }
+}
+
+TEST_F(VolumeIOTest, LargeIO) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 2000 /* nblks */);
+
+    // IOs larger than a sub IO are split internally, also when not aligned to sub IOs, and complete together.
+    auto const nblks = uint32_cast(4 * Mi / g_page_size);
+    vol->write_pattern(3 /* start_lba */, nblks + 5, 0xdeadbeef);
+    vol->verify_data(0, nblks + 100, nblks + 7 /* nlbas_per_io */);
+    restart(2);
+    vol->verify_data(0, nblks + 100, 50 /* nlbas_per_io */);
+
+    // IOs larger than max io size are rejected.
+    auto const max_nlbas = uint32_cast(g_helper->inst()->max_vol_io_size() / g_page_size);
+    sisl::io_blob_safe buf((max_nlbas + 1) * g_page_size, 512);
+    auto ret = vol->read_raw(0 /* start_lba */, max_nlbas + 1, buf.bytes());
+    ASSERT_EQ(ret.error(), VolumeError::INVALID_ARG);
+}
+
+TEST_F(VolumeIOTest, InlineWrite) {
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 16; });
+    HB_SETTINGS_FACTORY().save();
+
+    // Small writes are served from inline cache until destaged, overwrite some of them before destage.
+    auto vol = volume_list().back();
+    for (lba_t lba = 100; lba < 200; lba += 3) {
+        generate_write_io_single(vol, lba, 2 /* nblks */);
+    }
+    generate_write_io_single(vol, 150 /* start_lba */, 4 /* nblks */);
+    vol->verify_data(90, 210, 16 /* nlbas_per_io */);
+
+    // Large write overlapping pending pages goes through the regular path after destaging them.
+    generate_write_io_single(vol, 120 /* start_lba */, 40 /* nblks */);
+    vol->verify_data(90, 210, 16 /* nlbas_per_io */);
+
+    ASSERT_TRUE(vol->flush_inline_writes());
+    ASSERT_EQ(vol->inline_pending_pages(), 0ul);
+    vol->verify_data(90, 210, 16 /* nlbas_per_io */);
+
+    // Pages pending destage at shutdown are destaged, and read back after restart.
+    for (lba_t lba = 300; lba < 400; lba += 2) {
+        generate_write_io_single(vol, lba, 1 /* nblks */);
+    }
+    restart(5);
+    verify_all_data(vol);
+
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 0; });
+    HB_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VolumeIOTest, InlineWriteLogTruncation) {
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 16; });
+    HB_SETTINGS_FACTORY().save();
+
+    auto vol = volume_list().back();
+    for (lba_t lba = 100; lba < 300; lba += 4) {
+        generate_write_io_single(vol, lba, 2 /* nblks */);
+    }
+
+    // Inline written pages are destaged in cp flush before the journal is truncated past their entries, so after
+    // restart they are read from the destaged blks rather than replayed from the journal.
+    ASSERT_TRUE(homestore::hs()->cp_mgr().trigger_cp_flush(true /* force */).get());
+    ASSERT_EQ(vol->inline_pending_pages(), 0ul);
+    ASSERT_TRUE(homestore::hs()->cp_mgr().trigger_cp_flush(true /* force */).get());
+    restart(2);
+    verify_all_data(vol);
+
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 0; });
+    HB_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VolumeIOTest, ReadCache) {
+    // Read cache is only enabled by default for volumes on HDD data device.
+    auto vol = volume_list().back();
+    vol->enable_read_cache(Mi);
+    generate_write_io_single(vol, 100 /* start_lba */, 64 /* nblks */);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+    ASSERT_GT(vol->read_cache_pages(), 0ul);
+
+    // Served from read cache this time.
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+
+    // Overwrite drops the cached pages, reads see the new data.
+    generate_write_io_single(vol, 120 /* start_lba */, 8 /* nblks */);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, Advise) {
+    // Prefetched pages are kept by read cache, which is only enabled by default for volumes on HDD data device.
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 256 /* nblks */);
+    vol->enable_read_cache(4 * Mi);
+    ASSERT_TRUE(vol->advise(0, 64, vol_advice::WILLNEED).has_value());
+    ASSERT_EQ(vol->read_cache_pages(), 64ul);
+    ASSERT_TRUE(vol->advise(0, 64, vol_advice::DONTNEED).has_value());
+    ASSERT_EQ(vol->read_cache_pages(), 0ul);
+
+    // Reads in a range advised SEQUENTIAL are followed by read ahead, up to the end of the range.
+    ASSERT_TRUE(vol->advise(64, 64, vol_advice::SEQUENTIAL).has_value());
+    vol->read_and_verify(64, 8 /* nlbas */);
+    for (int i = 0; i < 100 && vol->read_cache_pages() < 64; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(vol->read_cache_pages(), 64ul);
+
+    // Not in a range with read ahead anymore.
+    ASSERT_TRUE(vol->advise(128, 64, vol_advice::RANDOM).has_value());
+    vol->read_and_verify(128, 8 /* nlbas */);
+    ASSERT_EQ(vol->read_cache_pages(), 72ul);
+
+    ASSERT_EQ(vol->advise(0, 0, vol_advice::WILLNEED).error(), VolumeError::INVALID_ARG);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, L2ReadCache) {
+    // L2 read cache is only created by default when formatting with HDD data device and fast device.
+    auto inst = HomeBlocksImpl::instance();
+    inst->enable_l2_cache(16 * Mi);
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 100 /* start_lba */, 64 /* nblks */);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+
+    // Pages read from data device are cached once appended to the log store.
+    for (int i = 0; i < 100 && inst->l2_cache()->num_pages() < 64; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GE(inst->l2_cache()->num_pages(), 64ul);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+
+    // Overwritten pages are no longer served from it.
+    generate_write_io_single(vol, 120 /* start_lba */, 8 /* nblks */);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+
+    // Cached pages are found again after restart.
+    restart(2);
+    inst = HomeBlocksImpl::instance();
+    ASSERT_NE(inst->l2_cache(), nullptr);
+    ASSERT_GT(inst->l2_cache()->num_pages(), 0ul);
+    vol->verify_data(100, 164, 16 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, TierPromotion) {
+    // Fast tier is the read cache, which is only enabled by default for volumes on HDD data device.
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 256 /* nblks */);
+    vol->enable_read_cache(4 * Mi);
+
+    // Reads spread over the first extent make it hot, promotion brings the rest of the extent to fast tier.
+    for (lba_t lba = 0; lba < 64; lba += 8) {
+        vol->read_and_verify(lba, 1 /* nlbas */);
+    }
+    vol->promote_hot_extents(Mi);
+    ASSERT_GE(vol->read_cache_pages(), 64ul);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, Warmup) {
+    // Extents read lately are persisted at graceful shutdown.
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 256 /* nblks */);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    restart(2);
+
+    // They are warmed up after restart, while the volume takes IOs.
+    auto inst = HomeBlocksImpl::instance();
+    ASSERT_GT(inst->warmup_saved_extents(), 0u);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    for (int i = 0; i < 100 && inst->warmup_pending_extents(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(inst->warmup_pending_extents(), 0ul);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, LogStructuredClean) {
+    // Log structured allocation is only enabled by default for volumes on HDD data device with log_structured_on.
+    auto vol = volume_list().back();
+    vol->enable_log_structured();
+    generate_write_io_single(vol, 0 /* start_lba */, 512 /* nblks */);
+
+    // Overwrites leave live blks scattered in the chunks written before, cleaning moves them while data stays intact.
+    for (uint32_t i = 0; i < 16; ++i) {
+        generate_write_io_single(vol, (i * 37) % 480 /* start_lba */, 32 /* nblks */);
+    }
+    for (uint32_t i = 0; i < 8; ++i) {
+        vol->clean(Mi);
+    }
+    verify_all_data(vol);
+
+    restart(2);
+    verify_all_data(vol);
+
+    // Chunks written before restart are found again by scanning index once after it.
+    vol->enable_log_structured();
+    for (uint32_t i = 0; i < 16; ++i) {
+        generate_write_io_single(vol, (i * 53) % 480 /* start_lba */, 32 /* nblks */);
+    }
+    for (uint32_t i = 0; i < 8; ++i) {
+        vol->clean(Mi);
+    }
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, Dedup) {
+    auto vol = add_volume(vol_checksum_type::CRC16, g_page_size, true /* dedup */);
+
+    // Same page written all over the volume is stored once, in a single write and across writes.
+    for (lba_t lba = 0; lba < 256; lba += 32) {
+        vol->write_pattern(lba, 32 /* nblks */, 0xdeadbeef);
+    }
+    ASSERT_EQ(vol->dedup_shared_blks(), 1ul);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+
+    // Overwrites drop references, the shared blk is kept for the lbas still mapping it.
+    generate_write_io_single(vol, 8 /* start_lba */, 64 /* nblks */);
+    vol->write_pattern(100, 50 /* nblks */, 0xfeedface);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+
+    // References are recounted from index after restart, overwriting the rest of the lbas keeps the data intact.
+    restart(5);
+    ASSERT_EQ(vol->dedup_shared_blks(), 2ul);
+    vol->write_pattern(150, 106 /* nblks */, 0xfeedface);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, Compression) {
+    auto vol = add_volume(vol_checksum_type::CRC32C, 16 * Ki, false /* dedup */, vol_compression_type::LZ4);
+
+    // Pattern filled pages are stored compressed, random ones as is, both are read back intact.
+    vol->write_pattern(0, 128 /* nblks */, 0xdeadbeef);
+    generate_write_io_single(vol, 64 /* start_lba */, 32 /* nblks */);
+    vol->write_pattern(200, 50 /* nblks */, 0xfeedface);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    vol->scrub_full_pass(Mi);
+
+    // Mapping of compressed pages is replayed from journal after restart.
+    restart(5);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    generate_write_io_single(vol, 100 /* start_lba */, 64 /* nblks */);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, AtomicWrite) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 2000 /* nblks */);
+
+    // Ranges written together are all there, also after restart.
+    ASSERT_TRUE(vol->atomic_write_pattern({{100, 8}, {300, 1}, {1000, 32}}, 0xdeadbeef));
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+    restart(2);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+
+    // Overlapping ranges are rejected without writing any of them.
+    auto ret = vol->atomic_write_pattern({{500, 8}, {504, 8}}, 0xfeedface, false /* store */);
+    ASSERT_EQ(ret.error(), VolumeError::INVALID_ARG);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, UnalignedBuffers) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 500 /* nblks */);
+
+    // IOs with unaligned buffers are served through aligned bounce buffers, small and large ones alike.
+    vol->write_read_unaligned(100, 1 /* nblks */, 0xdeadbeef);
+    vol->write_read_unaligned(200, 64 /* nblks */, 0xfeedface);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+
+    // Only buffers aligned for direct io can be registered.
+    auto vol_mgr = g_helper->inst()->volume_manager();
+    auto const align = g_helper->inst()->io_buf_align();
+    auto buf = sisl::make_byte_array(64 * Ki, align);
+    ASSERT_EQ(vol_mgr->register_io_buffer(buf->bytes() + 8, 4 * Ki).error(), VolumeError::INVALID_ARG);
+    ASSERT_TRUE(vol_mgr->register_io_buffer(buf->bytes(), 64 * Ki).has_value());
+    vol_mgr->unregister_io_buffer(buf->bytes());
+}
+
+TEST_F(VolumeIOTest, SmallSectors) {
+    auto vol = add_volume(vol_checksum_type::CRC32C, g_page_size, false /* dedup */, vol_compression_type::NONE,
+                          false /* write_back_ack */, false /* shared_journal */, false /* mirrored */, 512);
+    auto const spp = g_page_size / 512; // sectors per page
+
+    // Writes of whole pages, part of a page, across pages with partial head and tail pages.
+    ASSERT_TRUE(vol->write_sectors_async(0, 4 * spp, 1).get().has_value());
+    ASSERT_TRUE(vol->write_sectors_async(3, 1, 2).get().has_value());
+    ASSERT_TRUE(vol->write_sectors_async(spp - 2, spp + 5, 3).get().has_value());
+    vol->verify_sectors(0, 4 * spp);
+    vol->verify_sectors(spp - 1, 3);
+    ASSERT_GT(vol->partial_cached_pages(), 0ul);
+
+    // Writes of sectors of a page issued together are merged, every one of them lands, overlapping ones in issue order.
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (uint64_t i = 0; i < 2 * spp; ++i) {
+        futs.emplace_back(vol->write_sectors_async(8 * spp + (i % spp), 1, 100 + i));
+        if (i % 3 == 0) { futs.emplace_back(vol->write_sectors_async(8 * spp, spp, 200 + i)); }
+    }
+    for (auto& fut : futs) {
+        ASSERT_TRUE(std::move(fut).get().has_value());
+    }
+    vol->verify_sectors(0, 10 * spp);
+
+    restart(2);
+    vol->verify_sectors(0, 10 * spp);
+}
+
+TEST_F(VolumeIOTest, OverlappingWrites) {
+    auto vol = volume_list().back();
+
+    // Overlapping writes issued back to back without waiting land in issue order, the last one wins on every lba.
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (uint64_t i = 1; i <= 32; ++i) {
+        futs.emplace_back(vol->write_pattern_async(100 + (i % 8) * 4, 16 /* nblks */, i));
+    }
+    for (auto& fut : futs) {
+        ASSERT_TRUE(std::move(fut).get().has_value());
+    }
+    vol->verify_data(100, 144, 11 /* nlbas_per_io */);
+
+    restart(2);
+    vol->verify_data(100, 144, 11 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, ReadInflightWrites) {
+    auto vol = volume_list().back();
+
+    // Reads issued right behind overlapping writes, without waiting for them, see the data just written.
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (uint64_t i = 1; i <= 16; ++i) {
+        futs.emplace_back(vol->write_pattern_async(200 + (i % 4) * 8, 32 /* nblks */, i));
+        vol->verify_data(200, 264, 16 /* nlbas_per_io */);
+    }
+    for (auto& fut : futs) {
+        ASSERT_TRUE(std::move(fut).get().has_value());
+    }
+    vol->verify_data(200, 264, 16 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, WriteBackAck) {
+    auto vol = add_volume(vol_checksum_type::CRC32C, g_page_size, false /* dedup */, vol_compression_type::NONE,
+                          true /* write_back_ack */);
+
+    // Writes acked before their journal entry is committed are readable right away, and durable after flush.
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (uint64_t i = 1; i <= 64; ++i) {
+        futs.emplace_back(vol->write_pattern_async((i % 16) * 8, 16 /* nblks */, i));
+    }
+    for (auto& fut : futs) {
+        ASSERT_TRUE(std::move(fut).get().has_value());
+    }
+    vol->verify_data(0, 136, 16 /* nlbas_per_io */);
+
+    // Atomic write over lbas of acked writes not committed yet is journaled after them, replay keeps its data.
+    ASSERT_TRUE(vol->atomic_write_pattern({{8, 4}, {100, 8}}, 0xfeedface));
+    vol->verify_data(0, 136, 16 /* nlbas_per_io */);
+    vol->flush();
+
+    // FUA write waits for its own commit, along with the writes acked before it.
+    vol->write_pattern(8, 16 /* nblks */, 0xdeadbeef);
+    vol->write_pattern(16, 16 /* nblks */, 0xfeedface, true /* fua */);
+    vol->verify_data(0, 136, 16 /* nlbas_per_io */);
+
+    restart(2);
+    vol->verify_data(0, 136, 16 /* nlbas_per_io */);
+    generate_write_io_single(vol, 100 /* start_lba */, 64 /* nblks */);
+    vol->flush();
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, SharedJournal) {
+    std::vector< shared< VolumeIOImpl > > vols;
+    for (int i = 0; i < 3; ++i) {
+        vols.emplace_back(add_volume(vol_checksum_type::CRC32C, g_page_size, false /* dedup */,
+                                     vol_compression_type::NONE, false /* write_back_ack */,
+                                     true /* shared_journal */));
+    }
+
+    // Writes of all the volumes are journaled in the group journal, each volume gets back only its own after restart.
+    for (auto& vol : vols) {
+        generate_write_io_single(vol, 0 /* start_lba */, 256 /* nblks */);
+        vol->write_pattern(100, 16 /* nblks */, 0xdeadbeef);
+    }
+    restart(2);
+    for (auto& vol : vols) {
+        vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+        generate_write_io_single(vol, 50 /* start_lba */, 64 /* nblks */);
+        verify_all_data(vol);
+    }
+}
+
 TEST_F(VolumeIOTest, MultipleVolumeWriteData) {
     LOGINFO("Write data randomly on num_vols={} num_io={}", SISL_OPTIONS["num_vols"].as< uint32_t >(),
             SISL_OPTIONS["num_io"].as< uint64_t >());
@@ -760,13 +1451,16 @@ TEST_F(VolumeIOTest, WriteCrash) {
                                               "vol_write_crash_after_journal_write"};
 
     // Crash after writing to disk but before writing to journal.
-    // Read should return no data as there is no index.
+    // Read should return no data as there is no index. Blks of the write are free again after restart, homestore
+    // persists their allocation only along with the journal entry.
     uint32_t flip_idx{0};
     g_helper->set_flip_point(flip_points[flip_idx++]);
 
     auto vol = volume_list().back();
+    auto const used = g_helper->inst()->get_stats().used_capacity_bytes;
     generate_write_io_single(vol, 1000 /* start_lba */, 100 /* nblks*/);
     restart(2);
+    ASSERT_EQ(g_helper->inst()->get_stats().used_capacity_bytes, used);
     // TODO read and verify zeros for no data.
 
     // Crash after journal write. After crash, index should be recovered.
@@ -787,12 +1481,70 @@ TEST_F(VolumeIOTest, WriteCrash) {
     LOGINFO("WriteCrash test done");
 }
 
+TEST_F(VolumeIOTest, WriteDataFailure) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 500 /* nblks */);
+    auto const used = g_helper->inst()->get_stats().used_capacity_bytes;
+
+    // Blks allocated for writes failing on the data device are freed back, not left allocated until restart.
+    g_helper->set_flip_point("vol_write_data_failure", 5 /* count */);
+    for (uint32_t i = 0; i < 5; ++i) {
+        generate_write_io_single(vol, 1000 + i * 100 /* start_lba */, 100 /* nblks */, true /* wait */,
+                                 true /* expect_failure */);
+    }
+    g_helper->remove_flip("vol_write_data_failure");
+    for (uint32_t i = 0; i < 50 && g_helper->inst()->get_stats().used_capacity_bytes != used; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(g_helper->inst()->get_stats().used_capacity_bytes, used);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+}
+
+TEST_F(VolumeIOTest, AtomicWriteCrash) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 2000 /* nblks */);
+
+    // Crash after journal write, all the ranges are replayed from the single journal entry.
+    g_helper->set_flip_point("vol_write_crash_after_journal_write", 1 /* count */);
+    vol->atomic_write_pattern({{100, 8}, {700, 16}, {1500, 64}}, 0xfeedface, true /* store */, true /* crash */);
+    restart(2);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+    g_helper->remove_flip("vol_write_crash_after_journal_write");
+}
+
+TEST_F(VolumeIOTest, AtomicWriteIndexFailure) {
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 0 /* start_lba */, 2000 /* nblks */);
+    auto const used = g_helper->inst()->get_stats().used_capacity_bytes;
+
+    // Index failing on the last range restores the mappings of the ranges before it, and blks allocated for the write
+    // are freed back.
+    g_helper->set_flip_point("vol_atomic_write_index_failure", 1 /* count */);
+    auto ret = vol->atomic_write_pattern({{100, 8}, {700, 16}, {1500, 64}}, 0xfeedface, false /* store */);
+    ASSERT_EQ(ret.error(), VolumeError::INDEX_ERROR);
+    g_helper->remove_flip("vol_atomic_write_index_failure");
+    for (uint32_t i = 0; i < 50 && g_helper->inst()->get_stats().used_capacity_bytes != used; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(g_helper->inst()->get_stats().used_capacity_bytes, used);
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+
+    // Also with the lbas of the ranges not mapped before.
+    g_helper->set_flip_point("vol_atomic_write_index_failure", 1 /* count */);
+    ret = vol->atomic_write_pattern({{2100, 8}, {2300, 16}}, 0xfeedface, false /* store */);
+    ASSERT_EQ(ret.error(), VolumeError::INDEX_ERROR);
+    g_helper->remove_flip("vol_atomic_write_index_failure");
+    verify_all_data(vol, 50 /* nlbas_per_io */);
+    vol->verify_data(2100, 2316, 54 /* nlbas_per_io */);
+}
+
 TEST_F(VolumeIOTest, IndexPutFailure) {
     LOGINFO("IndexPutFailure test Started");
 
     auto vol = volume_list().back();
     generate_write_io_single(vol, 1000 /* start_lba */, 100 /* nblks*/);
     verify_all_data(vol, 30 /* nlbas_per_io */);
+    auto const used = g_helper->inst()->get_stats().used_capacity_bytes;
 
     // Fail after partial index put.
     g_helper->set_flip_point("vol_index_partial_put_failure", 1000 /*count*/);
@@ -806,6 +1558,140 @@ TEST_F(VolumeIOTest, IndexPutFailure) {
 
     // remove the flip points
     g_helper->remove_flip("vol_index_partial_put_failure");
+
+    // Blks of the failed writes are freed back.
+    for (uint32_t i = 0; i < 50 && g_helper->inst()->get_stats().used_capacity_bytes != used; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(g_helper->inst()->get_stats().used_capacity_bytes, used);
+}
+
+TEST_F(VolumeIOTest, InlineWriteJournalFailure) {
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 16; });
+    HB_SETTINGS_FACTORY().save();
+
+    auto vol = volume_list().back();
+    generate_write_io_single(vol, 100 /* start_lba */, 2 /* nblks */);
+
+    // Failed inline write is retried with regular write path and volume degrades to write-through.
+    g_helper->set_flip_point("vol_inline_write_journal_failure", 1 /*count*/);
+    generate_write_io_single(vol, 200 /* start_lba */, 2 /* nblks */);
+    ASSERT_TRUE(vol->inline_write_degraded());
+
+    // Pages pending destage before the failure are still served and destaged.
+    vol->verify_data(90, 210, 10 /* nlbas_per_io */);
+    generate_write_io_single(vol, 100 /* start_lba */, 4 /* nblks */);
+    ASSERT_EQ(vol->inline_pending_pages(), 0ul);
+    verify_all_data(vol);
+
+    g_helper->remove_flip("vol_inline_write_journal_failure");
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.inline_write_max_kb = 0; });
+    HB_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VolumeIOTest, WriteBackJournalFailure) {
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.write_back_max_kb = 64; });
+    HB_SETTINGS_FACTORY().save();
+    g_helper->set_flip_point("vol_write_back_simulation", 100000 /*count*/);
+
+    // Writes up to write_back_max_kb are acked once journaled on fast device.
+    auto vol = volume_list().back();
+    for (lba_t lba = 0; lba < 256; lba += 16) {
+        generate_write_io_single(vol, lba, 8 /* nblks */);
+    }
+    ASSERT_FALSE(vol->inline_write_degraded());
+
+    // Fast device failing to journal a write-back write has it written directly to the data device, and the volume
+    // stays write-through afterwards. Nothing acked before or after the failure is lost.
+    g_helper->set_flip_point("vol_inline_write_journal_failure", 1 /*count*/);
+    generate_write_io_single(vol, 300 /* start_lba */, 8 /* nblks */);
+    ASSERT_TRUE(vol->inline_write_degraded());
+    for (lba_t lba = 8; lba < 256; lba += 16) {
+        generate_write_io_single(vol, lba, 8 /* nblks */);
+    }
+    vol->verify_data(0, 308, 16 /* nlbas_per_io */);
+
+    g_helper->remove_flip("vol_inline_write_journal_failure");
+    g_helper->remove_flip("vol_write_back_simulation");
+    restart(2);
+    verify_all_data(vol);
+
+    HB_SETTINGS_FACTORY().modifiable_settings([](auto& s) { s.write_back_max_kb = 0; });
+    HB_SETTINGS_FACTORY().save();
+}
+
+TEST_F(VolumeIOTest, Mirror) {
+    auto vol = add_volume(vol_checksum_type::CRC32C, g_page_size, false /* dedup */, vol_compression_type::NONE,
+                          false /* write_back_ack */, false /* shared_journal */, true /* mirrored */);
+    generate_write_io_single(vol, 0 /* start_lba */, 256 /* nblks */);
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+
+    // Reads go to the primary copy while no other read is in flight. Pages corrupted on it are found by checksum,
+    // served from the mirror copy and repaired with it.
+    auto repaired = vol->mirror_repaired_pages();
+    g_helper->set_flip_point("vol_write_corrupt_data", 4 /* count */);
+    for (uint64_t i = 1; i <= 4; ++i) {
+        vol->write_pattern(i * 32, 16 /* nblks */, i);
+    }
+    g_helper->remove_flip("vol_write_corrupt_data");
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired + 4);
+
+    // Scrub verifies both copies, nothing is left to repair.
+    uint64_t num_mismatched{0};
+    vol->scrub_full_pass(Mi, &num_mismatched);
+    ASSERT_EQ(num_mismatched, 0ul);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired + 4);
+
+    // Writes lost on the mirror copy are never read while the primary copy is good, scrub finds and repairs them.
+    g_helper->set_flip_point("vol_mirror_lost_copy_write", 1 /* count */);
+    vol->write_pattern(200, 16 /* nblks */, 0xdeadbeef);
+    g_helper->remove_flip("vol_mirror_lost_copy_write");
+    vol->verify_data(0, 256, 16 /* nlbas_per_io */);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired + 4);
+    vol->scrub_full_pass(Mi, &num_mismatched);
+    ASSERT_EQ(num_mismatched, 0ul);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired + 20);
+    vol->scrub_full_pass(Mi, &num_mismatched);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired + 20);
+
+    // A write failing on the mirror copy succeeds with its lbas marked dirty in superblk, which survives restart. They
+    // are resynced from the primary copy once the mirror copy can be written again, scrub has nothing to repair then.
+    g_helper->set_flip_point("vol_mirror_copy_write_failure", 100000 /* count */);
+    vol->write_pattern(64, 32 /* nblks */, 0xfeedface);
+    ASSERT_EQ(vol->num_mirror_dirty_ranges(), 1u);
+    restart(2);
+    ASSERT_EQ(vol->num_mirror_dirty_ranges(), 1u);
+    g_helper->remove_flip("vol_mirror_copy_write_failure");
+    for (int i = 0; i < 500 && vol->num_mirror_dirty_ranges(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(vol->num_mirror_dirty_ranges(), 0u);
+    repaired = vol->mirror_repaired_pages();
+    vol->scrub_full_pass(Mi, &num_mismatched);
+    ASSERT_EQ(num_mismatched, 0ul);
+    ASSERT_EQ(vol->mirror_repaired_pages(), repaired);
+    verify_all_data(vol);
+}
+
+TEST_F(VolumeIOTest, MigrateV3Superblk) {
+    // Volume superblk is persisted in version 0x3 layout, as by the previous release, after data is written to it.
+    g_helper->set_flip_point("vol_sb_write_v3", 1 /* count */);
+    auto vol = add_volume(vol_checksum_type::CRC16);
+    g_helper->remove_flip("vol_sb_write_v3");
+    generate_write_io_single(vol, 100 /* start_lba */, 500 /* nblks */);
+
+    // It is migrated on load and the index values with 16 bit checksums are read as before.
+    restart(5);
+    ASSERT_TRUE(vol->is_online());
+    ASSERT_EQ(vol->checksum_type(), vol_checksum_type::CRC16);
+    verify_all_data(vol, 40 /* nlbas_per_io */);
+
+    // Migrated superblk is persisted, so is data written after.
+    generate_write_io_single(vol, 1000 /* start_lba */, 100 /* nblks */);
+    restart(5);
+    ASSERT_TRUE(vol->is_online());
+    verify_all_data(vol, 40 /* nlbas_per_io */);
 }
 #endif
 
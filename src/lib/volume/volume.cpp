@@ -15,8 +15,10 @@
  *********************************************************************************/
 #include "volume.hpp"
 #include "lib/homeblks_impl.hpp"
+#include "lib/home_blks_config.hpp"
 #include <homestore/replication_service.hpp>
 #include <iomgr/iomgr_flip.hpp>
+#include <unordered_set>
 
 namespace homeblocks {
 static VolumeError to_volume_error(std::error_code ec) {
@@ -40,8 +42,10 @@ shared< VolumeIndexTable > Volume::init_index_table(bool is_recovery, shared< Vo
         cfg.m_leaf_node_type = btree_leaf_node_type;
         cfg.m_int_node_type = btree_int_node_type;
 
-        // create index table;
+        // create index table, its uuid tells the width of checksums in its values at recovery;
+        bool const wide_checksum = is_wide_checksum(vol_info_->checksum_type);
         auto uuid = hb_utils::gen_random_uuid();
+        if (wide_checksum) { uuid = wide_checksum_index_uuid(uuid); }
 
         // user_sb_size is not currently enabled in homestore;
         // parent uuid is used during recovery in homeblks layer;
@@ -57,9 +61,12 @@ shared< VolumeIndexTable > Volume::init_index_table(bool is_recovery, shared< Vo
         }
 
         LOGI("index table is going to be created with {} chunks on pdev id {}", chunk_ids.size(), pdev_id);
-        indx_tbl_ = std::make_shared< VolumeIndexTable >(uuid, id() /* parent uuid */, 0 /* user_sb_size */, cfg,
-                                                         ordinal(), chunk_ids, pdev_id, index_size);
+        indx_tbl_ = std::make_shared< VolumeIndexTable >(wide_checksum, uuid, id() /* parent uuid */,
+                                                         0 /* user_sb_size */, cfg, ordinal(), chunk_ids, pdev_id,
+                                                         index_size);
     } else {
+        DEBUG_ASSERT(!sb_supported_ || tbl->wide_checksum() == is_wide_checksum(vol_info_->checksum_type),
+                     "Index checksum width mismatch for volume: {}", vol_info_->name);
         indx_tbl_ = tbl;
     }
 
@@ -71,31 +78,121 @@ Volume::Volume(sisl::byte_view const& buf, void* cookie, shared< VolumeChunkSele
                shared< VolumeChunkSelector > index_chunk_sel) :
         sb_{VOL_META_NAME}, volume_chunk_selector_{vol_chunk_sel}, index_chunk_selector_{index_chunk_sel} {
     sb_.load(buf, cookie);
-    // generate volume info from sb;
+    RELEASE_ASSERT_EQ(sb_->magic, VOL_SB_MAGIC, "Volume superblk magic mismatch");
+    if (sb_->version == VOL_SB_VER_V3) { migrate_v3_sb(); }
+    // generate volume info from sb; superblk of another version, e.g. written by a newer release, only has its fields
+    // common to all versions read, the volume is kept offline.
     vol_info_ = std::make_shared< VolumeInfo >(sb_->id, sb_->size, sb_->page_size, sb_->name, sb_->ordinal);
+    vol_info_->sector_size = sb_->page_size;
+    sb_supported_ = (sb_->version == VOL_SB_VER);
+    if (sb_supported_) {
+        vol_info_->checksum_type = sb_->checksum_type;
+        vol_info_->tier_policy = sb_->tier_policy;
+        vol_info_->dedup = sb_->dedup;
+        vol_info_->compression_type = sb_->compression_type;
+        vol_info_->write_back_ack = sb_->write_back_ack;
+        vol_info_->shared_journal = sb_->shared_journal;
+        vol_info_->mirrored = sb_->mirrored;
+        if (sb_->sector_size) { vol_info_->sector_size = sb_->sector_size; }
+    } else {
+        LOGE("Volume: {} uuid: {} superblk version {} not supported, expected {}", vol_info_->name,
+             boost::uuids::to_string(vol_info_->id), sb_->version, VOL_SB_VER);
+    }
     metrics_ = std::make_unique< VolumeMetrics >(vol_info_->name);
+    inline_cache_ = std::make_unique< InlineWriteCache >(vol_info_->page_size);
     m_state_ = sb_->state;
     LOGI("Volume superblock loaded from disk, vol_info : {}", vol_info_->to_string());
 }
 
+// Version 0x3 superblks predate checksum types and the other volume options since, their volumes use CRC16 and have
+// the rest at defaults. Index values of CRC16 volumes are laid out as in that release.
+void Volume::migrate_v3_sb() {
+    auto const* v3_sb = r_cast< vol_sb_v3_t const* >(sb_.get());
+    auto const v3 = *v3_sb;
+    std::vector< chunk_num_t > chunk_ids(v3_sb->get_chunk_ids(), v3_sb->get_chunk_ids() + v3.num_chunks);
+    LOGI("Migrating superblk of volume: {} uuid: {} from version {} to {}", v3.name, boost::uuids::to_string(v3.id),
+         v3.version, VOL_SB_VER);
+
+    sb_.resize(sizeof(vol_sb_t) + (chunk_ids.size() * sizeof(homestore::chunk_num_t)));
+    sb_->init(v3.page_size, v3.page_size /* sector_size */, v3.size, v3.id, std::string(v3.name), v3.ordinal,
+              vol_checksum_type::CRC16, vol_tier_policy::AUTO, false /* dedup */, vol_compression_type::NONE,
+              false /* write_back_ack */, false /* shared_journal */, v3.pdev_id, chunk_ids, 0 /* mirror_pdev */,
+              {} /* mirror_chunk_ids */);
+    // resize keeps the old content, so fields init doesn't set are reset here.
+    sb_->num_streams = v3.num_streams;
+    sb_->state = v3.state;
+    sb_->scrub_cursor = 0;
+    sb_.write();
+}
+
+#ifdef _PRERELEASE
+void Volume::write_v3_sb() {
+    RELEASE_ASSERT(!mirrored(), "Version 0x3 superblk can't hold mirrored volume: {}", vol_info_->name);
+    std::scoped_lock lg(sb_lock_);
+    auto const num_chunks = sb_->num_chunks;
+    auto const chunk_ids_size = num_chunks * sizeof(homestore::chunk_num_t);
+    std::vector< uint8_t > cur_sb(sizeof(vol_sb_t) + chunk_ids_size);
+    std::memcpy(cur_sb.data(), sb_.get(), cur_sb.size());
+    auto const* cur = r_cast< vol_sb_t const* >(cur_sb.data());
+
+    sb_.resize(sizeof(vol_sb_v3_t) + chunk_ids_size);
+    auto* v3 = r_cast< vol_sb_v3_t* >(sb_.get());
+    v3->magic = cur->magic;
+    v3->version = VOL_SB_VER_V3;
+    v3->num_streams = cur->num_streams;
+    v3->page_size = cur->page_size;
+    v3->size = cur->size;
+    v3->id = cur->id;
+    std::memcpy(v3->name, cur->name, VOL_NAME_SIZE);
+    v3->state = cur->state;
+    v3->ordinal = cur->ordinal;
+    v3->pdev_id = cur->pdev_id;
+    v3->num_chunks = num_chunks;
+    std::memcpy(uintptr_cast(v3) + sizeof(vol_sb_v3_t), cur->get_chunk_ids(), chunk_ids_size);
+    sb_.write();
+
+    sb_.resize(cur_sb.size());
+    std::memcpy(sb_.get(), cur_sb.data(), cur_sb.size());
+    LOGI("Persisted superblk of volume: {} in version {} layout", vol_info_->name, VOL_SB_VER_V3);
+}
+#endif
+
 bool Volume::init(bool is_recovery) {
     if (!is_recovery) {
         // first time creation of the Volume, let's write the superblock;
 
-        // Allocate initial set of chunks for the volume with thin provisioning.
+        // Allocate initial set of chunks for the volume with thin provisioning. Mirrored volume has all its chunks
+        // allocated upfront, each paired with a chunk holding its copy on another pdev.
         uint32_t pdev_id;
-        auto chunk_ids =
-            volume_chunk_selector_->allocate_init_chunks(vol_info_->ordinal, vol_info_->size_bytes, pdev_id);
+        auto chunk_ids = volume_chunk_selector_->allocate_init_chunks(vol_info_->ordinal, vol_info_->size_bytes,
+                                                                      pdev_id, !mirrored() /* lazy alloc */);
         if (chunk_ids.empty()) {
             LOGE("Failed to allocate chunks for volume: {}, uuid: {}", vol_info_->name,
                  boost::uuids::to_string(vol_info_->id));
             return false;
         }
 
+        uint32_t mirror_pdev_id{0};
+        std::vector< chunk_num_t > mirror_chunk_ids;
+        if (mirrored()) {
+            mirror_chunk_ids = volume_chunk_selector_->allocate_mirror_chunks(vol_info_->ordinal, mirror_pdev_id);
+            if (mirror_chunk_ids.empty()) {
+                LOGE("Failed to allocate mirror chunks for volume: {}, uuid: {}", vol_info_->name,
+                     boost::uuids::to_string(vol_info_->id));
+                volume_chunk_selector_->release_chunks(vol_info_->ordinal);
+                return false;
+            }
+            for (size_t i = 0; i < chunk_ids.size(); ++i) {
+                mirror_chunks_.emplace(chunk_ids[i], mirror_chunk_ids[i]);
+            }
+        }
+
         // 0. create the superblock and store chunk id's
-        sb_.create(sizeof(vol_sb_t) + (chunk_ids.size() * sizeof(homestore::chunk_num_t)));
-        sb_->init(vol_info_->page_size, vol_info_->size_bytes, vol_info_->id, vol_info_->name, vol_info_->ordinal,
-                  pdev_id, chunk_ids);
+        sb_.create(sizeof(vol_sb_t) + ((chunk_ids.size() + mirror_chunk_ids.size()) * sizeof(homestore::chunk_num_t)));
+        sb_->init(vol_info_->page_size, vol_info_->sector_size, vol_info_->size_bytes, vol_info_->id, vol_info_->name,
+                  vol_info_->ordinal, vol_info_->checksum_type, vol_info_->tier_policy, vol_info_->dedup,
+                  vol_info_->compression_type, vol_info_->write_back_ack, vol_info_->shared_journal, pdev_id, chunk_ids,
+                  mirror_pdev_id, mirror_chunk_ids);
 
         // 1. create solo repl dev for volume;
         // members left empty on purpose for solo repl dev
@@ -117,12 +214,20 @@ bool Volume::init(bool is_recovery) {
 
         // 3. mark state as online;
         state_change(vol_state::ONLINE);
+#ifdef _PRERELEASE
+        if (iomgr_flip::instance()->test_flip("vol_sb_write_v3")) { write_v3_sb(); }
+#endif
 
         LOGI("Created volume: {} uuid: {} ordinal: {} size: {} pdev: {} num_chunks: {}", vol_info_->name,
              boost::uuids::to_string(vol_info_->id), vol_info_->ordinal, vol_info_->size_bytes, pdev_id,
              chunk_ids.size());
     } else {
         // recovery path
+        if (!sb_supported_) {
+            // nothing beyond the identity of the volume is known, it is put offline by volume manager;
+            m_state_ = sb_->state;
+            return true;
+        }
         LOGI("Getting repl dev for volume: {}, uuid: {}", vol_info_->name, boost::uuids::to_string(id()));
         auto ret = homestore::hs()->repl_service().get_repl_dev(id());
 
@@ -146,17 +251,197 @@ bool Volume::init(bool is_recovery) {
             return false;
         }
 
+        if (mirrored()) {
+            std::vector< chunk_num_t > mirror_chunk_ids(sb_->get_mirror_chunk_ids(),
+                                                        sb_->get_mirror_chunk_ids() + sb_->num_chunks);
+            if (!volume_chunk_selector_->recover_mirror_chunks(vol_info_->ordinal, sb_->mirror_pdev_id,
+                                                               mirror_chunk_ids)) {
+                LOGI("Failed to recover mirror chunks for volume name: {}, uuid: {}", vol_info_->name,
+                     boost::uuids::to_string(vol_info_->id));
+                return false;
+            }
+            for (size_t i = 0; i < chunk_ids.size(); ++i) {
+                mirror_chunks_.emplace(chunk_ids[i], mirror_chunk_ids[i]);
+            }
+        }
+
         LOGI("Recovered volume: {} uuid: {} ordinal: {} size: {} pdev: {} num_chunks: {}", vol_info_->name,
              boost::uuids::to_string(vol_info_->id), vol_info_->ordinal, vol_info_->size_bytes, sb_->pdev_id,
              chunk_ids.size());
         // index table will be recovered via in subsequent callback with init_index_table API;
     }
 
+    // Recently read pages are cached in memory to save seeks on HDD data device.
+    if (homestore::hs()->data_service().get_dev_type() == homestore::HSDevType::Data &&
+        HB_DYNAMIC_CONFIG(read_cache_mb)) {
+        enable_read_cache(HB_DYNAMIC_CONFIG(read_cache_mb) * Mi);
+    }
+
+    // Random overwrites on HDD data device are turned into sequential writes. Deduped pages would stay mapped to the
+    // chunks cleaned, they are left out. So are mirrored volumes, their chunks are paired upfront and repair of a
+    // mirrored page read by the cleaner would wait for the range lock the cleaner holds.
+    if (homestore::hs()->data_service().get_dev_type() == homestore::HSDevType::Data &&
+        HB_DYNAMIC_CONFIG(log_structured_on) && !vol_info_->dedup && !mirrored()) {
+        enable_log_structured();
+    }
+
+    // Extents overwritten often are told apart for hot/cold separation of their blks.
+    if (HB_DYNAMIC_CONFIG(hot_overwrite_min)) {
+        auto const extent_pages = std::max(HB_DYNAMIC_CONFIG(hot_extent_kb) * Ki / vol_info_->page_size, 1ul);
+        overwrite_heat_ = std::make_unique< AccessTracker >(uint32_cast(extent_pages));
+    }
+
+    // Lately read extents are warmed up after restart.
+    if (HB_DYNAMIC_CONFIG(warmup_max_mb)) { track_access(); }
+
+    if (vol_info_->dedup) { dedup_index_ = std::make_unique< DedupIndex >(HB_DYNAMIC_CONFIG(dedup_cache_mb) * Mi); }
+    if (vol_info_->sector_size < vol_info_->page_size) {
+        partial_pages_ = std::make_unique< PartialPageMerger >(vol_info_->page_size,
+                                                               HB_DYNAMIC_CONFIG(partial_page_cache_mb) * Mi);
+    }
+
     // set the in memory state from superblock;
     m_state_ = sb_->state;
     return true;
 }
 
+void Volume::enable_read_cache(uint64_t capacity_bytes) {
+    LOGI("Enabling read cache of {} bytes for volume: {}", capacity_bytes, vol_info_->name);
+    read_cache_ = std::make_unique< ReadCache >(vol_info_->page_size, capacity_bytes);
+
+    // Read cache is the fast tier hot extents are promoted to.
+    if (tier_policy() == vol_tier_policy::AUTO) { track_access(); }
+}
+
+void Volume::track_access() {
+    if (access_tracker_) { return; }
+    auto const extent_pages = std::max(HB_DYNAMIC_CONFIG(tier_extent_kb) * Ki / vol_info_->page_size, 1ul);
+    access_tracker_ = std::make_unique< AccessTracker >(uint32_cast(extent_pages));
+}
+
+VolumeManager::AsyncResult< uint64_t > Volume::promote_hot_extents(uint64_t max_bytes) {
+    if (!access_tracker_) { return VolumeManager::Result< uint64_t >(0); }
+    if (!read_cache_) {
+        // Only tracked for warmup, heat still has to follow recent reads.
+        access_tracker_->decay();
+        return VolumeManager::Result< uint64_t >(0);
+    }
+
+    auto const page_size = vol_info_->page_size;
+    auto const extent_pages = access_tracker_->extent_pages();
+    auto const max_extents = std::max(max_bytes / (extent_pages * page_size), 1ul);
+    auto hot_extents = access_tracker_->pick_hot(uint32_cast(max_extents), HB_DYNAMIC_CONFIG(tier_hot_min_reads));
+    access_tracker_->decay();
+
+    auto const max_lba = vol_info_->size_bytes / page_size;
+    uint64_t promote_size{0};
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (auto const start_lba : hot_extents) {
+        auto const nlbas = static_cast< lba_count_t >(std::min< lba_t >(extent_pages, max_lba - start_lba));
+        if (read_cache_->contains(start_lba, nlbas)) { continue; }
+
+        // Read of the extent fills read cache with its mapped pages, the buffer is dropped after.
+        auto buf = std::make_shared< sisl::io_blob_safe >(uint32_cast(nlbas * page_size), 512);
+        vol_interface_req_ptr req(new vol_interface_req{buf->bytes(), start_lba, nlbas, shared_from_this()});
+        futs.emplace_back(read(req).thenValue([buf, req](auto&& result) { return result; }));
+        promote_size += nlbas * page_size;
+    }
+
+    return folly::collectAllUnsafe(futs).thenValue([this, promote_size](auto&&) -> VolumeManager::Result< uint64_t > {
+        COUNTER_INCREMENT(*metrics_, volume_tier_promote_size_total, promote_size);
+        auto const fast_tier_pages = read_cache_->num_pages() + inline_cache_->num_pages();
+        GAUGE_UPDATE(*metrics_, volume_fast_tier_size, fast_tier_pages * vol_info_->page_size);
+        GAUGE_UPDATE(*metrics_, volume_hot_extent_count, access_tracker_->num_extents());
+        return promote_size;
+    });
+}
+
+std::vector< std::pair< lba_t, lba_count_t > > Volume::hot_extents(uint64_t max_bytes) {
+    std::vector< std::pair< lba_t, lba_count_t > > extents;
+    if (!access_tracker_ || max_bytes == 0) { return extents; }
+
+    auto const page_size = vol_info_->page_size;
+    auto const extent_pages = access_tracker_->extent_pages();
+    auto const max_extents = std::max(max_bytes / (extent_pages * page_size), 1ul);
+    auto const max_lba = vol_info_->size_bytes / page_size;
+    for (auto const start_lba : access_tracker_->pick_hot(uint32_cast(max_extents), 1 /* min_heat */)) {
+        auto const nlbas = static_cast< lba_count_t >(std::min< lba_t >(extent_pages, max_lba - start_lba));
+        extents.emplace_back(start_lba, nlbas);
+    }
+    return extents;
+}
+
+VolumeManager::NullAsyncResult Volume::prefetch(lba_t start_lba, lba_count_t nlbas) {
+    if (read_cache_ || l2_cache()) {
+        // Read of the range fills the read caches with its mapped pages, the buffer is dropped after.
+        auto buf = std::make_shared< sisl::io_blob_safe >(uint32_cast(nlbas * vol_info_->page_size), 512);
+        vol_interface_req_ptr req(new vol_interface_req{buf->bytes(), start_lba, nlbas, shared_from_this()});
+        return read(req).thenValue([buf, req](auto&& result) { return result; });
+    }
+
+    // Index lookup alone brings the index nodes in.
+    vol_interface_req_ptr req(new vol_interface_req{nullptr, start_lba, nlbas, shared_from_this()});
+    index_kv_list_t index_kvs;
+    if (auto ret = indx_table()->read_from_index(req, index_kvs); !ret.has_value()) {
+        return std::unexpected(ret.error());
+    }
+    return VolumeManager::NullResult();
+}
+
+void Volume::drop_cached(lba_t start_lba, lba_t end_lba) {
+    if (read_cache_) { read_cache_->invalidate(start_lba, end_lba); }
+    if (auto l2 = l2_cache(); l2) { l2->invalidate(ordinal(), start_lba, end_lba); }
+}
+
+void Volume::set_read_ahead(lba_t start_lba, lba_t end_lba, bool on) {
+    std::scoped_lock lg(read_ahead_mtx_);
+    // Ranges overlapping the new one are cut to what is out of it.
+    auto it = read_ahead_ranges_.lower_bound(start_lba);
+    if (it != read_ahead_ranges_.begin() && std::prev(it)->second.end_lba >= start_lba) { --it; }
+    std::vector< std::pair< lba_t, read_ahead_range_t > > rest;
+    while (it != read_ahead_ranges_.end() && it->first <= end_lba) {
+        auto const& [start, range] = *it;
+        if (start < start_lba) { rest.emplace_back(start, read_ahead_range_t{start_lba - 1, range.next_lba}); }
+        if (range.end_lba > end_lba) {
+            rest.emplace_back(end_lba + 1, read_ahead_range_t{range.end_lba, std::max(end_lba + 1, range.next_lba)});
+        }
+        it = read_ahead_ranges_.erase(it);
+    }
+    read_ahead_ranges_.insert(rest.begin(), rest.end());
+
+    if (!on) { return; }
+    if (read_ahead_ranges_.size() >= MAX_READ_AHEAD_RANGES) {
+        LOGW("Too many ranges with read ahead on volume: {}, ignoring range=[{}, {}]", vol_info_->name, start_lba,
+             end_lba);
+        return;
+    }
+    read_ahead_ranges_.emplace(start_lba, read_ahead_range_t{end_lba, start_lba});
+}
+
+void Volume::read_ahead(lba_t start_lba, lba_count_t nlbas) {
+    if (!read_cache_ && !l2_cache()) { return; }
+
+    // Prefetch the next window once the reads are within half of it from what is prefetched already.
+    auto const window = std::max(HB_DYNAMIC_CONFIG(readahead_kb) * Ki / vol_info_->page_size, 1ul);
+    auto const read_end = start_lba + nlbas;
+    lba_t from, to;
+    {
+        std::scoped_lock lg(read_ahead_mtx_);
+        if (read_ahead_ranges_.empty()) { return; }
+        auto it = read_ahead_ranges_.upper_bound(start_lba);
+        if (it == read_ahead_ranges_.begin()) { return; }
+        auto& range = (--it)->second;
+        if (range.end_lba < start_lba || range.next_lba >= read_end + window / 2) { return; }
+        from = std::max(read_end, range.next_lba);
+        to = std::min(range.end_lba, read_end + window - 1);
+        if (from > to) { return; }
+        range.next_lba = to + 1;
+    }
+
+    COUNTER_INCREMENT(*metrics_, volume_read_ahead_size_total, (to - from + 1) * vol_info_->page_size);
+    prefetch(from, uint32_cast(to - from + 1));
+}
+
 void Volume::destroy() {
     LOGI("Start destroying volume: {}, uuid: {}", vol_info_->name, boost::uuids::to_string(id()));
     destroy_started_ = true;
@@ -195,146 +480,905 @@ void Volume::destroy() {
 }
 
 void Volume::update_vol_sb_cb(const std::vector< chunk_num_t >& chunk_ids) {
-    // Update the volume superblk with latest set of chunk id's.
+    // Update the volume superblk with latest set of chunk id's. Mirrored volume chunks are never resized.
+    RELEASE_ASSERT(!mirrored(), "Resize of mirrored volume: {}", vol_info_->name);
+    std::scoped_lock lg(sb_lock_);
     uint32_t pdev_id = sb_->pdev_id;
+    auto const scrub_cursor = sb_->scrub_cursor;
     sb_.resize(sizeof(vol_sb_t) + (chunk_ids.size() * sizeof(homestore::chunk_num_t)));
-    sb_->init(vol_info_->page_size, vol_info_->size_bytes, vol_info_->id, vol_info_->name, vol_info_->ordinal, pdev_id,
-              chunk_ids);
+    sb_->init(vol_info_->page_size, vol_info_->sector_size, vol_info_->size_bytes, vol_info_->id, vol_info_->name,
+              vol_info_->ordinal, vol_info_->checksum_type, vol_info_->tier_policy, vol_info_->dedup,
+              vol_info_->compression_type, vol_info_->write_back_ack, vol_info_->shared_journal, pdev_id, chunk_ids,
+              0 /* mirror_pdev */, {} /* mirror_chunk_ids */);
+    sb_->scrub_cursor = scrub_cursor;
     sb_.write();
 }
 
 VolumeManager::NullAsyncResult Volume::write(const vol_interface_req_ptr& vol_req) {
+    // A regular write can't race with destage of the same lbas, otherwise the destaged older data could land in index
+    // after this write. Destage the pending inline pages first.
+    if (inline_cache_->overlaps(vol_req->lba, vol_req->end_lba())) {
+        return destage(std::numeric_limits< uint32_t >::max())
+            .thenValue([this, vol_req](bool success) -> VolumeManager::NullAsyncResult {
+                if (!success) {
+                    LOGE("Failed to destage inline writes before write to lba: {}, nlbas: {}, volume: {}",
+                         vol_req->lba, vol_req->nlbas, vol_info_->name);
+                    return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
+                }
+                return write(vol_req);
+            });
+    }
+    return write_data(vol_req);
+}
+
+VolumeManager::NullAsyncResult Volume::locked_write(lba_t start_lba, lba_t end_lba, uint8_t const* data,
+                                                    folly::Function< VolumeManager::NullAsyncResult() >&& write_fn) {
+    auto [lock_id, granted] = range_lock_.lock(start_lba, end_lba, data);
+    if (!granted.isReady()) { COUNTER_INCREMENT(*metrics_, volume_range_lock_wait_count, 1); }
+    return std::move(granted)
+        .thenValue([write_fn = std::move(write_fn)](auto&&) mutable { return write_fn(); })
+        .ensure([vol = shared_from_this(), lock_id]() { vol->range_lock_.unlock(lock_id); });
+}
+
+VolumeManager::NullAsyncResult Volume::write_data(const vol_interface_req_ptr& vol_req, int64_t destage_lsn) {
     vol_req->io_start_time = Clock::now();
-    // Step 1. Allocate new blkids. Homestore might return multiple blkid's pointing
-    // to different contigious memory locations.
-    auto data_size = vol_req->nlbas * rd()->get_blk_size();
+    // Step 1. With dedup, pages with the same content as an existing blk or an earlier page of this write are mapped to
+    // that blk instead of being written.
+    vol_dedup_ctx dedup;
+    if (dedup_index_) { lookup_dedup(vol_req, dedup); }
+
+    // Step 2. With compression, pages to be written are compressed on a worker pool, not to hold the reactor.
+    auto const num_written = vol_req->nlbas - dedup.cached.size() - dedup.dups.size();
+    if (compression_type() != vol_compression_type::NONE && vol_info_->page_size > rd()->get_blk_size() &&
+        num_written && !bypass_compression()) {
+        auto fut = compress_pages(vol_req, dedup);
+        return std::move(fut).thenValue(
+            [this, vol_req, destage_lsn, dedup = std::move(dedup)](vol_compress_ctx&& compress) mutable {
+                return write_pages(vol_req, destage_lsn, std::move(dedup), std::move(compress));
+            });
+    }
+    return write_pages(vol_req, destage_lsn, std::move(dedup), vol_compress_ctx{});
+}
+
+VolumeManager::NullAsyncResult Volume::write_pages(const vol_interface_req_ptr& vol_req, int64_t destage_lsn,
+                                                   vol_dedup_ctx&& dedup, vol_compress_ctx&& compress) {
+    // Step 3. Allocate new blkids for the pages to be written, compressed pages take fewer blks. Homestore might return
+    // multiple blkid's pointing to different contigious memory locations.
+    auto const page_size = vol_info_->page_size;
+    auto const blk_size = rd()->get_blk_size();
+    std::vector< std::pair< lba_count_t, homestore::blk_count_t > > written; // page offset, number of blks stored;
+    uint64_t data_size{0};
+    for (lba_count_t i = 0; i < vol_req->nlbas; ++i) {
+        if (!dedup.is_written(i)) { continue; }
+        auto it = compress.pages.find(i);
+        auto const stored_size = (it != compress.pages.end()) ? it->second.second : page_size;
+        written.emplace_back(i, static_cast< homestore::blk_count_t >(stored_size / blk_size));
+        data_size += stored_size;
+    }
+
     homestore::blk_alloc_hints hints;
-    hints.application_hint = vol_info_->ordinal;
+    hints.application_hint = VolumeChunkSelector::alloc_hint(
+        vol_info_->ordinal, !vol_req->relocation && is_hot(vol_req->lba, vol_req->nlbas));
     std::vector< homestore::MultiBlkId > new_blkids;
-    auto result = rd()->alloc_blks(data_size, hints, new_blkids);
-    if (result) {
-        LOGE("Failed to allocate blocks");
-        return std::unexpected(VolumeError::NO_SPACE_LEFT);
+    if (data_size) {
+        auto result = rd()->alloc_blks(data_size, hints, new_blkids);
+        if (result) {
+            LOGE("Failed to allocate blocks");
+            release_dedup_refs(dedup.refs);
+            return std::unexpected(VolumeError::NO_SPACE_LEFT);
+        }
+    }
+
+    // Each page is mapped by a single index entry, so a page can't span two blkids.
+    std::vector< homestore::BlkId > page_blkids;
+    PageBlkIdIter blkid_iter{new_blkids};
+    for (auto const& [_, nblks] : written) {
+        auto const& blkid = page_blkids.emplace_back(blkid_iter.next(nblks));
+        if (!blkid.is_valid()) {
+            LOGE("Allocated blkids are not page aligned, page_size: {}, volume: {}", vol_info_->page_size,
+                 vol_info_->name);
+            release_dedup_refs(dedup.refs);
+            release_uncommitted_blks(new_blkids);
+            return std::unexpected(VolumeError::NO_SPACE_LEFT);
+        }
     }
     COUNTER_INCREMENT(*metrics_, volume_write_count, 1);
 
-    // Step 2. Write the data to those allocated blkids.
+    // Step 4. Write the data to those allocated blkids, pages not deduped are written back to back.
     vol_req->data_svc_start_time = Clock::now();
     sisl::sg_list data_sgs;
-    data_sgs.iovs.emplace_back(iovec{.iov_base = vol_req->buffer, .iov_len = data_size});
+    for (auto const& [i, nblks] : written) {
+        auto it = compress.pages.find(i);
+        auto data = (it != compress.pages.end()) ? compress.buf.bytes() + it->second.first
+                                                 : vol_req->buffer + i * page_size;
+        auto const size = nblks * blk_size;
+        if (!data_sgs.iovs.empty() &&
+            r_cast< uint8_t* >(data_sgs.iovs.back().iov_base) + data_sgs.iovs.back().iov_len == data) {
+            data_sgs.iovs.back().iov_len += size;
+        } else {
+            data_sgs.iovs.emplace_back(iovec{.iov_base = data, .iov_len = size});
+        }
+    }
     data_sgs.size = data_size;
-    return rd()
-        ->async_write(new_blkids, data_sgs, vol_req->part_of_batch)
-        .thenValue([this, vol_req,
-                    new_blkids = std::move(new_blkids)](auto&& result) -> VolumeManager::NullAsyncResult {
-            if (result) { return std::unexpected(VolumeError::DRIVE_WRITE_ERROR); }
-            HISTOGRAM_OBSERVE(*metrics_, volume_data_write_latency, get_elapsed_time_us(vol_req->data_svc_start_time));
-            vol_req->index_start_time = Clock::now();
-            using homestore::BlkId;
-            std::vector< BlkId > old_blkids;
-            std::unordered_map< lba_t, BlockInfo > blocks_info;
-            auto blk_size = rd()->get_blk_size();
-            auto data_size = vol_req->nlbas * blk_size;
-            auto data_buffer = vol_req->buffer;
-            lba_t start_lba = vol_req->lba;
-            for (auto& blkid : new_blkids) {
-                DEBUG_ASSERT_EQ(blkid.num_pieces(), 1, "Multiple blkid pieces");
-
-                // Split the large blkid to individual blkid having only one block because each LBA points
-                // to a blkid containing single blk which is stored in index value. Calculate the checksum for each
-                // block which is also stored in index.
-                for (uint32_t i = 0; i < blkid.blk_count(); i++) {
-                    auto new_bid = BlkId{blkid.blk_num() + i, 1 /* nblks */, blkid.chunk_num()};
-                    auto csum = crc16_t10dif(init_crc_16, static_cast< unsigned char* >(data_buffer), blk_size);
-                    blocks_info.emplace(start_lba + i, BlockInfo{new_bid, BlkId{}, csum});
-                    LOGT("volume write blkid={} csum={} lba={}", new_bid.to_string(),
-                         blocks_info[start_lba + i].new_checksum, start_lba + i);
-                    data_buffer += blk_size;
+    auto write_fut = data_size
+        ? write_blks(new_blkids, data_sgs, vol_req->part_of_batch, vol_req->lba, vol_req->end_lba())
+        : folly::makeFuture< std::error_code >(std::error_code{});
+    return std::move(write_fut).thenValue([this, vol_req, destage_lsn, data_size, new_blkids = std::move(new_blkids),
+                                           written = std::move(written), page_blkids = std::move(page_blkids),
+                                           dedup = std::move(dedup), compress = std::move(compress)](
+                                              auto&& result) -> VolumeManager::NullAsyncResult {
+        if (result) {
+            release_dedup_refs(dedup.refs);
+            release_uncommitted_blks(new_blkids);
+            return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
+        }
+        HISTOGRAM_OBSERVE(*metrics_, volume_data_write_latency, get_elapsed_time_us(vol_req->data_svc_start_time));
+        vol_req->index_start_time = Clock::now();
+        using homestore::BlkId;
+        std::vector< BlkId > old_blkids;
+        std::unordered_map< lba_t, BlockInfo > blocks_info;
+        std::vector< VolDedupEntry > dedup_entries;
+        std::vector< std::pair< dedup_hash_t, dedup_blk_t > > new_hashes;
+        auto refs = dedup.refs;
+        auto const page_size = vol_info_->page_size;
+        auto const blk_size = rd()->get_blk_size();
+        for (lba_count_t i = 0, w = 0; i < vol_req->nlbas; ++i) {
+            auto const lba = vol_req->lba + i;
+            // Each LBA points to a blkid containing single page which is stored in index value, along with the
+            // checksum of what is stored with the volume's checksum type.
+            if (auto it = dedup.cached.find(i); it != dedup.cached.end()) {
+                blocks_info.emplace(lba, BlockInfo{it->second.blkid, BlkId{}, it->second.checksum});
+            } else if (auto it = dedup.dups.find(i); it != dedup.dups.end()) {
+                auto const first = blocks_info[vol_req->lba + it->second];
+                blocks_info.emplace(lba, BlockInfo{first.new_blkid, BlkId{}, first.new_checksum});
+                dedup_index_->add_ref(first.new_blkid);
+                refs.push_back(first.new_blkid);
+            } else {
+                auto const& new_bid = page_blkids[w];
+                auto c_it = compress.pages.find(i);
+                auto data = (c_it != compress.pages.end()) ? compress.buf.cbytes() + c_it->second.first
+                                                           : vol_req->buffer + i * page_size;
+                auto csum = compute_checksum(checksum_type(), data, written[w].second * blk_size);
+                blocks_info.emplace(lba, BlockInfo{new_bid, BlkId{}, csum});
+                if (dedup_index_) { new_hashes.emplace_back(dedup.hashes[i], dedup_blk_t{new_bid, csum}); }
+                ++w;
+            }
+            if (!dedup.is_written(i)) { dedup_entries.push_back(VolDedupEntry{i, blocks_info[lba].new_blkid}); }
+            LOGT("volume write blkid={} csum={} lba={}", blocks_info[lba].new_blkid.to_string(),
+                 blocks_info[lba].new_checksum, lba);
+        }
+
+        // Step 5. Write the values to index. Should there be any overwritten on existing lbas, old blocks to be freed
+        // will be collected in blocks_info after write_to_index
+        auto status =
+            write_to_index(vol_req->lba, vol_req->end_lba(), blocks_info, !vol_req->relocation /* track_overwrites */);
+        // Cached pages are stale once index maps new blkids, reads which looked up index before can't fill them.
+        if (read_cache_) { read_cache_->invalidate(vol_req->lba, vol_req->end_lba()); }
+        if (!status) {
+            release_dedup_refs(refs);
+            release_uncommitted_blks(new_blkids);
+            return std::unexpected(VolumeError::INDEX_ERROR);
+        }
+        HISTOGRAM_OBSERVE(*metrics_, volume_map_write_latency, get_elapsed_time_us(vol_req->index_start_time));
+
+        vol_req->journal_start_time = Clock::now();
+        // Collect all old blocks to write to journal. A blk shared with other lbas is only freed with its last
+        // reference.
+        for (auto& [_, info] : blocks_info) {
+            if (!info.old_blkid.is_valid()) { continue; }
+            if (dedup_index_ && !dedup_index_->release(info.old_blkid)) { continue; }
+            old_blkids.emplace_back(info.old_blkid);
+        }
+
+        // Journal entry only carries as many checksum bytes per lba as the volume's checksum type needs. On volumes
+        // with compression, it also carries the number of blks stored for each written page.
+        auto const csum_sz = checksum_size(checksum_type());
+        auto csum_size = csum_sz * vol_req->nlbas;
+        auto old_blkids_size = sizeof(BlkId) * old_blkids.size();
+        auto dedup_size = sizeof(VolDedupEntry) * dedup_entries.size();
+        auto stored_blks_size =
+            (compression_type() != vol_compression_type::NONE) ? sizeof(homestore::blk_count_t) * written.size() : 0;
+        auto key_size = sizeof(VolJournalEntry) + csum_size + old_blkids_size + dedup_size + stored_blks_size;
+
+        auto req = repl_result_ctx< VolumeManager::NullResult >::make(sizeof(MsgHeader) /* header size */, key_size);
+        req->vol_ptr_ = shared_from_this();
+        req->header()->msg_type = (destage_lsn >= 0) ? MsgType::DESTAGE_WRITE : MsgType::WRITE;
+        // Store volume id for recovery path (log replay)
+        req->header()->volume_id = id();
+        if (destage_lsn >= 0) { std::memcpy(req->header_extn(), &destage_lsn, sizeof(int64_t)); }
+
+        // Step 6. Store lba, nlbas, list of checksum of each blk, list of old blkids, deduped lbas and blks stored per
+        // written page as key in the journal. New blkid's are written to journal by the homestore
+        // async_write_journal. After journal flush, on_commit will be called where we free the old blkid's and the
+        // write iscompleted.
+        VolJournalEntry hb_key{vol_req->lba, vol_req->nlbas, static_cast< uint16_t >(old_blkids.size()),
+                               static_cast< uint16_t >(dedup_entries.size())};
+        auto key_buf = req->key_buf().bytes();
+        std::memcpy(key_buf, &hb_key, sizeof(VolJournalEntry));
+        key_buf += sizeof(VolJournalEntry);
+
+        auto lba = vol_req->lba;
+        for (lba_count_t count = 0; count < vol_req->nlbas; count++) {
+            std::memcpy(key_buf, &blocks_info[lba].new_checksum, csum_sz);
+            key_buf += csum_sz;
+            lba++;
+        }
+
+        for (auto& blkid : old_blkids) {
+            std::memcpy(key_buf, &blkid, sizeof(BlkId));
+            key_buf += sizeof(BlkId);
+        }
+
+        if (dedup_size) { std::memcpy(key_buf, dedup_entries.data(), dedup_size); }
+        key_buf += dedup_size;
+
+        if (stored_blks_size) {
+            for (auto const& [_, nblks] : written) {
+                std::memcpy(key_buf, &nblks, sizeof(homestore::blk_count_t));
+                key_buf += sizeof(homestore::blk_count_t);
+            }
+        }
+
+#ifdef _PRERELEASE
+        if (iomgr_flip::instance()->test_flip("vol_write_crash_after_data_write")) {
+            // this is to simulate crash during write where data is persisted journal is
+            // not persisted. After recovery there is no index for. Blks are not leaked, homestore persists their
+            // allocation only along with the journal entry.
+            LOGINFO("Volume write crash simulation flip is set, aborting");
+            return VolumeManager::NullResult();
+        }
+#endif
+
+        auto submit_journal = [this, req, new_blkids, data_size, part_of_batch = vol_req->part_of_batch]() {
+            if (new_blkids.empty()) {
+                // All the pages are deduped, journal entry alone carries the mapping.
+                journal_rd()->async_alloc_write(req->cheader_buf(), req->ckey_buf(), sisl::sg_list{}, req,
+                                                part_of_batch);
+            } else {
+                journal_rd()->async_write_journal(new_blkids, req->cheader_buf(), req->ckey_buf(), data_size, req);
+            }
+        };
+
+        auto committed = req->result()
+            .via(&folly::InlineExecutor::instance())
+            .thenValue([this, vol_req, new_hashes = std::move(new_hashes), num_deduped = dedup_entries.size(),
+                        data_size](const auto&& result) -> std::expected< void, VolumeError > {
+                if (!result.has_value()) {
+                    LOGE("Failed to write to journal for volume: {}, lba: {}, nlbas: {}, error: {}", vol_info_->name,
+                         vol_req->lba, vol_req->nlbas, result.error());
+                    auto err = result.error();
+                    return std::unexpected(err);
+                }
+                HISTOGRAM_OBSERVE(*metrics_, volume_journal_write_latency,
+                                  get_elapsed_time_us(vol_req->journal_start_time));
+                auto write_size = vol_req->nlbas * vol_info_->page_size;
+                COUNTER_INCREMENT(*metrics_, volume_write_size_total, write_size);
+                HISTOGRAM_OBSERVE(*metrics_, volume_write_size_distribution, write_size);
+                HISTOGRAM_OBSERVE(*metrics_, volume_write_latency, get_elapsed_time_us(vol_req->io_start_time));
+
+                // Written pages are deduped against only once their mapping is committed, otherwise a later write
+                // could refer to a blk which is freed in recovery.
+                if (dedup_index_) {
+                    for (auto const& [hash, blk] : new_hashes) {
+                        dedup_index_->insert(hash, blk);
+                    }
+                    COUNTER_INCREMENT(*metrics_, volume_dedup_hit_count, num_deduped);
+                    COUNTER_INCREMENT(*metrics_, volume_dedup_size_total, num_deduped * vol_info_->page_size);
+                    GAUGE_UPDATE(*metrics_, volume_dedup_shared_blk_count, dedup_index_->num_shared_blks());
+                }
+                if (compression_type() != vol_compression_type::NONE) {
+                    auto const written_size = (vol_req->nlbas - num_deduped) * vol_info_->page_size;
+                    COUNTER_INCREMENT(*metrics_, volume_compress_saved_size_total, written_size - data_size);
+                }
+                return {};
+            });
+
+        // With write back ack, the write is acked once index is updated and its journal entry is group committed with
+        // other writes. Destage writes are not acked to anyone, they always wait for commit. A FUA write is queued
+        // like the others, so that journal order stays the same as index order, and its batch is submitted right away.
+        if (destage_lsn < 0 && vol_info_->write_back_ack) {
+            auto group_committed = queue_journal_write(std::move(submit_journal), std::move(committed));
+            if (vol_req->fua) {
+                COUNTER_INCREMENT(*metrics_, volume_fua_write_count, 1);
+                submit_journal_writes();
+                return group_committed;
+            }
+            HISTOGRAM_OBSERVE(*metrics_, volume_write_ack_latency, get_elapsed_time_us(vol_req->io_start_time));
+            return VolumeManager::NullResult();
+        }
+        submit_journal();
+        return committed;
+    });
+}
+
+VolumeManager::NullAsyncResult Volume::queue_journal_write(folly::Function< void() >&& submit,
+                                                           VolumeManager::NullAsyncResult&& committed) {
+    uint64_t seq{0};
+    bool batch_full{false};
+    {
+        std::scoped_lock lg(group_commit_mtx_);
+        seq = ++group_commit_seq_;
+        uncommitted_seqs_.insert(seq);
+        pending_journal_writes_.emplace_back(std::move(submit));
+        batch_full = (pending_journal_writes_.size() >= HB_DYNAMIC_CONFIG(group_commit_max_entries));
+    }
+
+    auto ret = std::move(committed).thenValue([vol = shared_from_this(), seq](auto&& result) {
+        vol->on_group_committed(seq, !result.has_value());
+        return result;
+    });
+    if (batch_full) { submit_journal_writes(); }
+    return ret;
+}
+
+void Volume::submit_journal_writes() {
+    // Batches are submitted one at a time in the order writes were acked, so that journal order is the same as the
+    // order overlapping writes updated index. Commit callbacks only take group_commit_mtx_, which is not held here.
+    std::scoped_lock submit_lg(journal_submit_mtx_);
+    std::vector< folly::Function< void() > > batch;
+    {
+        std::scoped_lock lg(group_commit_mtx_);
+        batch.swap(pending_journal_writes_);
+    }
+    if (batch.empty()) { return; }
+
+    for (auto& submit : batch) {
+        submit();
+    }
+    COUNTER_INCREMENT(*metrics_, volume_group_commit_count, 1);
+    HISTOGRAM_OBSERVE(*metrics_, volume_group_commit_entries, batch.size());
+}
+
+void Volume::on_group_committed(uint64_t seq, bool failed) {
+    std::vector< folly::Promise< VolumeManager::NullResult > > done;
+    bool flush_failed{false};
+    {
+        std::scoped_lock lg(group_commit_mtx_);
+        uncommitted_seqs_.erase(seq);
+        if (failed) {
+            LOGE("Journal entry of a write acked on volume: {} failed, it is lost", vol_info_->name);
+            group_commit_failed_ = true;
+        }
+
+        // Flushes waiting only for writes acked before the oldest one not committed yet are done.
+        auto const oldest = uncommitted_seqs_.empty() ? std::numeric_limits< uint64_t >::max()
+                                                      : *uncommitted_seqs_.begin();
+        auto it = flush_waiters_.begin();
+        for (; it != flush_waiters_.end() && it->first < oldest; ++it) {
+            done.emplace_back(std::move(it->second));
+        }
+        flush_waiters_.erase(flush_waiters_.begin(), it);
+        if (!done.empty()) { flush_failed = std::exchange(group_commit_failed_, false); }
+    }
+
+    for (auto& p : done) {
+        if (flush_failed) {
+            p.setValue(std::unexpected(VolumeError::DRIVE_WRITE_ERROR));
+        } else {
+            p.setValue(VolumeManager::NullResult());
+        }
+    }
+}
+
+VolumeManager::NullAsyncResult Volume::flush() {
+    submit_journal_writes();
+    std::scoped_lock lg(group_commit_mtx_);
+    if (uncommitted_seqs_.empty()) {
+        if (std::exchange(group_commit_failed_, false)) { return std::unexpected(VolumeError::DRIVE_WRITE_ERROR); }
+        return VolumeManager::NullResult();
+    }
+    auto it = flush_waiters_.emplace(group_commit_seq_, folly::Promise< VolumeManager::NullResult >{});
+    return it->second.getSemiFuture().via(&folly::InlineExecutor::instance());
+}
+
+bool Volume::bypass_compression() {
+    // Once COMPRESS_PROBE_INTERVAL writes in a row had nothing worth compressing, only one write in every
+    // COMPRESS_PROBE_INTERVAL tries to compress, until one does.
+    auto const n = incompressible_writes_.load(std::memory_order_relaxed);
+    if (n < COMPRESS_PROBE_INTERVAL || n % COMPRESS_PROBE_INTERVAL == 0) { return false; }
+    incompressible_writes_.fetch_add(1, std::memory_order_relaxed);
+    COUNTER_INCREMENT(*metrics_, volume_compress_bypass_count, 1);
+    return true;
+}
+
+folly::Future< vol_compress_ctx > Volume::compress_pages(const vol_interface_req_ptr& vol_req,
+                                                         vol_dedup_ctx const& dedup) {
+    std::vector< lba_count_t > pages;
+    for (lba_count_t i = 0; i < vol_req->nlbas; ++i) {
+        if (dedup.is_written(i)) { pages.push_back(i); }
+    }
+
+    auto promise = std::make_shared< folly::Promise< vol_compress_ctx > >();
+    auto fut = promise->getSemiFuture().via(&folly::InlineExecutor::instance());
+    folly::getGlobalCPUExecutor()->add([this, vol_req, pages = std::move(pages), promise]() {
+        auto compress = std::make_shared< vol_compress_ctx >();
+        auto const page_size = uint32_cast(vol_info_->page_size);
+        auto const blk_size = rd()->get_blk_size();
+        compress->buf = sisl::io_blob_safe{uint32_cast(pages.size() * (page_size - blk_size)), 512};
+        uint32_t offset{0};
+        for (auto const i : pages) {
+            auto const stored_size = compress_page(compression_type(), vol_req->buffer + i * page_size, page_size,
+                                                   compress->buf.bytes() + offset, blk_size);
+            if (stored_size == 0) { continue; }
+            compress->pages.emplace(i, std::make_pair(offset, stored_size));
+            offset += stored_size;
+        }
+
+        if (compress->pages.empty()) {
+            incompressible_writes_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            incompressible_writes_.store(0, std::memory_order_relaxed);
+        }
+
+        // IOs are submitted from reactors, hand the result back to one.
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker,
+                                [promise, compress]() { promise->setValue(std::move(*compress)); });
+    });
+    return fut;
+}
+
+VolumeManager::NullAsyncResult Volume::atomic_write(std::vector< vol_interface_req_ptr > reqs) {
+    if (dedup_index_ || compression_type() != vol_compression_type::NONE) {
+        LOGE("Atomic write is not supported on volume: {} with dedup or compression", vol_info_->name);
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+
+    // Pending inline pages of the ranges are destaged first, same as a regular write.
+    for (auto const& vol_req : reqs) {
+        if (!inline_cache_->overlaps(vol_req->lba, vol_req->end_lba())) { continue; }
+        return destage(std::numeric_limits< uint32_t >::max())
+            .thenValue([this, reqs = std::move(reqs)](bool success) mutable -> VolumeManager::NullAsyncResult {
+                if (!success) {
+                    LOGE("Failed to destage inline writes before atomic write, volume: {}", vol_info_->name);
+                    return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
                 }
+                return atomic_write(std::move(reqs));
+            });
+    }
 
-                // Step 3. For range [start_lba, end_lba] in this blkid, write the values to index.
-                // Should there be any overwritten on existing lbas, old blocks to be freed will be collected
-                // in blocks_info after write_to_index
-                lba_t end_lba = start_lba + blkid.blk_count() - 1;
-                auto status = indx_table()->write_to_index(start_lba, end_lba, blocks_info);
-                if (!status) { return std::unexpected(VolumeError::INDEX_ERROR); }
+    // Step 1. Allocate blkids for all the ranges at once, pages of the ranges are written back to back.
+    auto const io_start_time = Clock::now();
+    auto const page_size = vol_info_->page_size;
+    auto const blks_per_pg = static_cast< homestore::blk_count_t >(blks_per_page());
+    uint64_t data_size{0};
+    for (auto const& vol_req : reqs) {
+        data_size += vol_req->nlbas * page_size;
+    }
 
-                start_lba = end_lba + 1;
+    bool const hot = std::any_of(reqs.begin(), reqs.end(),
+                                 [this](auto const& vol_req) { return is_hot(vol_req->lba, vol_req->nlbas); });
+    homestore::blk_alloc_hints hints;
+    hints.application_hint = VolumeChunkSelector::alloc_hint(vol_info_->ordinal, hot);
+    std::vector< homestore::MultiBlkId > new_blkids;
+    if (auto result = rd()->alloc_blks(data_size, hints, new_blkids); result) {
+        LOGE("Failed to allocate blocks");
+        return std::unexpected(VolumeError::NO_SPACE_LEFT);
+    }
+
+    std::vector< homestore::BlkId > page_blkids;
+    PageBlkIdIter blkid_iter{new_blkids};
+    for (uint64_t i = 0; i < data_size / page_size; ++i) {
+        if (!page_blkids.emplace_back(blkid_iter.next(blks_per_pg)).is_valid()) {
+            LOGE("Allocated blkids are not page aligned, page_size: {}, volume: {}", page_size, vol_info_->name);
+            release_uncommitted_blks(new_blkids);
+            return std::unexpected(VolumeError::NO_SPACE_LEFT);
+        }
+    }
+    COUNTER_INCREMENT(*metrics_, volume_write_count, 1);
+    COUNTER_INCREMENT(*metrics_, volume_atomic_write_count, 1);
+
+    // Step 2. Write the data of all the ranges.
+    auto const data_svc_start_time = Clock::now();
+    sisl::sg_list data_sgs;
+    for (auto const& vol_req : reqs) {
+        data_sgs.iovs.emplace_back(iovec{.iov_base = vol_req->buffer, .iov_len = vol_req->nlbas * page_size});
+    }
+    data_sgs.size = data_size;
+    auto const part_of_batch = reqs.front()->part_of_batch;
+    return write_blks(new_blkids, data_sgs, part_of_batch, reqs.front()->lba, reqs.back()->end_lba())
+        .thenValue([this, reqs = std::move(reqs), new_blkids = std::move(new_blkids),
+                    page_blkids = std::move(page_blkids), data_size, io_start_time,
+                    data_svc_start_time](auto&& result) -> VolumeManager::NullAsyncResult {
+            if (result) {
+                release_uncommitted_blks(new_blkids);
+                return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
             }
-            HISTOGRAM_OBSERVE(*metrics_, volume_map_write_latency, get_elapsed_time_us(vol_req->index_start_time));
+            HISTOGRAM_OBSERVE(*metrics_, volume_data_write_latency, get_elapsed_time_us(data_svc_start_time));
 
-            vol_req->journal_start_time = Clock::now();
-            // Collect all old blocks to write to journal.
-            for (auto& [_, info] : blocks_info) {
-                if (info.old_blkid.is_valid()) { old_blkids.emplace_back(info.old_blkid); }
+            // Step 3. Map all the ranges in index, old blocks of each range to be freed are collected.
+            using homestore::BlkId;
+            auto const index_start_time = Clock::now();
+            auto const page_size = vol_info_->page_size;
+            std::vector< std::unordered_map< lba_t, BlockInfo > > ranges_info(reqs.size());
+            std::vector< std::vector< BlkId > > old_blkids(reqs.size());
+            for (size_t r = 0, pg = 0; r < reqs.size(); ++r) {
+                auto const& vol_req = reqs[r];
+                auto& blocks_info = ranges_info[r];
+                for (lba_count_t i = 0; i < vol_req->nlbas; ++i, ++pg) {
+                    auto csum = compute_checksum(checksum_type(), vol_req->buffer + i * page_size, page_size);
+                    blocks_info.emplace(vol_req->lba + i, BlockInfo{page_blkids[pg], BlkId{}, csum});
+                }
+
+                auto status = write_to_index(vol_req->lba, vol_req->end_lba(), blocks_info);
+#ifdef _PRERELEASE
+                if (status && r > 0 && iomgr_flip::instance()->test_flip("vol_atomic_write_index_failure")) {
+                    // this is to simulate index failure on a range after the ones before it are mapped.
+                    LOGINFO("vol_atomic_write_index_failure flip is set, aborting");
+                    indx_table()->rollback_write(vol_req->lba, vol_req->end_lba(), blocks_info);
+                    status = std::unexpected(VolumeError::INDEX_ERROR);
+                }
+#endif
+                if (read_cache_) { read_cache_->invalidate(vol_req->lba, vol_req->end_lba()); }
+                if (!status) {
+                    // The failed range is rolled back by write_to_index, the ranges mapped before it are restored
+                    // here. Nothing refers to the new blks then.
+                    for (size_t prev = 0; prev < r; ++prev) {
+                        indx_table()->rollback_write(reqs[prev]->lba, reqs[prev]->end_lba(), ranges_info[prev]);
+                    }
+                    release_uncommitted_blks(new_blkids);
+                    return std::unexpected(VolumeError::INDEX_ERROR);
+                }
+                for (auto& [_, info] : blocks_info) {
+                    if (info.old_blkid.is_valid()) { old_blkids[r].emplace_back(info.old_blkid); }
+                }
             }
+            HISTOGRAM_OBSERVE(*metrics_, volume_map_write_latency, get_elapsed_time_us(index_start_time));
 
-            auto csum_size = sizeof(homestore::csum_t) * vol_req->nlbas;
-            auto old_blkids_size = sizeof(BlkId) * old_blkids.size();
-            auto key_size = sizeof(VolJournalEntry) + csum_size + old_blkids_size;
+            // Step 4. A single journal entry carries a write entry per range, so the ranges are replayed all together
+            // or not at all.
+            auto const journal_start_time = Clock::now();
+            auto const csum_sz = checksum_size(checksum_type());
+            auto key_size = sizeof(VolAtomicJournalEntry);
+            for (size_t r = 0; r < reqs.size(); ++r) {
+                key_size += sizeof(VolJournalEntry) + csum_sz * reqs[r]->nlbas + sizeof(BlkId) * old_blkids[r].size();
+            }
 
-            auto req =
-                repl_result_ctx< VolumeManager::NullResult >::make(sizeof(MsgHeader) /* header size */, key_size);
+            auto req = repl_result_ctx< VolumeManager::NullResult >::make(sizeof(MsgHeader), key_size);
             req->vol_ptr_ = shared_from_this();
-            req->header()->msg_type = MsgType::WRITE;
-            // Store volume id for recovery path (log replay)
+            req->header()->msg_type = MsgType::ATOMIC_WRITE;
             req->header()->volume_id = id();
 
-            // Step 4. Store lba, nlbas, list of checksum of each blk, list of old blkids as key in the journal.
-            // New blkid's are written to journal by the homestore async_write_journal. After journal flush,
-            // on_commit will be called where we free the old blkid's and the write iscompleted.
-            VolJournalEntry hb_key{vol_req->lba, vol_req->nlbas, static_cast< uint16_t >(old_blkids.size())};
             auto key_buf = req->key_buf().bytes();
-            std::memcpy(key_buf, &hb_key, sizeof(VolJournalEntry));
-            key_buf += sizeof(VolJournalEntry);
-
-            auto lba = vol_req->lba;
-            for (lba_count_t count = 0; count < vol_req->nlbas; count++) {
-                std::memcpy(key_buf, &blocks_info[lba].new_checksum, sizeof(homestore::csum_t));
-                key_buf += sizeof(homestore::csum_t);
-                lba++;
-            }
-
-            for (auto& blkid : old_blkids) {
-                std::memcpy(key_buf, &blkid, sizeof(BlkId));
-                key_buf += sizeof(BlkId);
+            VolAtomicJournalEntry atomic_key{static_cast< uint16_t >(reqs.size())};
+            std::memcpy(key_buf, &atomic_key, sizeof(VolAtomicJournalEntry));
+            key_buf += sizeof(VolAtomicJournalEntry);
+            for (size_t r = 0; r < reqs.size(); ++r) {
+                VolJournalEntry hb_key{reqs[r]->lba, reqs[r]->nlbas, static_cast< uint16_t >(old_blkids[r].size())};
+                std::memcpy(key_buf, &hb_key, sizeof(VolJournalEntry));
+                key_buf += sizeof(VolJournalEntry);
+                for (lba_t lba = reqs[r]->lba; lba <= reqs[r]->end_lba(); ++lba) {
+                    std::memcpy(key_buf, &ranges_info[r][lba].new_checksum, csum_sz);
+                    key_buf += csum_sz;
+                }
+                for (auto& blkid : old_blkids[r]) {
+                    std::memcpy(key_buf, &blkid, sizeof(BlkId));
+                    key_buf += sizeof(BlkId);
+                }
             }
 
 #ifdef _PRERELEASE
             if (iomgr_flip::instance()->test_flip("vol_write_crash_after_data_write")) {
-                // this is to simulate crash during write where data is persisted journal is
-                // not persisted. After recovery there is no index for.
-                LOGINFO("Volume write crash simulation flip is set, aborting");
+                LOGINFO("Volume atomic write crash simulation flip is set, aborting");
                 return VolumeManager::NullResult();
             }
 #endif
 
-            rd()->async_write_journal(new_blkids, req->cheader_buf(), req->ckey_buf(), data_size, req);
+            auto submit_journal = [this, req, new_blkids, data_size]() {
+                journal_rd()->async_write_journal(new_blkids, req->cheader_buf(), req->ckey_buf(), data_size, req);
+            };
 
-            return req->result()
+            auto committed = req->result()
                 .via(&folly::InlineExecutor::instance())
-                .thenValue([this, vol_req](const auto&& result) -> std::expected< void, VolumeError > {
+                .thenValue([this, data_size, io_start_time,
+                            journal_start_time](const auto&& result) -> std::expected< void, VolumeError > {
                     if (!result.has_value()) {
-                        LOGE("Failed to write to journal for volume: {}, lba: {}, nlbas: {}, error: {}",
-                             vol_info_->name, vol_req->lba, vol_req->nlbas, result.error());
+                        LOGE("Failed to write atomic write journal entry for volume: {}, error: {}", vol_info_->name,
+                             result.error());
                         auto err = result.error();
                         return std::unexpected(err);
                     }
                     HISTOGRAM_OBSERVE(*metrics_, volume_journal_write_latency,
-                                      get_elapsed_time_us(vol_req->journal_start_time));
-                    auto write_size = vol_req->nlbas * rd()->get_blk_size();
-                    COUNTER_INCREMENT(*metrics_, volume_write_size_total, write_size);
-                    HISTOGRAM_OBSERVE(*metrics_, volume_write_size_distribution, write_size);
-                    HISTOGRAM_OBSERVE(*metrics_, volume_write_latency, get_elapsed_time_us(vol_req->io_start_time));
+                                      get_elapsed_time_us(journal_start_time));
+                    COUNTER_INCREMENT(*metrics_, volume_write_size_total, data_size);
+                    HISTOGRAM_OBSERVE(*metrics_, volume_write_size_distribution, data_size);
+                    HISTOGRAM_OBSERVE(*metrics_, volume_write_latency, get_elapsed_time_us(io_start_time));
                     return {};
                 });
+
+            // With write back ack, writes acked earlier may still wait for group commit. The atomic entry is queued
+            // behind them and submitted right away like a FUA write, so that journal order stays the same as index
+            // order and replay doesn't apply their data over it.
+            if (vol_info_->write_back_ack) {
+                auto group_committed = queue_journal_write(std::move(submit_journal), std::move(committed));
+                submit_journal_writes();
+                return group_committed;
+            }
+            submit_journal();
+            return committed;
+        });
+}
+
+void Volume::lookup_dedup(const vol_interface_req_ptr& vol_req, vol_dedup_ctx& dedup) {
+    auto const page_size = vol_info_->page_size;
+    std::unordered_map< dedup_hash_t, lba_count_t, dedup_hash_hasher > written; // hash -> first page written with it;
+    dedup.hashes.reserve(vol_req->nlbas);
+    auto buf = vol_req->buffer;
+    for (lba_count_t i = 0; i < vol_req->nlbas; ++i, buf += page_size) {
+        auto const& hash = dedup.hashes.emplace_back(compute_dedup_hash(buf, page_size));
+        if (auto it = written.find(hash); it != written.end()) {
+            dedup.dups.emplace(i, it->second);
+        } else if (auto blk = dedup_index_->acquire(hash)) {
+            dedup.cached.emplace(i, *blk);
+            dedup.refs.push_back(blk->blkid);
+        } else {
+            written.emplace(hash, i);
+        }
+    }
+}
+
+void Volume::release_uncommitted_blks(std::vector< homestore::MultiBlkId > const& blkids) {
+    // Not journaled, nothing refers to the blks but this write. Allocation isn't persisted yet either, a crash before
+    // this frees them already.
+    for (auto const& blkid : blkids) {
+        LOGT("free uncommitted blk {}", blkid.to_string());
+        rd()->async_free_blks(-1 /* lsn */, blkid);
+        COUNTER_INCREMENT(*metrics_, volume_reclaimed_blk_count, blkid.blk_count());
+    }
+}
+
+void Volume::release_dedup_refs(std::vector< homestore::BlkId > const& blkids) {
+    for (auto const& blkid : blkids) {
+        // Lbas sharing the blk were all overwritten in the meantime, nothing maps it anymore. Their journal entries
+        // left the blk out as this write held a reference, so it is freed here.
+        if (dedup_index_->release(blkid)) {
+            LOGT("free blk {} last referred by failed write", blkid.to_string());
+            rd()->async_free_blks(-1 /* lsn */,
+                                 homestore::MultiBlkId(blkid.blk_num(), blkid.blk_count(), blkid.chunk_num()));
+            COUNTER_INCREMENT(*metrics_, volume_reclaimed_blk_count, blkid.blk_count());
+        }
+    }
+}
+
+VolumeManager::Result< folly::Unit > Volume::write_to_index(lba_t start_lba, lba_t end_lba,
+                                                            std::unordered_map< lba_t, BlockInfo >& blocks_info,
+                                                            bool track_overwrites) {
+    auto const first_lba = start_lba;
+    while (start_lba <= end_lba) {
+        // Index value of a range put is derived from the blkid of its first lba, the blkid of each next lba must be
+        // of the same size and right after it.
+        auto run_end = start_lba;
+        for (; run_end < end_lba; ++run_end) {
+            auto const& cur = blocks_info[run_end].new_blkid;
+            auto const& next = blocks_info[run_end + 1].new_blkid;
+            if (next.chunk_num() != cur.chunk_num() || next.blk_count() != cur.blk_count() ||
+                next.blk_num() != cur.blk_num() + cur.blk_count()) {
+                break;
+            }
+        }
+
+        auto status = indx_table()->write_to_index(start_lba, run_end, blocks_info);
+        if (!status) {
+            // The failed run is rolled back by the index table, runs put before it are restored here.
+            if (start_lba > first_lba) { indx_table()->rollback_write(first_lba, start_lba - 1, blocks_info); }
+            return status;
+        }
+        if (track_overwrites) { record_overwrites(start_lba, run_end, blocks_info); }
+        if (log_structured_) { record_chunk_extents(start_lba, run_end, blocks_info[start_lba].new_blkid.chunk_num()); }
+        start_lba = run_end + 1;
+    }
+    return folly::Unit();
+}
+
+void Volume::record_overwrites(lba_t start_lba, lba_t end_lba, std::unordered_map< lba_t, BlockInfo >& blocks_info) {
+    if (!overwrite_heat_) { return; }
+
+    // Lbas for which the index filter callback found an old blkid are overwritten.
+    uint64_t num_overwritten{0};
+    for (auto lba = start_lba; lba <= end_lba;) {
+        if (!blocks_info[lba].old_blkid.is_valid()) {
+            ++lba;
+            continue;
+        }
+        auto const run_start = lba;
+        for (; lba <= end_lba && blocks_info[lba].old_blkid.is_valid(); ++lba) {}
+        overwrite_heat_->record(run_start, static_cast< lba_count_t >(lba - run_start));
+        num_overwritten += lba - run_start;
+    }
+
+    // Heat is halved every so many overwritten pages, extents not overwritten lately cool down.
+    if (num_overwritten && overwrites_since_decay_.fetch_add(num_overwritten) + num_overwritten >= OVERWRITE_DECAY) {
+        overwrites_since_decay_ = 0;
+        overwrite_heat_->decay();
+    }
+}
+
+void Volume::record_chunk_extents(lba_t start_lba, lba_t end_lba, chunk_num_t chunk) {
+    std::scoped_lock lg(chunk_extents_mtx_);
+    auto& extents = chunk_extents_[chunk];
+    for (auto ext = start_lba / CLEAN_EXTENT_PAGES; ext <= end_lba / CLEAN_EXTENT_PAGES; ++ext) {
+        extents.insert(ext);
+    }
+}
+
+bool Volume::is_hot(lba_t start_lba, lba_count_t nlbas) const {
+    auto const min_heat = HB_DYNAMIC_CONFIG(hot_overwrite_min);
+    return overwrite_heat_ && min_heat && overwrite_heat_->max_heat(start_lba, nlbas) >= min_heat;
+}
+
+VolumeManager::NullResult Volume::rebuild_dedup_refs() {
+    if (!dedup_index_ || !indx_tbl_) { return VolumeManager::NullResult(); }
+
+    // A blkid mapped by n lbas has n - 1 references beyond the first one. Index is streamed in batches, blks mapped
+    // so far are remembered in a bitmap per chunk, so only a bit per blk is kept rather than every mapped blkid.
+    auto const max_lba = vol_info_->size_bytes / vol_info_->page_size;
+    std::unordered_map< chunk_num_t, std::vector< bool > > mapped_blks;
+    uint64_t num_mapped{0};
+    lba_t start_lba{0};
+    bool has_more{true};
+    while (has_more) {
+        index_kv_list_t index_kvs;
+        auto ret = indx_table()->query_range(start_lba, max_lba - 1, DEDUP_SCAN_BATCH, index_kvs);
+        if (!ret.has_value()) {
+            LOGE("Failed to read from index table to recount dedup references, volume: {}, error: {}",
+                 vol_info_->name, ret.error());
+            return std::unexpected(ret.error());
+        }
+        for (auto const& [_, value] : index_kvs) {
+            auto const blkid = value.blkid();
+            auto& bits = mapped_blks[blkid.chunk_num()];
+            if (bits.size() <= blkid.blk_num()) { bits.resize(blkid.blk_num() + 1); }
+            if (bits[blkid.blk_num()]) {
+                dedup_index_->add_ref(blkid);
+            } else {
+                bits[blkid.blk_num()] = true;
+            }
+        }
+        num_mapped += index_kvs.size();
+        has_more = ret.value() && !index_kvs.empty();
+        if (has_more) { start_lba = index_kvs.back().first.lba() + 1; }
+    }
+
+    GAUGE_UPDATE(*metrics_, volume_dedup_shared_blk_count, dedup_index_->num_shared_blks());
+    LOGI("Recounted dedup references of volume: {}, mapped pages: {}, shared blks: {}", vol_info_->name, num_mapped,
+         dedup_index_->num_shared_blks());
+    return VolumeManager::NullResult();
+}
+
+VolumeManager::NullAsyncResult Volume::write_inline(const vol_interface_req_ptr& vol_req) {
+    vol_req->io_start_time = Clock::now();
+    COUNTER_INCREMENT(*metrics_, volume_write_count, 1);
+    COUNTER_INCREMENT(*metrics_, volume_inline_write_count, 1);
+
+    // No blks are allocated, the journal key carries lba, nlbas followed by the data pages.
+    auto const data_size = vol_req->nlbas * vol_info_->page_size;
+    auto req = repl_result_ctx< VolumeManager::NullResult >::make(sizeof(MsgHeader) /* header size */,
+                                                                  sizeof(VolJournalEntry) + data_size);
+    req->vol_ptr_ = shared_from_this();
+    req->header()->msg_type = MsgType::INLINE_WRITE;
+    req->header()->volume_id = id();
+
+    VolJournalEntry hb_key{vol_req->lba, vol_req->nlbas, 0 /* num_old_blks */};
+    auto key_buf = req->key_buf().bytes();
+    std::memcpy(key_buf, &hb_key, sizeof(VolJournalEntry));
+    std::memcpy(key_buf + sizeof(VolJournalEntry), vol_req->buffer, data_size);
+
+    // After journal flush, on_commit inserts the pages to inline cache and the write is completed.
+    vol_req->journal_start_time = Clock::now();
+    bool journal_failure{false};
+#ifdef _PRERELEASE
+    // this is to simulate failure of the fast device holding the journal.
+    journal_failure = iomgr_flip::instance()->test_flip("vol_inline_write_journal_failure");
+#endif
+    if (journal_failure) {
+        req->promise_.setValue(std::unexpected(VolumeError::DRIVE_WRITE_ERROR));
+    } else {
+        rd()->async_alloc_write(req->cheader_buf(), req->ckey_buf(), sisl::sg_list{}, req, vol_req->part_of_batch);
+    }
+
+    return req->result()
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([this, vol_req](const auto&& result) -> VolumeManager::NullAsyncResult {
+            if (!result.has_value()) {
+                // Nothing is inserted to inline cache for a failed entry. Degrade to write-through, the pages pending
+                // destage are journaled already and still destaged.
+                LOGE("Failed to write inline to journal for volume: {}, lba: {}, nlbas: {}, error: {}, falling back "
+                     "to regular write path",
+                     vol_info_->name, vol_req->lba, vol_req->nlbas, result.error());
+                inline_write_degraded_ = true;
+                COUNTER_INCREMENT(*metrics_, volume_write_back_fallback_count, 1);
+                return write(vol_req);
+            }
+            HISTOGRAM_OBSERVE(*metrics_, volume_journal_write_latency,
+                              get_elapsed_time_us(vol_req->journal_start_time));
+            auto write_size = vol_req->nlbas * vol_info_->page_size;
+            COUNTER_INCREMENT(*metrics_, volume_write_size_total, write_size);
+            HISTOGRAM_OBSERVE(*metrics_, volume_write_size_distribution, write_size);
+            HISTOGRAM_OBSERVE(*metrics_, volume_write_latency, get_elapsed_time_us(vol_req->io_start_time));
+            return VolumeManager::NullResult();
         });
 }
 
+folly::Future< bool > Volume::destage(uint32_t max_pages) {
+    std::shared_ptr< folly::SharedPromise< bool > > promise;
+    {
+        std::scoped_lock lg(destage_mtx_);
+        if (destage_promise_) { return destage_promise_->getFuture(); }
+        if (inline_cache_->num_pages() == 0) { return folly::makeFuture(true); }
+        promise = destage_promise_ = std::make_shared< folly::SharedPromise< bool > >();
+    }
+
+    // Each run of contiguous lbas is destaged with a single regular write, which carries the max lsn of the inline
+    // writes it covers so that log replay can drop the pages already destaged.
+    auto const max_run_pages = uint32_cast(MAX_DESTAGE_IO_SIZE / vol_info_->page_size);
+    auto runs = inline_cache_->pick_for_destage(max_pages, max_run_pages);
+    std::vector< folly::Future< bool > > futs;
+    for (auto& r : runs) {
+        auto run = std::make_shared< InlineWriteCache::DestageRun >(std::move(r));
+        vol_interface_req_ptr req(
+            new vol_interface_req{run->buf.bytes(), run->start_lba, run->nlbas, shared_from_this()});
+        futs.emplace_back(write_data(req, run->max_lsn).thenValue([this, run](auto&& result) {
+            if (!result) {
+                LOGE("Failed to destage inline writes lba: {}, nlbas: {}, volume: {}, error: {}", run->start_lba,
+                     run->nlbas, vol_info_->name, result.error());
+                inline_cache_->abort_destage(*run);
+                return false;
+            }
+            inline_cache_->complete_destage(*run);
+            COUNTER_INCREMENT(*metrics_, volume_destage_size_total, run->nlbas * vol_info_->page_size);
+            return true;
+        }));
+    }
+
+    return folly::collectAllUnsafe(futs).thenValue([this, promise](auto&& results) {
+        bool const success = std::all_of(results.begin(), results.end(),
+                                         [](auto const& t) { return t.hasValue() && t.value(); });
+        {
+            std::scoped_lock lg(destage_mtx_);
+            destage_promise_.reset();
+        }
+        promise->setValue(success);
+        return success;
+    });
+}
+
+folly::Future< bool > Volume::flush_inline_writes() { return flush_inline_writes_upto(inline_cache_->cur_seq()); }
+
+folly::Future< bool > Volume::flush_inline_writes_upto(uint64_t seq) {
+    if (!inline_cache_->has_pages_upto(seq)) { return folly::makeFuture(true); }
+    return destage(std::numeric_limits< uint32_t >::max()).thenValue([this, seq](bool success) {
+        if (!success) { return folly::makeFuture(false); }
+        return flush_inline_writes_upto(seq);
+    });
+}
+
 VolumeManager::NullAsyncResult Volume::read(const vol_interface_req_ptr& req) {
     req->io_start_time = Clock::now();
     // Step 1: get the blk ids from index table
-    vol_read_ctx read_ctx{.vol_req = req, .blk_size = rd()->get_blk_size()};
+    vol_read_ctx read_ctx{.vol_req = req, .page_size = uint32_cast(vol_info_->page_size)};
+
+    // Pages of writes in flight are the newest, then inline written pages pending destage are newer than what index
+    // maps. Take them in this order before index lookup, so that a write or destage completing in between can't be
+    // missed.
+    range_lock_.read(req->lba, req->end_lba(), read_ctx.page_size, read_ctx.inflight_pages);
+    inline_cache_->read(req->lba, req->end_lba(), read_ctx.inline_pages);
+    if (pending_pages_cover(read_ctx)) {
+        COUNTER_INCREMENT(*metrics_, volume_read_count, 1);
+        apply_inline_pages(read_ctx);
+        return VolumeManager::NullResult();
+    }
+
+    // Fully cached reads skip index lookup and data device.
+    if (read_cache_) {
+        if (read_cache_->read(req->lba, req->nlbas, req->buffer)) {
+            COUNTER_INCREMENT(*metrics_, volume_read_count, 1);
+            COUNTER_INCREMENT(*metrics_, volume_read_cache_hit_count, 1);
+            apply_inline_pages(read_ctx);
+            return VolumeManager::NullResult();
+        }
+        COUNTER_INCREMENT(*metrics_, volume_read_cache_miss_count, 1);
+        read_ctx.cache_gen = read_cache_->generation();
+    }
+
     if (auto index_resp = indx_table()->read_from_index(req, read_ctx.index_kvs); !index_resp.has_value()) {
         LOGE("Failed to read from index table for range=[{}, {}], volume id: {}, error: {}", req->lba, req->end_lba(),
              boost::uuids::to_string(id()), index_resp.error());
@@ -343,19 +1387,96 @@ VolumeManager::NullAsyncResult Volume::read(const vol_interface_req_ptr& req) {
     HISTOGRAM_OBSERVE(*metrics_, volume_map_read_latency, get_elapsed_time_us(req->io_start_time));
     COUNTER_INCREMENT(*metrics_, volume_read_count, 1);
 
-    // Step 2: Consolidate the blocks by merging the contiguous blkids
+    // Pages in L2 read cache are read from fast device instead of data device.
+    auto l2 = l2_cache();
+    if (l2 && std::any_of(read_ctx.index_kvs.cbegin(), read_ctx.index_kvs.cend(), [this, l2](auto const& kv) {
+            return l2->contains(ordinal(), kv.first.lba(), kv.second.blkid());
+        })) {
+        return read_l2_cache(std::move(read_ctx)).thenValue([this](vol_read_ctx&& ctx) {
+            return read_data(std::move(ctx));
+        });
+    }
+    return read_data(std::move(read_ctx));
+}
+
+L2ReadCache* Volume::l2_cache() const {
+    if (checksum_type() == vol_checksum_type::NONE) { return nullptr; }
+    return HomeBlocksImpl::instance()->l2_cache();
+}
+
+folly::Future< vol_read_ctx > Volume::read_l2_cache(vol_read_ctx&& read_ctx) {
+    auto ctx = std::make_shared< vol_read_ctx >(std::move(read_ctx));
+    auto promise = std::make_shared< folly::Promise< vol_read_ctx > >();
+    auto fut = promise->getSemiFuture().via(&folly::InlineExecutor::instance());
+    folly::getGlobalCPUExecutor()->add([this, ctx, promise]() {
+        auto l2 = l2_cache();
+        for (auto const& [key, value] : ctx->index_kvs) {
+            if (is_compressed(value.blkid())) { continue; }
+            sisl::io_blob_safe page{ctx->page_size, 512};
+            if (l2->read(ordinal(), key.lba(), value.blkid(), checksum_type(), value.checksum(), page.bytes(),
+                         ctx->page_size)) {
+                ctx->l2_pages.emplace_back(key.lba(), std::move(page));
+            }
+        }
+
+        // IOs are submitted from reactors, hand the result back to one.
+        iomanager.run_on_forget(iomgr::reactor_regex::random_worker,
+                                [promise, ctx]() { promise->setValue(std::move(*ctx)); });
+    });
+    return fut;
+}
+
+VolumeManager::NullAsyncResult Volume::read_data(vol_read_ctx&& read_ctx) {
+    auto req = read_ctx.vol_req;
+
+    // Step 2: Consolidate the blocks by merging the contiguous blkids, compressed pages are read on their own. Pages
+    // read from L2 read cache are left out, they are holes to data device read.
     std::vector< folly::Future< std::error_code > > futs;
     read_blks_list_t blks_to_read;
-    generate_blkids_to_read(read_ctx.index_kvs, blks_to_read);
+    if (read_ctx.l2_pages.empty()) {
+        generate_blkids_to_read(read_ctx.index_kvs, blks_to_read, true /* skip_compressed */);
+    } else {
+        index_kv_list_t data_kvs;
+        auto l2_it = read_ctx.l2_pages.cbegin();
+        for (auto const& kv : read_ctx.index_kvs) {
+            if (l2_it != read_ctx.l2_pages.cend() && l2_it->first == kv.first.lba()) {
+                ++l2_it;
+                continue;
+            }
+            data_kvs.push_back(kv);
+        }
+        generate_blkids_to_read(data_kvs, blks_to_read, true /* skip_compressed */);
+    }
 
     // Step 3: Submit the read requests to backend
     req->data_svc_start_time = Clock::now();
     submit_read_to_backend(blks_to_read, req, futs);
+    for (size_t i = 0; i < read_ctx.index_kvs.size(); ++i) {
+        auto const& blkid = read_ctx.index_kvs[i].second.blkid();
+        if (!is_compressed(blkid)) { continue; }
+        auto& [_, stored] = read_ctx.compressed_pages.emplace_back(
+            i, sisl::io_blob_safe{blkid.blk_count() * rd()->get_blk_size(), 512});
+        sisl::sg_list sgs;
+        sgs.size = stored.size();
+        sgs.iovs.emplace_back(iovec{.iov_base = stored.bytes(), .iov_len = sgs.size});
+        futs.emplace_back(read_blks(homestore::MultiBlkId(blkid.blk_num(), blkid.blk_count(), blkid.chunk_num()), sgs,
+                                    req->part_of_batch));
+    }
+
+    if (l2_cache()) {
+        COUNTER_INCREMENT(*metrics_, volume_l2_cache_hit_count, read_ctx.l2_pages.size());
+        COUNTER_INCREMENT(*metrics_, volume_l2_cache_miss_count,
+                          read_ctx.index_kvs.size() - read_ctx.l2_pages.size() - read_ctx.compressed_pages.size());
+    }
 
-    if (read_ctx.index_kvs.empty()) { return VolumeManager::NullResult(); }
+    if (read_ctx.index_kvs.empty()) {
+        apply_inline_pages(read_ctx);
+        return VolumeManager::NullResult();
+    }
 
     // Step 4: verify the checksum after all the reads are done
-    return folly::collectAllUnsafe(futs).thenValue([this, read_ctx](auto&& vf) -> VolumeManager::NullResult {
+    return folly::collectAllUnsafe(futs).thenValue([this, read_ctx = std::move(read_ctx)](
+                                                       auto&& vf) mutable -> VolumeManager::NullAsyncResult {
         for (auto const& err_c : vf) {
             if (sisl_unlikely(err_c.value())) {
                 auto ec = err_c.value();
@@ -364,53 +1485,147 @@ VolumeManager::NullAsyncResult Volume::read(const vol_interface_req_ptr& req) {
         }
         HISTOGRAM_OBSERVE(*metrics_, volume_data_read_latency,
                           get_elapsed_time_us(read_ctx.vol_req->data_svc_start_time));
-        // verify the checksum and return
-        return verify_checksum(read_ctx);
+        for (auto const& [lba, page] : read_ctx.l2_pages) {
+            std::memcpy(read_ctx.vol_req->buffer + (lba - read_ctx.vol_req->lba) * read_ctx.page_size, page.cbytes(),
+                        read_ctx.page_size);
+        }
+        // verify the checksum, pages pending destage are copied over what is read from data device.
+        auto ret = decompress_pages(read_ctx);
+        if (ret) { ret = verify_checksum(read_ctx); }
+        if (!ret && ret.error() == VolumeError::CRC_MISMATCH && mirrored()) {
+            // Pages failing checksum are taken from the other copy, which repairs the bad one.
+            auto ctx = std::make_shared< vol_read_ctx >(std::move(read_ctx));
+            return repair_pages(*ctx).thenValue([this, ctx](bool repaired) -> VolumeManager::NullResult {
+                if (!repaired) { return std::unexpected(VolumeError::CRC_MISMATCH); }
+                auto ret = verify_checksum(*ctx);
+                if (ret) {
+                    fill_read_cache(*ctx);
+                    apply_inline_pages(*ctx);
+                }
+                return ret;
+            });
+        }
+        if (ret) {
+            fill_read_cache(read_ctx);
+            apply_inline_pages(read_ctx);
+        }
+        return ret;
     });
 }
 
-void Volume::generate_blkids_to_read(const index_kv_list_t& index_kvs, read_blks_list_t& blks_to_read) {
-    for (uint32_t i = 0, start_idx = 0; i < index_kvs.size(); ++i) {
-        auto const& [key, value] = index_kvs[i];
-        bool is_contiguous = (i == 0 ||
-                              (key.lba() == index_kvs[i - 1].first.lba() + 1 &&
-                               value.blkid().blk_num() == index_kvs[i - 1].second.blkid().blk_num() + 1 &&
-                               value.blkid().chunk_num() == index_kvs[i - 1].second.blkid().chunk_num()));
-        if (is_contiguous && i < index_kvs.size() - 1) {
-            // continue to the next entry if it is contiguous
-            continue;
+void Volume::fill_read_cache(vol_read_ctx const& read_ctx) {
+    // Pages evicted from read cache are in L2 read cache already, as they are put there when read from data device.
+    auto l2 = l2_cache();
+    if (!read_cache_ && !l2) { return; }
+    for (auto const& [key, value] : read_ctx.index_kvs) {
+        auto const offset = (key.lba() - read_ctx.vol_req->lba) * read_ctx.page_size;
+        if (read_cache_) { read_cache_->insert(key.lba(), read_ctx.vol_req->buffer + offset, read_ctx.cache_gen); }
+        if (l2 && !is_compressed(value.blkid())) {
+            l2->insert(ordinal(), key.lba(), value.blkid(), value.checksum(), read_ctx.vol_req->buffer + offset,
+                       read_ctx.page_size);
+        }
+    }
+}
+
+void Volume::apply_inline_pages(vol_read_ctx const& read_ctx) {
+    for (auto const& [lba, page] : read_ctx.inline_pages) {
+        std::memcpy(read_ctx.vol_req->buffer + (lba - read_ctx.vol_req->lba) * read_ctx.page_size, page.cbytes(),
+                    read_ctx.page_size);
+    }
+    for (auto const& [lba, page] : read_ctx.inflight_pages) {
+        std::memcpy(read_ctx.vol_req->buffer + (lba - read_ctx.vol_req->lba) * read_ctx.page_size, page.cbytes(),
+                    read_ctx.page_size);
+    }
+    if (!read_ctx.inline_pages.empty()) {
+        COUNTER_INCREMENT(*metrics_, volume_inline_read_hit_count, read_ctx.inline_pages.size());
+    }
+    if (!read_ctx.inflight_pages.empty()) {
+        COUNTER_INCREMENT(*metrics_, volume_inflight_read_hit_count, read_ctx.inflight_pages.size());
+    }
+}
+
+bool Volume::pending_pages_cover(vol_read_ctx const& read_ctx) const {
+    auto const nlbas = read_ctx.vol_req->nlbas;
+    if (read_ctx.inline_pages.size() == nlbas || read_ctx.inflight_pages.size() == nlbas) { return true; }
+    if (read_ctx.inline_pages.size() + read_ctx.inflight_pages.size() < nlbas) { return false; }
+    std::unordered_set< lba_t > lbas;
+    for (auto const& [lba, _] : read_ctx.inline_pages) {
+        lbas.insert(lba);
+    }
+    for (auto const& [lba, _] : read_ctx.inflight_pages) {
+        lbas.insert(lba);
+    }
+    return lbas.size() == nlbas;
+}
+
+void Volume::generate_blkids_to_read(const index_kv_list_t& index_kvs, read_blks_list_t& blks_to_read,
+                                     bool skip_compressed) {
+    // every index entry maps one page, i.e. blks_per_page blocks or fewer if stored compressed.
+    lba_t next_lba{0};
+    for (auto const& [key, value] : index_kvs) {
+        auto const& blkid = value.blkid();
+        if (skip_compressed && is_compressed(blkid)) { continue; }
+        if (!blks_to_read.empty() && key.lba() == next_lba) {
+            auto& last = blks_to_read.back().second;
+            if (blkid.chunk_num() == last.chunk_num() && blkid.blk_num() == last.blk_num() + last.blk_count()) {
+                // extend the previous blkid if this one is contiguous to it
+                last = homestore::MultiBlkId(last.blk_num(), last.blk_count() + blkid.blk_count(), last.chunk_num());
+                ++next_lba;
+                continue;
+            }
+        }
+        blks_to_read.emplace_back(key.lba(),
+                                  homestore::MultiBlkId(blkid.blk_num(), blkid.blk_count(), blkid.chunk_num()));
+        next_lba = key.lba() + 1;
+    }
+}
+
+VolumeManager::NullResult Volume::decompress_pages(vol_read_ctx const& read_ctx) {
+    // Checksum in index covers the stored page, verify it before trusting the compressed length in it.
+    auto const csum_type = checksum_type();
+    for (auto const& [i, stored] : read_ctx.compressed_pages) {
+        auto const& [key, value] = read_ctx.index_kvs[i];
+        if (csum_type != vol_checksum_type::NONE) {
+            auto checksum = compute_checksum(csum_type, stored.cbytes(), stored.size());
+            if (checksum != value.checksum()) {
+                LOGE("crc mismatch for compressed lba: {} blk id {}, expected: {}, actual: {}", key.lba(),
+                     value.blkid().to_string(), value.checksum(), checksum);
+                return std::unexpected(VolumeError::CRC_MISMATCH);
+            }
         }
-        // prepare the previous contiguous blkids to read
-        auto blk_num = index_kvs[start_idx].second.blkid().blk_num();
-        auto chunk_num = index_kvs[start_idx].second.blkid().chunk_num();
-        // if the last entry is part of the contiguous block,
-        // we need to account for it in the blk_count
-        auto blk_count = is_contiguous ? (i - start_idx + 1) : (i - start_idx);
-        blks_to_read.emplace_back(index_kvs[start_idx].first.lba(),
-                                  homestore::MultiBlkId(blk_num, blk_count, chunk_num));
-        start_idx = i;
-        if (!is_contiguous && i == index_kvs.size() - 1) {
-            // if the last entry is not contiguous, we need to add it as well
-            blks_to_read.emplace_back(key.lba(),
-                                      homestore::MultiBlkId(value.blkid().blk_num(), 1, value.blkid().chunk_num()));
+        auto page = read_ctx.vol_req->buffer + (key.lba() - read_ctx.vol_req->lba) * read_ctx.page_size;
+        if (!decompress_page(compression_type(), stored.cbytes(), stored.size(), page, read_ctx.page_size)) {
+            LOGE("Failed to decompress lba: {} blk id {}, volume: {}", key.lba(), value.blkid().to_string(),
+                 vol_info_->name);
+            return std::unexpected(VolumeError::CRC_MISMATCH);
         }
     }
+    return {};
 }
 
 VolumeManager::NullResult Volume::verify_checksum(vol_read_ctx const& read_ctx) {
     auto read_buf = read_ctx.vol_req->buffer;
-    for (uint64_t cur_lba = read_ctx.vol_req->lba, i = 0; i < read_ctx.index_kvs.size();) {
+    auto const csum_type = checksum_type();
+    for (uint64_t cur_lba = read_ctx.vol_req->lba, i = 0;
+         csum_type != vol_checksum_type::NONE && i < read_ctx.index_kvs.size();) {
         auto const& [key, value] = read_ctx.index_kvs[i];
         // ignore the holes
         if (cur_lba != key.lba()) {
-            read_buf += (key.lba() - cur_lba) * read_ctx.blk_size;
+            read_buf += (key.lba() - cur_lba) * read_ctx.page_size;
             cur_lba = key.lba();
             continue;
         }
-        DEBUG_ASSERT_EQ(read_buf - read_ctx.vol_req->buffer, (cur_lba - read_ctx.vol_req->lba) * read_ctx.blk_size,
+        DEBUG_ASSERT_EQ(read_buf - read_ctx.vol_req->buffer, (cur_lba - read_ctx.vol_req->lba) * read_ctx.page_size,
                         "Read buffer size mismatch, expected: {}, actual: {}",
-                        (cur_lba - read_ctx.vol_req->lba) * read_ctx.blk_size, read_buf - read_ctx.vol_req->buffer);
-        auto checksum = crc16_t10dif(init_crc_16, static_cast< unsigned char* >(read_buf), read_ctx.blk_size);
+                        (cur_lba - read_ctx.vol_req->lba) * read_ctx.page_size, read_buf - read_ctx.vol_req->buffer);
+        // compressed pages are verified before decompress
+        if (is_compressed(value.blkid())) {
+            read_buf += read_ctx.page_size;
+            ++i;
+            ++cur_lba;
+            continue;
+        }
+        auto checksum = compute_checksum(csum_type, read_buf, read_ctx.page_size);
         if (checksum != value.checksum()) {
             LOGE("crc mismatch for lba: {} start: {}, end: {} blk id {}, expected: {}, actual: {}", cur_lba,
                  read_ctx.vol_req->lba, read_ctx.vol_req->end_lba(), value.blkid().to_string(), value.checksum(),
@@ -418,11 +1633,11 @@ VolumeManager::NullResult Volume::verify_checksum(vol_read_ctx const& read_ctx)
             return std::unexpected(VolumeError::CRC_MISMATCH);
         }
 
-        read_buf += read_ctx.blk_size;
+        read_buf += read_ctx.page_size;
         ++i;
         ++cur_lba;
     }
-    auto read_size = read_ctx.vol_req->nlbas * read_ctx.blk_size;
+    auto read_size = read_ctx.vol_req->nlbas * read_ctx.page_size;
     COUNTER_INCREMENT(*metrics_, volume_read_size_total, read_size);
     HISTOGRAM_OBSERVE(*metrics_, volume_read_size_distribution, read_size);
     HISTOGRAM_OBSERVE(*metrics_, volume_read_latency, get_elapsed_time_us(read_ctx.vol_req->io_start_time));
@@ -440,42 +1655,703 @@ void Volume::submit_read_to_backend(read_blks_list_t const& blks_to_read, const
     } else {
         RELEASE_ASSERT(read_buf != nullptr, "Read buffer is null");
     }
+    auto const page_size = vol_info_->page_size;
+    auto const blks_per_pg = blks_per_page();
     uint32_t prev_lba = req->lba;
-    uint32_t prev_nblks = 0;
+    uint32_t prev_nblks = 0; // number of lbas read in the previous blkid
     for (uint32_t i = 0; i < blks_to_read.size(); ++i) {
         auto const& [start_lba, blkids] = blks_to_read[i];
         DEBUG_ASSERT(start_lba >= prev_lba + prev_nblks, "Invalid start lba: {}, prev_lba: {}, prev_nblks: {}",
                      start_lba, prev_lba, prev_nblks);
-        auto holes_size = (start_lba - (prev_lba + prev_nblks)) * rd()->get_blk_size();
+        auto holes_size = (start_lba - (prev_lba + prev_nblks)) * page_size;
         // if there are holes, fill the holes with zeros
         if (holes_size > 0) {
             std::memset(read_buf, 0, holes_size);
             read_buf += holes_size;
         }
-        DEBUG_ASSERT_EQ(read_buf - req->buffer, (start_lba - req->lba) * rd()->get_blk_size(),
-                        "Read buffer size mismatch, expected: {}, actual: {}",
-                        (start_lba - req->lba) * rd()->get_blk_size(), read_buf - req->buffer);
+        DEBUG_ASSERT_EQ(read_buf - req->buffer, (start_lba - req->lba) * page_size,
+                        "Read buffer size mismatch, expected: {}, actual: {}", (start_lba - req->lba) * page_size,
+                        read_buf - req->buffer);
         sisl::sg_list sgs;
         sgs.size = blkids.blk_count() * rd()->get_blk_size();
         sgs.iovs.emplace_back(iovec{.iov_base = read_buf, .iov_len = sgs.size});
         read_buf += sgs.size;
-        futs.emplace_back(rd()->async_read(blkids, sgs, sgs.size, req->part_of_batch));
+        futs.emplace_back(read_blks(blkids, sgs, req->part_of_batch));
         prev_lba = start_lba;
-        prev_nblks = blkids.blk_count();
+        prev_nblks = blkids.blk_count() / blks_per_pg;
     }
     // if there are any holes at the end, fill them with zeros
     if (prev_lba + prev_nblks < req->end_lba() + 1) {
-        auto holes_size = (req->end_lba() + 1 - (prev_lba + prev_nblks)) * rd()->get_blk_size();
+        auto holes_size = (req->end_lba() + 1 - (prev_lba + prev_nblks)) * page_size;
         if (holes_size > 0) {
             std::memset(read_buf, 0, holes_size);
             read_buf += holes_size;
         }
     }
-    DEBUG_ASSERT_EQ(read_buf - req->buffer, req->nlbas * rd()->get_blk_size(),
-                    "Read buffer size mismatch, expected: {}, actual: {}", req->nlbas * rd()->get_blk_size(),
+    DEBUG_ASSERT_EQ(read_buf - req->buffer, req->nlbas * page_size,
+                    "Read buffer size mismatch, expected: {}, actual: {}", req->nlbas * page_size,
                     read_buf - req->buffer);
 }
 
+VolumeManager::AsyncResult< lba_t > Volume::scrub(uint64_t max_bytes) {
+    // nothing to verify against, a full pass is trivially done;
+    if (checksum_type() == vol_checksum_type::NONE) { return VolumeManager::Result< lba_t >(0); }
+
+    bool expected{false};
+    if (!scrub_in_progress_.compare_exchange_strong(expected, true)) {
+        LOGD("Scrub already in progress on volume: {}, skip this round", vol_info_->name);
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+
+    auto const start_time = Clock::now();
+    auto const page_size = vol_info_->page_size;
+    auto const max_lba = vol_info_->size_bytes / page_size;
+    lba_t start_lba = scrub_cursor();
+    if (start_lba >= max_lba) { start_lba = 0; }
+
+    // Step 1: get at most max_bytes worth of mapped lbas starting from the cursor.
+    index_kv_list_t index_kvs;
+    auto const max_entries = static_cast< uint32_t >(std::max(1ul, max_bytes / page_size));
+    auto ret = indx_table()->query_range(start_lba, max_lba - 1, max_entries, index_kvs);
+    if (!ret.has_value()) {
+        LOGE("Failed to read from index table for scrub range=[{}, {}], volume: {}, error: {}", start_lba, max_lba - 1,
+             vol_info_->name, ret.error());
+        scrub_in_progress_ = false;
+        return std::unexpected(ret.error());
+    }
+    lba_t const next_cursor = (ret.value() && !index_kvs.empty()) ? index_kvs.back().first.lba() + 1 : 0;
+
+    // Step 2: merge contiguous blkids, so that the scrubber issues a few large IOs instead of one per block.
+    read_blks_list_t blks_to_read;
+    generate_blkids_to_read(index_kvs, blks_to_read);
+
+    // Step 3: read the mapped blocks back to back into a scratch buffer, holes are skipped. Compressed pages are
+    // verified as stored. Mirrored volumes have both copies read, one after the other in the buffer, as reads go to
+    // either copy and would never come across a stale one while the other is good.
+    uint64_t buf_size{0};
+    for (auto const& [_, blkids] : blks_to_read) {
+        buf_size += blkids.blk_count() * rd()->get_blk_size();
+    }
+    uint32_t const num_copies = mirrored() ? 2 : 1;
+    auto buf = std::make_shared< sisl::io_blob_safe >(std::max< uint64_t >(page_size, num_copies * buf_size), 512);
+    std::vector< folly::Future< std::error_code > > futs;
+    auto read_buf = buf->bytes();
+    for (uint32_t copy = 0; copy < num_copies; ++copy) {
+        for (auto const& [_, blkids] : blks_to_read) {
+            sisl::sg_list sgs;
+            sgs.size = blkids.blk_count() * rd()->get_blk_size();
+            sgs.iovs.emplace_back(iovec{.iov_base = read_buf, .iov_len = sgs.size});
+            read_buf += sgs.size;
+            futs.emplace_back(mirrored() ? read_copy(blkids, copy, sgs, false /* part_of_batch */)
+                                         : read_blks(blkids, sgs, false /* part_of_batch */));
+        }
+    }
+
+    // Step 4: verify the checksum after all the reads are done
+    return folly::collectAllUnsafe(futs).thenValue([this, buf, buf_size, index_kvs = std::move(index_kvs), next_cursor,
+                                                    start_time](auto&& vf) -> VolumeManager::AsyncResult< lba_t > {
+        auto ret = [&]() -> VolumeManager::AsyncResult< lba_t > {
+            for (auto const& err_c : vf) {
+                if (sisl_unlikely(err_c.value())) {
+                    return VolumeManager::Result< lba_t >(std::unexpected(to_volume_error(err_c.value())));
+                }
+            }
+            auto mirror_buf = mirrored() ? buf->cbytes() + buf_size : nullptr;
+            return verify_scrubbed_blks(index_kvs, buf->cbytes(), mirror_buf, next_cursor);
+        }();
+        return std::move(ret).ensure([this, start_time]() {
+            HISTOGRAM_OBSERVE(*metrics_, volume_scrub_latency, get_elapsed_time_us(start_time));
+            scrub_in_progress_ = false;
+        });
+    });
+}
+
+VolumeManager::AsyncResult< lba_t > Volume::verify_scrubbed_blks(index_kv_list_t const& index_kvs,
+                                                                 uint8_t const* buf, uint8_t const* mirror_buf,
+                                                                 lba_t next_cursor) {
+    auto const page_size = vol_info_->page_size;
+    index_kv_list_t mismatched_kvs;
+    auto const blk_size = rd()->get_blk_size();
+    for (auto const& [key, value] : index_kvs) {
+        auto const stored_size = value.blkid().blk_count() * blk_size;
+        auto checksum = compute_checksum(checksum_type(), buf, stored_size);
+        buf += stored_size;
+        uint32_t bad_copy{0};
+        if (mirror_buf) {
+            if (checksum == value.checksum()) {
+                checksum = compute_checksum(checksum_type(), mirror_buf, stored_size);
+                bad_copy = 1;
+            }
+            mirror_buf += stored_size;
+        }
+        if (checksum == value.checksum()) { continue; }
+
+        // The lba could have been overwritten and its old blk freed and reused after we looked up the index, confirm
+        // the mapping is still the one we verified before reporting it.
+        index_kv_list_t cur_kvs;
+        if (auto ret = indx_table()->query_range(key.lba(), key.lba(), 1, cur_kvs);
+            !ret.has_value() || cur_kvs.empty() || !(cur_kvs[0].second == value)) {
+            LOGD("Scrub skipped lba: {} of volume: {}, mapping changed while scrubbing", key.lba(), vol_info_->name);
+            continue;
+        }
+
+        LOGE("Scrub found crc mismatch for lba: {} blk id {} copy {} volume: {}, expected: {}, actual: {}", key.lba(),
+             value.blkid().to_string(), bad_copy, vol_info_->name, value.checksum(), checksum);
+        mismatched_kvs.emplace_back(key, value);
+    }
+
+    COUNTER_INCREMENT(*metrics_, volume_scrub_size_total, index_kvs.size() * page_size);
+    persist_scrub_cursor(next_cursor);
+    if (next_cursor == 0) {
+        COUNTER_INCREMENT(*metrics_, volume_scrub_pass_count, 1);
+        LOGI("Scrub pass completed on volume: {}", vol_info_->name);
+    }
+    if (mismatched_kvs.empty()) { return VolumeManager::Result< lba_t >(next_cursor); }
+    COUNTER_INCREMENT(*metrics_, volume_scrub_crc_mismatch_count, mismatched_kvs.size());
+
+    // Mirrored volume repairs the bad copies from the good ones, only pages with no good copy left are reported.
+    std::vector< folly::Future< bool > > repairs;
+    if (mirrored()) {
+        for (auto const& [key, value] : mismatched_kvs) {
+            repairs.emplace_back(repair_page(key.lba(), value, nullptr /* buf */));
+        }
+    }
+    return folly::collectAllUnsafe(repairs).thenValue(
+        [this, num_mismatches = mismatched_kvs.size(), next_cursor](auto&& results) -> VolumeManager::Result< lba_t > {
+            size_t const num_repaired =
+                std::count_if(results.begin(), results.end(), [](auto const& t) { return t.hasValue() && t.value(); });
+            auto const num_bad = num_mismatches - num_repaired;
+            if (num_bad == 0) { return next_cursor; }
+
+            auto inst = HomeBlocksImpl::instance();
+            if (inst->fc_on()) {
+                auto const reason =
+                    fmt::format("scrub found {} crc mismatches on volume: {}", num_bad, vol_info_->name);
+                inst->fault_containment(shared_from_this(), reason);
+            }
+            return std::unexpected(VolumeError::CRC_MISMATCH);
+        });
+}
+
+homestore::MultiBlkId Volume::mirror_blkid(homestore::MultiBlkId const& blkid) const {
+    DEBUG_ASSERT_EQ(blkid.num_pieces(), 1, "Multiple blkid pieces");
+    return homestore::MultiBlkId(blkid.blk_num(), blkid.blk_count(), mirror_chunks_.at(blkid.chunk_num()));
+}
+
+folly::Future< std::error_code > Volume::write_blks(std::vector< homestore::MultiBlkId > const& blkids,
+                                                    sisl::sg_list const& sgs, bool part_of_batch, lba_t start_lba,
+                                                    lba_t end_lba) {
+#ifdef _PRERELEASE
+    if (iomgr_flip::instance()->test_flip("vol_write_data_failure")) {
+        LOGINFO("Volume write data failure flip is set, failing the data write");
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::io_error));
+    }
+    if (iomgr_flip::instance()->test_flip("vol_write_corrupt_data")) {
+        // this is to simulate data corrupted on its way to the device, found by checksum later. Only the primary copy
+        // is corrupted, the mirror copy if any is written as is.
+        LOGINFO("Volume write corrupt data flip is set, corrupting the primary copy");
+        auto corrupt = std::make_shared< sisl::io_blob_safe >(uint32_cast(sgs.size), 512);
+        auto dst = corrupt->bytes();
+        for (auto const& iov : sgs.iovs) {
+            std::memcpy(dst, iov.iov_base, iov.iov_len);
+            dst += iov.iov_len;
+        }
+        corrupt->bytes()[0] ^= 0xff;
+        sisl::sg_list corrupt_sgs;
+        corrupt_sgs.size = sgs.size;
+        corrupt_sgs.iovs.emplace_back(iovec{.iov_base = corrupt->bytes(), .iov_len = sgs.size});
+        auto primary = rd()->async_write(blkids, corrupt_sgs, part_of_batch).thenValue([corrupt](auto&& err) {
+            return err;
+        });
+        if (!mirrored()) { return primary; }
+        std::vector< folly::Future< std::error_code > > futs;
+        futs.emplace_back(std::move(primary));
+        futs.emplace_back(write_copy(blkids, 1 /* copy */, sgs, part_of_batch));
+        return folly::collectAllUnsafe(futs).thenValue([](auto&& results) {
+            for (auto const& t : results) {
+                if (!t.hasValue() || t.value()) { return std::make_error_code(std::errc::io_error); }
+            }
+            return std::error_code{};
+        });
+    }
+#endif
+    if (!mirrored()) { return rd()->async_write(blkids, sgs, part_of_batch); }
+
+#ifdef _PRERELEASE
+    if (iomgr_flip::instance()->test_flip("vol_mirror_lost_copy_write")) {
+        // this is to simulate a write lost on the mirror copy, which is found by checksum and repaired from the other.
+        LOGINFO("Volume mirror lost copy write flip is set, skip the mirror copy");
+        return rd()->async_write(blkids, sgs, part_of_batch);
+    }
+#endif
+
+    std::vector< folly::Future< std::error_code > > futs;
+    for (uint32_t copy = 0; copy < 2; ++copy) {
+        futs.emplace_back(write_copy(blkids, copy, sgs, part_of_batch));
+    }
+    return folly::collectAllUnsafe(futs).thenValue([this, start_lba, end_lba](auto&& results) {
+        std::error_code ret;
+        uint32_t num_failed{0};
+        uint32_t stale_copy{0};
+        for (uint32_t copy = 0; copy < 2; ++copy) {
+            auto const& t = results[copy];
+            if (t.hasValue() && !t.value()) { continue; }
+            ret = t.hasValue() ? t.value() : std::make_error_code(std::errc::io_error);
+            stale_copy = copy;
+            ++num_failed;
+        }
+        if (num_failed == 1) {
+            // The lbas are kept locked by this write until it is committed, they are resynced from the other copy
+            // after that.
+            LOGW("Write of lbas [{}, {}] failed on copy {} of mirrored volume: {}, error: {}", start_lba, end_lba,
+                 stale_copy, vol_info_->name, ret.message());
+            COUNTER_INCREMENT(*metrics_, volume_mirror_write_error_count, 1);
+            mark_mirror_dirty(start_lba, end_lba, stale_copy);
+            ret = std::error_code{};
+        }
+        return ret;
+    });
+}
+
+folly::Future< std::error_code > Volume::write_copy(std::vector< homestore::MultiBlkId > const& blkids, uint32_t copy,
+                                                    sisl::sg_list const& sgs, bool part_of_batch) {
+#ifdef _PRERELEASE
+    if (copy && iomgr_flip::instance()->test_flip("vol_mirror_copy_write_failure")) {
+        LOGINFO("Volume mirror copy write failure flip is set, failing the write of the mirror copy");
+        return folly::makeFuture< std::error_code >(std::make_error_code(std::errc::io_error));
+    }
+#endif
+    if (!copy) { return rd()->async_write(blkids, sgs, part_of_batch); }
+
+    // Copies are never allocated, the same blks of the paired chunks are allocated and freed along with the volume's.
+    std::vector< homestore::MultiBlkId > mirror_blkids;
+    for (auto const& blkid : blkids) {
+        mirror_blkids.emplace_back(mirror_blkid(blkid));
+    }
+    return rd()->async_write(mirror_blkids, sgs, part_of_batch);
+}
+
+folly::Future< std::error_code > Volume::read_blks(homestore::MultiBlkId const& blkid, sisl::sg_list const& sgs,
+                                                   bool part_of_batch) {
+    if (!mirrored()) { return rd()->async_read(blkid, sgs, sgs.size, part_of_batch); }
+
+    uint32_t const copy = (inflight_reads_[1].load() < inflight_reads_[0].load()) ? 1 : 0;
+    return read_copy(blkid, copy, sgs, part_of_batch)
+        .thenValue([this, blkid, copy, sgs, part_of_batch](auto&& err) -> folly::Future< std::error_code > {
+            if (!err) { return err; }
+            LOGW("Read of blk id {} failed on copy {} of mirrored volume: {}, error: {}, retry the other copy",
+                 blkid.to_string(), copy, vol_info_->name, err.message());
+            COUNTER_INCREMENT(*metrics_, volume_mirror_read_failover_count, 1);
+            return read_copy(blkid, 1 - copy, sgs, part_of_batch);
+        });
+}
+
+folly::Future< std::error_code > Volume::read_copy(homestore::MultiBlkId const& blkid, uint32_t copy,
+                                                   sisl::sg_list const& sgs, bool part_of_batch) {
+    ++inflight_reads_[copy];
+    return rd()
+        ->async_read(copy ? mirror_blkid(blkid) : blkid, sgs, sgs.size, part_of_batch)
+        .ensure([this, copy]() { --inflight_reads_[copy]; });
+}
+
+folly::Future< bool > Volume::repair_pages(vol_read_ctx const& read_ctx) {
+    std::vector< folly::Future< bool > > futs;
+    for (auto const& [key, value] : read_ctx.index_kvs) {
+        auto page = read_ctx.vol_req->buffer + (key.lba() - read_ctx.vol_req->lba) * read_ctx.page_size;
+        if (compute_checksum(checksum_type(), page, read_ctx.page_size) == value.checksum()) { continue; }
+        futs.emplace_back(repair_page(key.lba(), value, page));
+    }
+    return folly::collectAllUnsafe(futs).thenValue([](auto&& results) {
+        return std::all_of(results.begin(), results.end(), [](auto const& t) { return t.hasValue() && t.value(); });
+    });
+}
+
+folly::Future< bool > Volume::repair_page(lba_t lba, VolumeIndexValue const& value, uint8_t* buf) {
+    // Either copy could have been read before, read both.
+    auto const page_size = uint32_cast(vol_info_->page_size);
+    auto const blkid =
+        homestore::MultiBlkId(value.blkid().blk_num(), value.blkid().blk_count(), value.blkid().chunk_num());
+    auto copies = std::make_shared< std::array< sisl::io_blob_safe, 2 > >();
+    std::vector< folly::Future< std::error_code > > futs;
+    for (uint32_t copy = 0; copy < 2; ++copy) {
+        (*copies)[copy] = sisl::io_blob_safe{page_size, 512};
+        sisl::sg_list sgs;
+        sgs.size = page_size;
+        sgs.iovs.emplace_back(iovec{.iov_base = (*copies)[copy].bytes(), .iov_len = sgs.size});
+        futs.emplace_back(read_copy(blkid, copy, sgs, false /* part_of_batch */));
+    }
+
+    return folly::collectAllUnsafe(futs).thenValue([this, lba, value, buf, blkid, copies,
+                                                    page_size](auto&& results) -> folly::Future< bool > {
+        std::array< bool, 2 > good;
+        for (uint32_t copy = 0; copy < 2; ++copy) {
+            good[copy] = results[copy].hasValue() && !results[copy].value() &&
+                compute_checksum(checksum_type(), (*copies)[copy].cbytes(), page_size) == value.checksum();
+        }
+        if (!good[0] && !good[1]) {
+            LOGE("No copy of lba: {} blk id {} volume: {} passes checksum", lba, blkid.to_string(), vol_info_->name);
+            return false;
+        }
+        auto const src = good[0] ? 0 : 1;
+        if (buf) { std::memcpy(buf, (*copies)[src].cbytes(), page_size); }
+        if (good[0] && good[1]) { return true; }
+
+        // Rewrite the bad copy under the range lock, unless lba was remapped meanwhile and its blk could be reused.
+        auto const bad = 1 - src;
+        auto rewrite = [this, lba, value, blkid, copies, src, bad, page_size]() -> VolumeManager::NullAsyncResult {
+            index_kv_list_t cur_kvs;
+            if (auto ret = indx_table()->query_range(lba, lba, 1, cur_kvs);
+                !ret.has_value() || cur_kvs.empty() || !(cur_kvs[0].second == value)) {
+                return VolumeManager::NullResult();
+            }
+            sisl::sg_list sgs;
+            sgs.size = page_size;
+            sgs.iovs.emplace_back(iovec{.iov_base = (*copies)[src].bytes(), .iov_len = sgs.size});
+            return write_copy({blkid}, bad, sgs, false /* part_of_batch */)
+                .thenValue([this, lba, bad](auto&& err) -> VolumeManager::NullResult {
+                    if (err) {
+                        LOGE("Failed to repair copy {} of lba: {} volume: {}, error: {}", bad, lba, vol_info_->name,
+                             err.message());
+                        return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
+                    }
+                    COUNTER_INCREMENT(*metrics_, volume_mirror_repair_count, 1);
+                    ++mirror_repaired_pages_;
+                    LOGI("Repaired copy {} of lba: {} volume: {}", bad, lba, vol_info_->name);
+                    return {};
+                });
+        };
+        // data given back is good, even if the repair failed;
+        return locked_write(lba, lba, nullptr /* data */, std::move(rewrite)).thenValue([](auto&&) { return true; });
+    });
+}
+
+void Volume::persist_scrub_cursor(lba_t next_cursor) {
+    std::scoped_lock lg(sb_lock_);
+    sb_->scrub_cursor = next_cursor;
+    // Persisting the cursor on every batch is not worth a meta blk write, after a restart at most
+    // SCRUB_PERSIST_INTERVAL batches will be verified again.
+    if (++scrub_batches_since_persist_ >= SCRUB_PERSIST_INTERVAL || next_cursor == 0) {
+        scrub_batches_since_persist_ = 0;
+        sb_.write();
+    }
+}
+
+void Volume::mark_mirror_dirty(lba_t start_lba, lba_t end_lba, uint32_t stale_copy) {
+    std::scoped_lock lg(sb_lock_);
+    auto ranges = sb_->mirror_dirty;
+    auto& num_ranges = sb_->num_mirror_dirty;
+    ++mirror_dirty_gen_;
+
+    // Once all the slots are taken, ranges of each copy are collapsed into one covering them all. More lbas are
+    // resynced than needed then, which is harmless.
+    if (num_ranges == MIRROR_DIRTY_SLOTS) {
+        std::array< std::optional< mirror_dirty_range_t >, 2 > collapsed;
+        for (uint32_t i = 0; i < num_ranges; ++i) {
+            auto& c = collapsed[ranges[i].stale_copy];
+            if (!c) {
+                c = ranges[i];
+                continue;
+            }
+            c->start_lba = std::min(c->start_lba, ranges[i].start_lba);
+            c->end_lba = std::max(c->end_lba, ranges[i].end_lba);
+        }
+        num_ranges = 0;
+        for (auto const& c : collapsed) {
+            if (c) { ranges[num_ranges++] = *c; }
+        }
+    }
+
+    // A range of the same copy overlapping or adjacent to this one is extended.
+    uint32_t i = 0;
+    for (; i < num_ranges; ++i) {
+        auto& r = ranges[i];
+        if (r.stale_copy == stale_copy && start_lba <= r.end_lba + 1 && r.start_lba <= end_lba + 1) {
+            r.start_lba = std::min(r.start_lba, start_lba);
+            r.end_lba = std::max(r.end_lba, end_lba);
+            break;
+        }
+    }
+    if (i == num_ranges) { ranges[num_ranges++] = mirror_dirty_range_t{start_lba, end_lba, stale_copy}; }
+    sb_.write();
+}
+
+uint32_t Volume::num_mirror_dirty_ranges() {
+    std::scoped_lock lg(sb_lock_);
+    return sb_->num_mirror_dirty;
+}
+
+VolumeManager::NullAsyncResult Volume::resync_mirror() {
+    bool expected{false};
+    if (!resync_in_progress_.compare_exchange_strong(expected, true)) { return VolumeManager::NullResult(); }
+
+    mirror_dirty_range_t range;
+    uint64_t gen;
+    {
+        std::scoped_lock lg(sb_lock_);
+        if (sb_->num_mirror_dirty == 0) {
+            resync_in_progress_ = false;
+            return VolumeManager::NullResult();
+        }
+        range = sb_->mirror_dirty[0];
+        gen = mirror_dirty_gen_;
+    }
+
+    LOGI("Resyncing copy {} of lbas [{}, {}] volume: {}", range.stale_copy, range.start_lba, range.end_lba,
+         vol_info_->name);
+    return resync_range(range, range.start_lba).thenValue([this, range, gen](auto&& ret) {
+        if (ret) {
+            std::scoped_lock lg(sb_lock_);
+            // Lbas marked again while they were resynced could have been copied before the failed write, the range
+            // is left for the next round then.
+            if (gen == mirror_dirty_gen_) {
+                auto ranges = sb_->mirror_dirty;
+                std::copy(ranges + 1, ranges + sb_->num_mirror_dirty, ranges);
+                --sb_->num_mirror_dirty;
+                sb_.write();
+                LOGI("Resynced copy {} of lbas [{}, {}] volume: {}", range.stale_copy, range.start_lba,
+                     range.end_lba, vol_info_->name);
+            }
+        }
+        resync_in_progress_ = false;
+        return ret;
+    });
+}
+
+VolumeManager::NullAsyncResult Volume::resync_range(mirror_dirty_range_t const& range, lba_t start_lba) {
+    // Writes of the lbas being copied wait, so that what is copied can't be stale by the time it lands.
+    auto const end_lba = std::min< lba_t >(range.end_lba, start_lba + MIRROR_RESYNC_PAGES - 1);
+    auto const stale_copy = range.stale_copy;
+    auto copy_fn = [this, start_lba, end_lba, stale_copy]() { return resync_pages(start_lba, end_lba, stale_copy); };
+    return locked_write(start_lba, end_lba, nullptr /* data */, std::move(copy_fn))
+        .thenValue([this, range, end_lba](auto&& ret) -> VolumeManager::NullAsyncResult {
+            if (!ret || end_lba == range.end_lba) { return ret; }
+            return resync_range(range, end_lba + 1);
+        });
+}
+
+VolumeManager::NullAsyncResult Volume::resync_pages(lba_t start_lba, lba_t end_lba, uint32_t stale_copy) {
+    index_kv_list_t index_kvs;
+    auto ret = indx_table()->query_range(start_lba, end_lba, uint32_cast(end_lba - start_lba + 1), index_kvs);
+    if (!ret.has_value()) {
+        LOGE("Failed to read from index table for resync range=[{}, {}], volume: {}, error: {}", start_lba, end_lba,
+             vol_info_->name, ret.error());
+        return std::unexpected(ret.error());
+    }
+
+    read_blks_list_t blks_to_copy;
+    generate_blkids_to_read(index_kvs, blks_to_copy);
+    std::vector< folly::Future< std::error_code > > futs;
+    for (auto const& [_, blkid] : blks_to_copy) {
+        auto buf = std::make_shared< sisl::io_blob_safe >(uint32_cast(blkid.blk_count() * rd()->get_blk_size()), 512);
+        sisl::sg_list sgs;
+        sgs.size = buf->size();
+        sgs.iovs.emplace_back(iovec{.iov_base = buf->bytes(), .iov_len = sgs.size});
+        futs.emplace_back(read_copy(blkid, 1 - stale_copy, sgs, false /* part_of_batch */)
+                              .thenValue([this, blkid, stale_copy, sgs, buf](auto&& err) {
+                                  if (err) { return folly::makeFuture< std::error_code >(std::move(err)); }
+                                  return write_copy({blkid}, stale_copy, sgs, false /* part_of_batch */);
+                              }));
+    }
+    auto const num_pages = index_kvs.size();
+    return folly::collectAllUnsafe(futs).thenValue(
+        [this, start_lba, end_lba, stale_copy, num_pages](auto&& results) -> VolumeManager::NullResult {
+            for (auto const& t : results) {
+                if (t.hasValue() && !t.value()) { continue; }
+                LOGE("Failed to resync copy {} of lbas [{}, {}] volume: {}", stale_copy, start_lba, end_lba,
+                     vol_info_->name);
+                return std::unexpected(VolumeError::DRIVE_WRITE_ERROR);
+            }
+            COUNTER_INCREMENT(*metrics_, volume_mirror_resync_count, num_pages);
+            return {};
+        });
+}
+
+void Volume::enable_log_structured() {
+    DEBUG_ASSERT(!mirrored(), "Log structured allocation is not supported for mirrored volume: {}", vol_info_->name);
+    LOGI("Enabling log structured allocation for volume: {}", vol_info_->name);
+    volume_chunk_selector_->set_log_structured(vol_info_->ordinal);
+    log_structured_ = true;
+}
+
+VolumeManager::AsyncResult< uint64_t > Volume::clean(uint64_t max_bytes) {
+    if (!log_structured_ || !indx_tbl_) { return VolumeManager::Result< uint64_t >(0); }
+
+    bool expected{false};
+    if (!clean_in_progress_.compare_exchange_strong(expected, true)) {
+        LOGD("Clean already in progress on volume: {}, skip this round", vol_info_->name);
+        return VolumeManager::Result< uint64_t >(0);
+    }
+
+    if (!clean_chunk_) {
+        auto built = build_chunk_extents();
+        if (!built.has_value() || !built.value()) {
+            clean_in_progress_ = false;
+            if (!built.has_value()) { return std::unexpected(built.error()); }
+            return VolumeManager::Result< uint64_t >(0);
+        }
+
+        clean_chunk_ = volume_chunk_selector_->select_victim_chunk(vol_info_->ordinal,
+                                                                   HB_DYNAMIC_CONFIG(cleaner_max_live_pct));
+        if (!clean_chunk_) {
+            clean_in_progress_ = false;
+            return VolumeManager::Result< uint64_t >(0);
+        }
+
+        // Victim is neither appended to nor allocated hot blks from, no extent is added for it while it is cleaned.
+        clean_extents_.clear();
+        {
+            std::scoped_lock lg(chunk_extents_mtx_);
+            if (auto it = chunk_extents_.find(*clean_chunk_); it != chunk_extents_.end()) {
+                clean_extents_.assign(it->second.begin(), it->second.end());
+                chunk_extents_.erase(it);
+            }
+        }
+        clean_extent_idx_ = 0;
+        clean_cursor_ = clean_extents_.empty() ? 0 : clean_extents_.front() * CLEAN_EXTENT_PAGES;
+        LOGD("Cleaning chunk: {} of volume: {}, extents to scan: {}", *clean_chunk_, vol_info_->name,
+             clean_extents_.size());
+    }
+
+    // Step 1: scan index in the extents written into the chunk for runs of lbas still mapped into it, up to max_bytes
+    // worth.
+    auto const chunk = *clean_chunk_;
+    auto const page_size = vol_info_->page_size;
+    auto const max_lba = vol_info_->size_bytes / page_size;
+    std::vector< std::pair< lba_t, lba_count_t > > runs;
+    uint64_t clean_size{0};
+    uint32_t num_scanned{0};
+    while (clean_extent_idx_ < clean_extents_.size() && clean_size < max_bytes && num_scanned < CLEAN_MAX_SCAN) {
+        auto const ext_end = std::min((clean_extents_[clean_extent_idx_] + 1) * CLEAN_EXTENT_PAGES, max_lba) - 1;
+        index_kv_list_t index_kvs;
+        auto ret = indx_table()->query_range(clean_cursor_, ext_end, CLEAN_SCAN_BATCH, index_kvs);
+        if (!ret.has_value()) {
+            LOGE("Failed to read from index table for clean from lba: {}, volume: {}, error: {}", clean_cursor_,
+                 vol_info_->name, ret.error());
+            clean_in_progress_ = false;
+            return std::unexpected(ret.error());
+        }
+        for (auto const& [key, value] : index_kvs) {
+            if (value.blkid().chunk_num() != chunk) { continue; }
+            auto const lba = key.lba();
+            if (!runs.empty() && runs.back().first + runs.back().second == lba &&
+                runs.back().second < CLEAN_MAX_RUN_PAGES) {
+                ++runs.back().second;
+            } else {
+                runs.emplace_back(lba, 1);
+            }
+            clean_size += page_size;
+        }
+        num_scanned += index_kvs.size();
+        if (ret.value() && !index_kvs.empty()) {
+            clean_cursor_ = index_kvs.back().first.lba() + 1;
+        } else if (++clean_extent_idx_ < clean_extents_.size()) {
+            clean_cursor_ = clean_extents_[clean_extent_idx_] * CLEAN_EXTENT_PAGES;
+        }
+    }
+
+    // All the extents are scanned, the chunk is done with once these are moved. Next round picks another one.
+    if (clean_extent_idx_ >= clean_extents_.size()) { clean_chunk_.reset(); }
+
+    // Step 2: move the runs found, they are appended to the chunk being allocated from.
+    std::vector< VolumeManager::NullAsyncResult > futs;
+    for (auto const& [lba, nlbas] : runs) {
+        futs.emplace_back(relocate(lba, nlbas, chunk));
+    }
+    return folly::collectAllUnsafe(futs).thenValue(
+        [this, chunk, clean_size, runs = std::move(runs)](auto&& results) -> VolumeManager::Result< uint64_t > {
+            clean_in_progress_ = false;
+            uint32_t num_failed{0};
+            for (size_t i = 0; i < results.size(); ++i) {
+                auto const& t = results[i];
+                if (!t.hasException() && t.value().has_value()) { continue; }
+                // Lbas left in the chunk are found again when it is picked next time.
+                record_chunk_extents(runs[i].first, runs[i].first + runs[i].second - 1, chunk);
+                ++num_failed;
+            }
+            if (num_failed) {
+                LOGW("Failed to move {} runs of lbas out of chunk: {}, volume: {}", num_failed, chunk,
+                     vol_info_->name);
+            }
+            COUNTER_INCREMENT(*metrics_, volume_clean_size_total, clean_size);
+            return clean_size;
+        });
+}
+
+VolumeManager::Result< bool > Volume::build_chunk_extents() {
+    if (chunk_extents_built_) { return true; }
+
+    // Index updates record the extents of their lbas meanwhile, entries found here only add to them.
+    auto const max_lba = vol_info_->size_bytes / vol_info_->page_size;
+    uint32_t num_scanned{0};
+    bool has_more{true};
+    while (has_more && num_scanned < CLEAN_MAX_SCAN) {
+        index_kv_list_t index_kvs;
+        auto ret = indx_table()->query_range(chunk_extents_cursor_, max_lba - 1, CLEAN_SCAN_BATCH, index_kvs);
+        if (!ret.has_value()) {
+            LOGE("Failed to read from index table for chunk extents from lba: {}, volume: {}, error: {}",
+                 chunk_extents_cursor_, vol_info_->name, ret.error());
+            return std::unexpected(ret.error());
+        }
+        {
+            std::scoped_lock lg(chunk_extents_mtx_);
+            for (auto const& [key, value] : index_kvs) {
+                chunk_extents_[value.blkid().chunk_num()].insert(key.lba() / CLEAN_EXTENT_PAGES);
+            }
+        }
+        num_scanned += index_kvs.size();
+        has_more = ret.value() && !index_kvs.empty();
+        if (has_more) { chunk_extents_cursor_ = index_kvs.back().first.lba() + 1; }
+    }
+    if (!has_more) {
+        LOGI("Chunk extents of volume: {} are built", vol_info_->name);
+        chunk_extents_built_ = true;
+    }
+    return chunk_extents_built_;
+}
+
+VolumeManager::NullAsyncResult Volume::relocate(lba_t start_lba, lba_count_t nlbas, chunk_num_t chunk) {
+    auto move_fn = [this, start_lba, nlbas, chunk]() -> VolumeManager::NullAsyncResult {
+        // Lbas overwritten or unmapped since the scan are not in the chunk anymore, only the rest is moved.
+        vol_interface_req_ptr lookup(new vol_interface_req{nullptr, start_lba, nlbas, shared_from_this()});
+        index_kv_list_t index_kvs;
+        if (auto ret = indx_table()->read_from_index(lookup, index_kvs); !ret.has_value()) {
+            return std::unexpected(ret.error());
+        }
+
+        std::vector< std::pair< lba_t, lba_count_t > > runs;
+        for (auto const& [key, value] : index_kvs) {
+            if (value.blkid().chunk_num() != chunk) { continue; }
+            auto const lba = key.lba();
+            if (!runs.empty() && runs.back().first + runs.back().second == lba) {
+                ++runs.back().second;
+            } else {
+                runs.emplace_back(lba, 1);
+            }
+        }
+
+        std::vector< VolumeManager::NullAsyncResult > futs;
+        for (auto const& [lba, n] : runs) {
+            auto buf = std::make_shared< sisl::io_blob_safe >(uint32_cast(n * vol_info_->page_size), 512);
+            vol_interface_req_ptr req(new vol_interface_req{buf->bytes(), lba, n, shared_from_this()});
+            futs.emplace_back(read(req).thenValue([this, buf, req](auto&& result) -> VolumeManager::NullAsyncResult {
+                if (!result.has_value()) { return std::unexpected(result.error()); }
+                vol_interface_req_ptr wreq(
+                    new vol_interface_req{buf->bytes(), req->lba, req->nlbas, shared_from_this()});
+                wreq->relocation = true;
+                return write(wreq).thenValue([buf, wreq](auto&& ret) { return ret; });
+            }));
+        }
+        return folly::collectAllUnsafe(futs).thenValue([](auto&& results) -> VolumeManager::NullResult {
+            for (auto const& t : results) {
+                if (t.hasException()) { return std::unexpected(VolumeError::DRIVE_WRITE_ERROR); }
+                if (!t.value().has_value()) { return std::unexpected(t.value().error()); }
+            }
+            return VolumeManager::NullResult();
+        });
+    };
+    return locked_write(start_lba, start_lba + nlbas - 1, nullptr /* data */, std::move(move_fn));
+}
+
 // Note: Metrics scrapping can happen at any point after volume instance is created and registered with metrics farm;
 void VolumeMetrics::on_gather() {}
 
@@ -15,11 +15,15 @@
  *********************************************************************************/
 #pragma once
 
+#include <array>
+#include <map>
+#include <set>
 #include <homeblks/volume_mgr.hpp>
 #include "sisl/utility/enum.hpp"
 #include <homestore/homestore.hpp>
 #include <homestore/index/index_table.hpp>
 #include <homestore/replication/repl_dev.h>
+#include <folly/futures/SharedPromise.h>
 
 #if USE_FIXED_INDEX
 #include "index_fixed_table.hpp"
@@ -28,6 +32,14 @@
 #endif
 
 #include "volume_chunk_selector.hpp"
+#include "inline_write_cache.hpp"
+#include "read_cache.hpp"
+#include "access_tracker.hpp"
+#include "dedup_index.hpp"
+#include "compression.hpp"
+#include "range_lock.hpp"
+#include "partial_page_merger.hpp"
+#include "l2_read_cache.hpp"
 #include "sisl/utility/atomic_counter.hpp"
 #include <homeblks/common.hpp>
 
@@ -41,17 +53,87 @@ using index_cfg_t = homestore::BtreeConfig;
 using read_blks_list_t = std::vector< std::pair< lba_t, homestore::MultiBlkId > >;
 struct vol_read_ctx {
     vol_interface_req_ptr vol_req;
-    uint32_t blk_size;
+    uint32_t page_size;
     index_kv_list_t index_kvs{};
+    std::vector< std::pair< lba_t, sisl::io_blob_safe > > inline_pages{};   // newer than what index maps;
+    std::vector< std::pair< lba_t, sisl::io_blob_safe > > inflight_pages{}; // of writes in flight, newer than inline;
+    uint64_t cache_gen{0};                                                // read cache generation before index lookup;
+    std::vector< std::pair< size_t, sisl::io_blob_safe > > compressed_pages{}; // index_kvs position, stored page;
+    std::vector< std::pair< lba_t, sisl::io_blob_safe > > l2_pages{};          // read from L2 cache, not data device;
 };
 
+// Pages of a write on a dedup volume which are not written, keyed by page offset in the write.
+struct vol_dedup_ctx {
+    std::vector< dedup_hash_t > hashes{};                    // content hash of each page;
+    std::unordered_map< lba_count_t, dedup_blk_t > cached{}; // same content as a blk found in dedup index;
+    std::unordered_map< lba_count_t, lba_count_t > dups{};   // same content as an earlier page of this write;
+    std::vector< homestore::BlkId > refs{};                  // references taken, dropped if the write fails;
+
+    bool is_written(lba_count_t offset) const { return !cached.contains(offset) && !dups.contains(offset); }
+};
+
+// Pages of a write on a compressed volume which are stored compressed, keyed by page offset in the write. The rest of
+// the pages are stored as is.
+struct vol_compress_ctx {
+    sisl::io_blob_safe buf{};                                                     // stored pages back to back;
+    std::unordered_map< lba_count_t, std::pair< uint32_t, uint32_t > > pages{}; // offset in buf, stored size;
+};
+
+// Lbas of a mirrored volume written to one copy only, the stale copy is resynced from the other one.
+struct mirror_dirty_range_t {
+    lba_t start_lba{0};
+    lba_t end_lba{0};
+    uint32_t stale_copy{0};
+};
+
+// Hands out the blks of each page in lba order from the blkids allocated for a write.
+class PageBlkIdIter {
+public:
+    explicit PageBlkIdIter(std::vector< homestore::MultiBlkId > const& blkids) : blkids_{blkids} {}
+
+    // Next nblks blks, invalid blkid if they would span two blkids.
+    homestore::BlkId next(homestore::blk_count_t nblks) {
+        if (idx_ >= blkids_.size() || used_ + nblks > blkids_[idx_].blk_count()) { return homestore::BlkId{}; }
+        DEBUG_ASSERT_EQ(blkids_[idx_].num_pieces(), 1, "Multiple blkid pieces");
+        auto blkid = homestore::BlkId{blkids_[idx_].blk_num() + used_, nblks, blkids_[idx_].chunk_num()};
+        used_ += nblks;
+        if (used_ == blkids_[idx_].blk_count()) {
+            ++idx_;
+            used_ = 0;
+        }
+        return blkid;
+    }
+
+private:
+    std::vector< homestore::MultiBlkId > const& blkids_;
+    size_t idx_{0};
+    homestore::blk_count_t used_{0};
+};
+
+// For volumes with dedup, lbas mapped to an existing blk are listed after old blkids in journal key, the rest of
+// the lbas are mapped to the new blkids written in order. For volumes with compression, number of blks stored for
+// each written page follow.
 struct VolJournalEntry {
     lba_t start_lba;
     lba_count_t nlbas;
     uint16_t num_old_blks;
+    uint16_t num_dedup_blks{0};
 };
 
-ENUM(MsgType, uint8_t, READ, WRITE, UNMAP);
+struct VolDedupEntry {
+    lba_count_t lba_offset; // offset from start_lba of the journal entry;
+    homestore::BlkId blkid;
+};
+
+// ATOMIC_WRITE key starts with the number of ranges, followed by a write entry per range.
+struct VolAtomicJournalEntry {
+    uint16_t num_ranges;
+};
+
+// INLINE_WRITE carries the data pages in the journal key, DESTAGE_WRITE is a regular write of destaged inline pages
+// which carries the max lsn of inline writes it covers in the header extension. ATOMIC_WRITE is a write of several
+// ranges committed together.
+ENUM(MsgType, uint8_t, READ, WRITE, UNMAP, INLINE_WRITE, DESTAGE_WRITE, ATOMIC_WRITE);
 struct MsgHeader {
     MsgHeader() = default;
     MsgType msg_type;
@@ -71,8 +153,49 @@ public:
         REGISTER_COUNTER(volume_write_size_total, "Total Volume data size written", "volume_data_size",
                          {"op", "write"});
         REGISTER_COUNTER(volume_read_size_total, "Total Volume data size read", "volume_data_size", {"op", "read"});
+        REGISTER_COUNTER(volume_scrub_size_total, "Total Volume data size verified by scrubber", "volume_data_size",
+                         {"op", "scrub"});
+        REGISTER_COUNTER(volume_scrub_crc_mismatch_count, "Total crc mismatches found by scrubber");
+        REGISTER_COUNTER(volume_scrub_pass_count, "Total full scrub passes completed on Volume");
+        REGISTER_COUNTER(volume_range_lock_wait_count, "Total writes waiting on an overlapping write in flight");
+        REGISTER_COUNTER(volume_group_commit_count, "Total batches of acked writes submitted to journal");
+        REGISTER_COUNTER(volume_fua_write_count, "Total FUA writes on volumes with write back ack");
+        REGISTER_COUNTER(volume_atomic_write_count, "Total Volume atomic multi range writes", "volume_op_count",
+                         {"op", "atomic_write"});
+        REGISTER_COUNTER(volume_inline_write_count, "Total Volume writes done inline in journal", "volume_op_count",
+                         {"op", "inline_write"});
+        REGISTER_COUNTER(volume_destage_size_total, "Total inline written data size destaged to data device",
+                         "volume_data_size", {"op", "destage"});
+        REGISTER_COUNTER(volume_inline_read_hit_count, "Total pages read served from inline writes pending destage");
+        REGISTER_COUNTER(volume_inflight_read_hit_count, "Total pages read served from data of writes in flight");
+        REGISTER_COUNTER(volume_read_cache_hit_count, "Total Volume reads served from read cache");
+        REGISTER_COUNTER(volume_read_cache_miss_count, "Total Volume reads missed in read cache");
+        REGISTER_COUNTER(volume_l2_cache_hit_count, "Total Volume pages read from L2 read cache");
+        REGISTER_COUNTER(volume_l2_cache_miss_count, "Total Volume pages missed in L2 read cache");
+        REGISTER_COUNTER(volume_read_ahead_size_total, "Total Volume read ahead size in bytes");
+        REGISTER_COUNTER(volume_write_back_fallback_count, "Total inline writes retried with regular write path");
+        REGISTER_COUNTER(volume_tier_promote_size_total, "Total data size promoted to fast tier", "volume_data_size",
+                         {"op", "promote"});
+        REGISTER_COUNTER(volume_clean_size_total, "Total data size moved out of chunks by cleaner", "volume_data_size",
+                         {"op", "clean"});
+        REGISTER_COUNTER(volume_compress_saved_size_total, "Total data size not written thanks to compression",
+                         "volume_data_size", {"op", "compress"});
+        REGISTER_COUNTER(volume_compress_bypass_count, "Total writes not compressed as recent data was incompressible");
+        REGISTER_COUNTER(volume_dedup_hit_count, "Total pages mapped to an existing blk with the same content");
+        REGISTER_COUNTER(volume_mirror_write_error_count, "Total mirrored volume writes failed on one copy");
+        REGISTER_COUNTER(volume_mirror_read_failover_count, "Total mirrored volume reads retried on the other copy");
+        REGISTER_COUNTER(volume_mirror_repair_count, "Total mirrored volume pages repaired from the other copy");
+        REGISTER_COUNTER(volume_mirror_resync_count, "Total mirrored volume pages resynced after a failed copy write");
+        REGISTER_COUNTER(volume_reclaimed_blk_count, "Total blks freed back from writes failed before index update");
+        REGISTER_COUNTER(volume_dedup_size_total,
+                         "Total data size not written thanks to dedup, dedup ratio is write size over write size less "
+                         "this",
+                         "volume_data_size", {"op", "dedup"});
         // gauges
         REGISTER_GAUGE(volume_data_used_size, "Total Volume data used size");
+        REGISTER_GAUGE(volume_fast_tier_size, "Volume data size resident in fast tier");
+        REGISTER_GAUGE(volume_hot_extent_count, "Number of Volume extents being tracked as read recently");
+        REGISTER_GAUGE(volume_dedup_shared_blk_count, "Number of Volume blks mapped by more than one lba");
         // histograms
         REGISTER_HISTOGRAM(volume_write_size_distribution, "Distribution of volume write sizes",
                            HistogramBucketsType(OpSizeBuckets));
@@ -92,6 +215,11 @@ public:
                            {"op", "write"}, HistogramBucketsType(OpLatecyBuckets));
         REGISTER_HISTOGRAM(volume_journal_write_latency, "Volume journal write latency", "volume_journal_op_latency",
                            {"op", "write"}, HistogramBucketsType(OpLatecyBuckets));
+        REGISTER_HISTOGRAM(volume_scrub_latency, "Volume scrub batch latency", HistogramBucketsType(OpLatecyBuckets));
+        REGISTER_HISTOGRAM(volume_write_ack_latency, "Volume write latency until acked in write back mode",
+                           HistogramBucketsType(OpLatecyBuckets));
+        REGISTER_HISTOGRAM(volume_group_commit_entries, "Number of acked writes submitted to journal per batch",
+                           HistogramBucketsType(ExponentialOfTwoBuckets));
 
         register_me_to_farm();
         attach_gather_cb(std::bind(&VolumeMetrics::on_gather, this));
@@ -111,9 +239,21 @@ public:
     inline static auto const VOL_META_NAME = std::string("Volume2"); // different from old releae;
 private:
     static constexpr uint64_t VOL_SB_MAGIC = 0xc01fadeb; // different from old release;
-    static constexpr uint64_t VOL_SB_VER = 0x3;          // bump one from old release
+    static constexpr uint64_t VOL_SB_VER = 0x4;          // bump one from old release
+    static constexpr uint64_t VOL_SB_VER_V3 = 0x3;       // superblks of this version are migrated on load;
     static constexpr uint64_t VOL_NAME_SIZE = 100;
-    static constexpr homestore::csum_t init_crc_16 = 0x8005;
+    static constexpr uint32_t SCRUB_PERSIST_INTERVAL = 16;  // persist scrub cursor once every these many batches;
+    static constexpr uint64_t MAX_DESTAGE_IO_SIZE = 1 * Mi; // same as volume sub io size;
+    static constexpr uint32_t DEDUP_SCAN_BATCH = 64 * Ki;   // index entries scanned at a time to recount refs;
+    static constexpr uint32_t COMPRESS_PROBE_INTERVAL = 16; // see bypass_compression();
+    static constexpr uint32_t MAX_READ_AHEAD_RANGES = 1024; // ranges advised SEQUENTIAL, more are ignored;
+    static constexpr uint32_t CLEAN_SCAN_BATCH = 4 * Ki;    // index entries scanned at a time by the cleaner;
+    static constexpr uint32_t CLEAN_MAX_SCAN = 256 * Ki;    // index entries scanned in one cleaner round;
+    static constexpr uint32_t CLEAN_MAX_RUN_PAGES = 256;    // pages moved by the cleaner in one read and write;
+    static constexpr uint32_t CLEAN_EXTENT_PAGES = 1024;    // lbas per extent in the cleaner's chunk reverse map;
+    static constexpr uint64_t OVERWRITE_DECAY = 64 * Ki;    // overwritten pages after which overwrite heat decays;
+    static constexpr uint32_t MIRROR_DIRTY_SLOTS = 16;      // ranges with a stale copy tracked in superblk;
+    static constexpr uint32_t MIRROR_RESYNC_PAGES = 256;    // pages copied to a stale copy in one read and write;
 
     struct vol_sb_t {
         uint64_t magic;
@@ -127,16 +267,39 @@ private:
         uint64_t ordinal; // Id unique to local homeblk instance.
         uint32_t pdev_id; // All chunks for this volume allocated from this physical dev.
         uint32_t num_chunks;
-        // List of chunk ids allocated for this volume are stored after this.
-
-        void init(uint32_t page_sz, uint64_t sz_bytes, volume_id_t vid, std::string const& name_str, uint64_t ord,
-                  uint32_t pdev, std::vector< homestore::chunk_num_t > const& chunk_ids) {
+        lba_t scrub_cursor{0}; // next lba to be verified by background scrubber;
+        vol_checksum_type checksum_type{vol_checksum_type::CRC16};
+        vol_tier_policy tier_policy{vol_tier_policy::AUTO};
+        bool dedup{false};
+        vol_compression_type compression_type{vol_compression_type::NONE};
+        bool write_back_ack{false};
+        bool shared_journal{false};
+        bool mirrored{false};
+        uint32_t mirror_pdev_id{0}; // pdev of the chunks holding the copies of a mirrored volume;
+        uint32_t sector_size{0};    // unit of lba in IO requests, same as page_size unless smaller;
+        uint32_t num_mirror_dirty{0};
+        mirror_dirty_range_t mirror_dirty[MIRROR_DIRTY_SLOTS]{}; // lbas with a stale copy, if mirrored;
+        // List of chunk ids allocated for this volume are stored after this, followed by as many mirror chunk ids if
+        // the volume is mirrored.
+
+        void init(uint32_t page_sz, uint32_t sector_sz, uint64_t sz_bytes, volume_id_t vid, std::string const& name_str,
+                  uint64_t ord, vol_checksum_type csum_type, vol_tier_policy tier, bool dedup_on,
+                  vol_compression_type compress_type, bool write_back, bool shared_jrnl, uint32_t pdev,
+                  std::vector< homestore::chunk_num_t > const& chunk_ids, uint32_t mirror_pdev,
+                  std::vector< homestore::chunk_num_t > const& mirror_chunk_ids) {
             magic = VOL_SB_MAGIC;
             version = VOL_SB_VER;
             page_size = page_sz;
+            sector_size = sector_sz;
             size = sz_bytes;
             id = vid;
             ordinal = ord;
+            checksum_type = csum_type;
+            tier_policy = tier;
+            dedup = dedup_on;
+            compression_type = compress_type;
+            write_back_ack = write_back;
+            shared_journal = shared_jrnl;
             // name will be truncated if input name is longer than VOL_NAME_SIZE;
             std::strncpy((char*)name, name_str.c_str(), VOL_NAME_SIZE - 1);
             name[VOL_NAME_SIZE - 1] = '\0';
@@ -149,6 +312,14 @@ private:
                 *chunk_id_ptr = chunk_id;
                 chunk_id_ptr++;
             }
+
+            mirrored = !mirror_chunk_ids.empty();
+            mirror_pdev_id = mirror_pdev;
+            num_mirror_dirty = 0;
+            for (auto& chunk_id : mirror_chunk_ids) {
+                *chunk_id_ptr = chunk_id;
+                chunk_id_ptr++;
+            }
         }
 
         homestore::chunk_num_t* get_chunk_ids_mutable() {
@@ -158,6 +329,29 @@ private:
         const homestore::chunk_num_t* get_chunk_ids() const {
             return r_cast< const homestore::chunk_num_t* >(reinterpret_cast< const uint8_t* >(this) + sizeof(vol_sb_t));
         }
+
+        const homestore::chunk_num_t* get_mirror_chunk_ids() const { return get_chunk_ids() + num_chunks; }
+    };
+
+    // Layout of version 0x3 superblks. Fields up to num_chunks are laid out the same in later versions.
+    struct vol_sb_v3_t {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t num_streams;
+        uint32_t page_size;
+        uint64_t size;
+        volume_id_t id;
+        char name[VOL_NAME_SIZE];
+        vol_state state;
+        uint64_t ordinal;
+        uint32_t pdev_id;
+        uint32_t num_chunks;
+        // List of chunk ids allocated for this volume are stored after this.
+
+        const homestore::chunk_num_t* get_chunk_ids() const {
+            return r_cast< const homestore::chunk_num_t* >(reinterpret_cast< const uint8_t* >(this) +
+                                                           sizeof(vol_sb_v3_t));
+        }
     };
 
 public:
@@ -165,7 +359,16 @@ public:
                     shared< VolumeChunkSelector > index_chunk_sel) :
             sb_{VOL_META_NAME}, volume_chunk_selector_{vol_chunk_sel}, index_chunk_selector_{index_chunk_sel} {
         vol_info_ = std::make_shared< VolumeInfo >(info.id, info.size_bytes, info.page_size, info.name, info.ordinal);
+        vol_info_->checksum_type = info.checksum_type;
+        vol_info_->tier_policy = info.tier_policy;
+        vol_info_->dedup = info.dedup;
+        vol_info_->compression_type = info.compression_type;
+        vol_info_->write_back_ack = info.write_back_ack;
+        vol_info_->shared_journal = info.shared_journal;
+        vol_info_->mirrored = info.mirrored;
+        vol_info_->sector_size = info.sector_size;
         metrics_ = std::make_unique< VolumeMetrics >(vol_info_->name);
+        inline_cache_ = std::make_unique< InlineWriteCache >(vol_info_->page_size);
     }
     explicit Volume(sisl::byte_view const& buf, void* cookie, shared< VolumeChunkSelector > vol_chunk_sel,
                     shared< VolumeChunkSelector > index_chunk_sel);
@@ -202,8 +405,21 @@ public:
     uint64_t ordinal() const { return vol_info_->ordinal; }
     std::string id_str() const { return boost::uuids::to_string(vol_info_->id); };
     ReplDevPtr rd() const { return rd_; }
+    // Journal records of writes go to the group journal shared by volumes with shared_journal, to their own otherwise.
+    ReplDevPtr journal_rd() const { return journal_rd_ ? journal_rd_ : rd_; }
+    void set_journal_rd(ReplDevPtr journal_rd) { journal_rd_ = std::move(journal_rd); }
+    bool shared_journal() const { return vol_info_->shared_journal; }
+    bool mirrored() const { return vol_info_->mirrored; }
+    // False if the superblk is of a version this release can't read, the volume is kept offline then.
+    bool sb_supported() const { return sb_supported_; }
+    uint32_t sector_size() const { return vol_info_->sector_size; }
 
     VolumeInfoPtr info() const { return vol_info_; }
+    vol_checksum_type checksum_type() const { return vol_info_->checksum_type; }
+    vol_compression_type compression_type() const { return vol_info_->compression_type; }
+    // lba is in unit of page, each page is mapped to blks_per_page contiguous data blks, fewer if stored compressed;
+    uint32_t blks_per_page() const { return uint32_cast(vol_info_->page_size / rd()->get_blk_size()); }
+    bool is_compressed(homestore::BlkId const& blkid) const { return blkid.blk_count() < blks_per_page(); }
 
     std::string to_string() { return vol_info_->to_string(); }
 
@@ -233,11 +449,134 @@ public:
 
     VolumeManager::NullAsyncResult write(const vol_interface_req_ptr& vol_req);
 
+    // Run write_fn once [start_lba, end_lba] is no longer locked by an earlier overlapping write, the range is kept
+    // locked until the write completes. Reads of the range are served data, if given, until then.
+    VolumeManager::NullAsyncResult locked_write(lba_t start_lba, lba_t end_lba, uint8_t const* data,
+                                                folly::Function< VolumeManager::NullAsyncResult() >&& write_fn);
+
+    //
+    // Submit journal entries of all the writes acked in write back mode so far, and complete once they are committed.
+    // Fails if any write acked since the last flush failed to be journaled.
+    //
+    VolumeManager::NullAsyncResult flush();
+
+    // Submit journal entries of writes acked in write back mode as one batch, called by the group commit timer.
+    void submit_journal_writes();
+    bool write_back_ack() const { return vol_info_->write_back_ack; }
+
+    // Write several non overlapping ranges, sorted by lba, with a single journal entry. Not supported with dedup or
+    // compression.
+    VolumeManager::NullAsyncResult atomic_write(std::vector< vol_interface_req_ptr > reqs);
+
+    //
+    // Write the data pages inline in the journal entry, the write is acked after the log flush. Pages are kept in
+    // inline cache and destaged to data device and index in background.
+    //
+    VolumeManager::NullAsyncResult write_inline(const vol_interface_req_ptr& vol_req);
+
+    //
+    // Destage at most max_pages inline written pages in lba order with a few large writes. Only one destage round is in
+    // flight per volume, if there is one already, its result is returned. Returns false if any of the writes failed.
+    //
+    folly::Future< bool > destage(uint32_t max_pages);
+
+    // Destage all the inline written pages pending now, pages written after this call are not waited for.
+    folly::Future< bool > flush_inline_writes();
+
+    InlineWriteCache* inline_cache() const { return inline_cache_.get(); }
+
+    // Set once an inline write fails to be journaled, writes go through the regular path from then on.
+    bool inline_write_degraded() const { return inline_write_degraded_.load(); }
+
+    //
+    // Lbas of a mirrored volume written to one copy only are kept in superblk until the stale copy is resynced from
+    // the other one. Resync copies one range per call, under the range lock, and takes it out of superblk once done.
+    // Only one resync is allowed per volume at a time.
+    //
+    uint32_t num_mirror_dirty_ranges();
+    VolumeManager::NullAsyncResult resync_mirror();
+    // Pages of a mirrored volume which failed checksum on one copy and were rewritten from the other one.
+    uint64_t mirror_repaired_pages() const { return mirror_repaired_pages_.load(); }
+
+    // Cache recently read pages in memory, enabled by default for volumes on HDD data device.
+    void enable_read_cache(uint64_t capacity_bytes);
+    ReadCache* read_cache() const { return read_cache_.get(); }
+
+    // Partial page writes being merged, null unless sectors are smaller than pages.
+    PartialPageMerger* partial_pages() const { return partial_pages_.get(); }
+
+    vol_tier_policy tier_policy() const { return vol_info_->tier_policy; }
+    AccessTracker* access_tracker() const { return access_tracker_.get(); }
+    void record_read(lba_t start_lba, lba_count_t nlbas) {
+        if (access_tracker_) { access_tracker_->record(start_lba, nlbas); }
+    }
+
+    //
+    // Read the hottest extents not resident in fast tier, at most max_bytes, through the regular read path which fills
+    // the read cache with them. Heat of all extents is decayed afterwards. Returns the size of data promoted.
+    //
+    VolumeManager::AsyncResult< uint64_t > promote_hot_extents(uint64_t max_bytes);
+
+    // Hottest extents read lately, at most max_bytes, persisted at graceful shutdown to be warmed up after restart.
+    std::vector< std::pair< lba_t, lba_count_t > > hot_extents(uint64_t max_bytes);
+
+    //
+    // Bring the index nodes mapping the range, and its pages if there is a read cache to hold them, in ahead of the
+    // reads to come, for warmup after restart, application advice and read ahead.
+    //
+    VolumeManager::NullAsyncResult prefetch(lba_t start_lba, lba_count_t nlbas);
+
+    // Drop pages in [start_lba, end_lba] from read caches.
+    void drop_cached(lba_t start_lba, lba_t end_lba);
+
+    // Turn read ahead on or off for reads in [start_lba, end_lba], it is off by default.
+    void set_read_ahead(lba_t start_lba, lba_t end_lba, bool on);
+
+    // Prefetch what follows a read in a range with read ahead on, once the reads get close to what is prefetched.
+    void read_ahead(lba_t start_lba, lba_count_t nlbas);
+
+    DedupIndex* dedup_index() const { return dedup_index_.get(); }
+
+    //
+    // References on blks shared by several lbas are not persisted, recount them by a full scan of index. Called in
+    // recovery after log replay, before volume takes any IO.
+    //
+    VolumeManager::NullResult rebuild_dedup_refs();
+
+    //
+    // Map [start_lba, end_lba] to new blkids in blocks_info, which are not necessarily contiguous with dedup. Index is
+    // written with one range put per run of contiguous blkids. Old blkids are collected in blocks_info, lbas which had
+    // one are counted as overwritten unless track_overwrites is false.
+    //
     VolumeManager::Result< folly::Unit > write_to_index(lba_t start_lba, lba_t end_lba,
-                                                        std::unordered_map< lba_t, BlockInfo >& blocks_info);
+                                                        std::unordered_map< lba_t, BlockInfo >& blocks_info,
+                                                        bool track_overwrites = true);
+
+    // Whether [start_lba, start_lba + nlbas) is in an extent overwritten often lately, blks of which are kept apart.
+    bool is_hot(lba_t start_lba, lba_count_t nlbas) const;
 
     VolumeManager::NullAsyncResult read(const vol_interface_req_ptr& req);
 
+    //
+    // Verify up to max_bytes of mapped data starting from the persisted scrub cursor against checksums stored in
+    // index. Contiguous blocks are read with merged IOs. Returns the next cursor, which wraps to 0 once a full pass
+    // over the volume is done. Both copies of a mirrored volume are verified, a bad copy is repaired from the good one.
+    // Confirmed checksum mismatches left are reported through fault containment.
+    //
+    VolumeManager::AsyncResult< lba_t > scrub(uint64_t max_bytes);
+    lba_t scrub_cursor() const { return sb_->scrub_cursor; }
+
+    // Allocate blks in one chunk at a time, set for volumes on HDD data device with log_structured_on.
+    void enable_log_structured();
+    bool log_structured() const { return log_structured_.load(); }
+
+    //
+    // Move up to max_bytes of live data out of the chunk picked by the cleaner through the regular read and write
+    // paths, so that it is appended to again once empty. Only the extents of lbas written into the chunk are scanned in
+    // index, a chunk is cleaned over as many rounds as that takes. Returns the size of data moved.
+    //
+    VolumeManager::AsyncResult< uint64_t > clean(uint64_t max_bytes);
+
     //
     // if destroy_started_ is true, it means volume destroy has started and we should not call remove again;
     // if outstanding_reqs_ is not zero, it means there are still requests outstanding and we should not call remove;
@@ -251,6 +590,13 @@ public:
     void update_vol_sb_cb(const std::vector< chunk_num_t >& chunk_ids);
 
 private:
+    // Rewrite a version 0x3 superblk loaded in the current layout.
+    void migrate_v3_sb();
+#ifdef _PRERELEASE
+    // For testing purpose only, persist the superblk in version 0x3 layout, the one in memory is left as is.
+    void write_v3_sb();
+#endif
+
     //
     // this API will be called to initialize volume in both volume creation and volume recovery;
     // it also creates repl dev underlying the volume which provides read/write apis to the volume;
@@ -260,17 +606,92 @@ private:
     bool init(bool is_recovery);
 
     VolumeManager::NullResult verify_checksum(vol_read_ctx const& read_ctx);
+    VolumeManager::NullResult decompress_pages(vol_read_ctx const& read_ctx);
+    // Copy pages of inline writes pending destage and then pages of writes in flight over what is read.
+    void apply_inline_pages(vol_read_ctx const& read_ctx);
+    bool pending_pages_cover(vol_read_ctx const& read_ctx) const;
+    void fill_read_cache(vol_read_ctx const& read_ctx);
+
+    // L2 read cache of the volume, null if there is none or pages read from it can't be verified.
+    L2ReadCache* l2_cache() const;
+    // Read the pages mapped by index which are in L2 read cache on a worker pool, the result is completed on a reactor.
+    folly::Future< vol_read_ctx > read_l2_cache(vol_read_ctx&& read_ctx);
+    // Read the pages mapped by index and not read from L2 read cache from data device and verify them.
+    VolumeManager::NullAsyncResult read_data(vol_read_ctx&& read_ctx);
+
+    // regular write path, allocates blks, writes data and maps them in index. destage_lsn is set when it is destaging
+    // inline written pages, to the max lsn of the inline writes being destaged;
+    VolumeManager::NullAsyncResult write_data(const vol_interface_req_ptr& vol_req, int64_t destage_lsn = -1);
+    VolumeManager::NullAsyncResult write_pages(const vol_interface_req_ptr& vol_req, int64_t destage_lsn,
+                                               vol_dedup_ctx&& dedup, vol_compress_ctx&& compress);
+
+    // Compress the pages to be written on a worker pool, the result is completed on a reactor.
+    folly::Future< vol_compress_ctx > compress_pages(const vol_interface_req_ptr& vol_req, vol_dedup_ctx const& dedup);
+    bool bypass_compression();
+
+    folly::Future< bool > flush_inline_writes_upto(uint64_t seq);
+
+    // Queue the journal entry of a write acked in write back mode, returns when it is committed.
+    VolumeManager::NullAsyncResult queue_journal_write(folly::Function< void() >&& submit,
+                                                       VolumeManager::NullAsyncResult&& committed);
+    void on_group_committed(uint64_t seq, bool failed);
+
+    void lookup_dedup(const vol_interface_req_ptr& vol_req, vol_dedup_ctx& dedup);
+    void release_dedup_refs(std::vector< homestore::BlkId > const& blkids);
+    void record_overwrites(lba_t start_lba, lba_t end_lba, std::unordered_map< lba_t, BlockInfo >& blocks_info);
+    void record_chunk_extents(lba_t start_lba, lba_t end_lba, chunk_num_t chunk);
+    // Scan up to CLEAN_MAX_SCAN index entries to build chunk_extents_, returns true once it is built.
+    VolumeManager::Result< bool > build_chunk_extents();
+    // Free blks allocated for a write which failed before they were mapped in index.
+    void release_uncommitted_blks(std::vector< homestore::MultiBlkId > const& blkids);
 
     void submit_read_to_backend(read_blks_list_t const& blks_to_read, const vol_interface_req_ptr& req,
                                 std::vector< folly::Future< std::error_code > >& futs);
 
-    void generate_blkids_to_read(const index_kv_list_t& index_kvs, read_blks_list_t& blks_to_read);
+    void generate_blkids_to_read(const index_kv_list_t& index_kvs, read_blks_list_t& blks_to_read,
+                                 bool skip_compressed = false);
+
+    // mirror_buf, if given, has the mirror copy of what is in buf.
+    VolumeManager::AsyncResult< lba_t > verify_scrubbed_blks(index_kv_list_t const& index_kvs, uint8_t const* buf,
+                                                             uint8_t const* mirror_buf, lba_t next_cursor);
+    void persist_scrub_cursor(lba_t next_cursor);
+    // Rewrite the lbas of [start_lba, start_lba + nlbas) still mapped into chunk, under the range lock.
+    VolumeManager::NullAsyncResult relocate(lba_t start_lba, lba_count_t nlbas, chunk_num_t chunk);
+
+    // Copy of blkid on a mirrored volume, same blks of the chunk paired with blkid's on the mirror pdev.
+    homestore::MultiBlkId mirror_blkid(homestore::MultiBlkId const& blkid) const;
+    // Write data blks of [start_lba, end_lba], on a mirrored volume to both copies. Succeeds if any of the copies is
+    // written, the lbas are marked dirty then until the copy failing to be written is resynced.
+    folly::Future< std::error_code > write_blks(std::vector< homestore::MultiBlkId > const& blkids,
+                                                sisl::sg_list const& sgs, bool part_of_batch, lba_t start_lba,
+                                                lba_t end_lba);
+    folly::Future< std::error_code > write_copy(std::vector< homestore::MultiBlkId > const& blkids, uint32_t copy,
+                                                sisl::sg_list const& sgs, bool part_of_batch);
+    void mark_mirror_dirty(lba_t start_lba, lba_t end_lba, uint32_t stale_copy);
+    VolumeManager::NullAsyncResult resync_range(mirror_dirty_range_t const& range, lba_t start_lba);
+    VolumeManager::NullAsyncResult resync_pages(lba_t start_lba, lba_t end_lba, uint32_t stale_copy);
+    // Read data blks, on a mirrored volume from the copy with fewer reads in flight, the other copy if that fails.
+    folly::Future< std::error_code > read_blks(homestore::MultiBlkId const& blkid, sisl::sg_list const& sgs,
+                                               bool part_of_batch);
+    folly::Future< std::error_code > read_copy(homestore::MultiBlkId const& blkid, uint32_t copy,
+                                               sisl::sg_list const& sgs, bool part_of_batch);
+    //
+    // Read the page mapped by lba from both copies of a mirrored volume, copy a good one to buf, if given, and rewrite
+    // the other one with it if it failed checksum and lba is still mapped to the same blk. Returns false if no copy
+    // passes checksum.
+    //
+    folly::Future< bool > repair_page(lba_t lba, VolumeIndexValue const& value, uint8_t* buf);
+    folly::Future< bool > repair_pages(vol_read_ctx const& read_ctx);
 
     VolumeManager::NullResult read_from_index(const vol_interface_req_ptr& req, index_kv_list_t& index_kvs);
 
+    // Start tracking read frequency of extents, for tiering or warmup.
+    void track_access();
+
 private:
     VolumeInfoPtr vol_info_;  // volume info
     ReplDevPtr rd_;           // replication device for this volume, which provides read/write APIs to the volume;
+    ReplDevPtr journal_rd_;   // group journal if the volume has shared_journal;
     VolIdxTablePtr indx_tbl_; // index table for this volume
     superblk< vol_sb_t > sb_; // meta data of the volume
     shared< VolumeChunkSelector > volume_chunk_selector_; // volume chunk selector.
@@ -281,6 +702,61 @@ private:
         false}; // indicates if volume destroy has started, avoid destroy to be executed more than once.
     std::atomic< vol_state > m_state_; // in-memory sb state, avoid taking lock in IO path;
     std::unique_ptr< VolumeMetrics > metrics_;
+    bool sb_supported_{true};
+
+    std::mutex sb_lock_;                         // serializes sb resize with scrub cursor and mirror dirty updates;
+    std::atomic< bool > scrub_in_progress_{false}; // only one scrub batch is allowed per volume at a time;
+    uint32_t scrub_batches_since_persist_{0};
+
+    std::atomic< bool > log_structured_{false};
+    std::atomic< bool > clean_in_progress_{false}; // only one cleaner round is allowed per volume at a time;
+    std::optional< chunk_num_t > clean_chunk_;     // chunk being cleaned over several rounds;
+    std::vector< uint64_t > clean_extents_;        // extents to scan for the chunk being cleaned, in lba order;
+    size_t clean_extent_idx_{0};                   // extent being scanned for the chunk being cleaned;
+    lba_t clean_cursor_{0};                        // next lba to scan for the chunk being cleaned;
+
+    // Coarse reverse map for the cleaner, extents with lbas written into each chunk. Extents are not taken out when
+    // their lbas are overwritten elsewhere, only when the chunk is picked for cleaning. It is built by one scan of the
+    // whole index for all chunks after log structured allocation is enabled, and kept up to date by index updates.
+    std::mutex chunk_extents_mtx_;
+    std::unordered_map< chunk_num_t, std::set< uint64_t > > chunk_extents_;
+    bool chunk_extents_built_{false};
+    lba_t chunk_extents_cursor_{0}; // next lba to scan to build chunk_extents_;
+
+    std::unique_ptr< InlineWriteCache > inline_cache_; // inline written pages pending destage;
+    std::mutex destage_mtx_;
+    std::shared_ptr< folly::SharedPromise< bool > > destage_promise_; // set when a destage round is in flight;
+    std::atomic< bool > inline_write_degraded_{false};
+    std::unique_ptr< ReadCache > read_cache_;          // null if read cache is not enabled;
+    std::unique_ptr< AccessTracker > access_tracker_;  // null if neither tiering nor warmup is enabled;
+    std::unique_ptr< AccessTracker > overwrite_heat_;  // null if hot/cold separation is disabled;
+    std::atomic< uint64_t > overwrites_since_decay_{0};
+    std::unique_ptr< DedupIndex > dedup_index_;        // null if dedup is not enabled;
+    std::atomic< uint32_t > incompressible_writes_{0}; // recent writes in a row with nothing worth compressing;
+    RangeLock range_lock_;                             // ranges written, from blk allocation until commit;
+
+    std::unordered_map< chunk_num_t, chunk_num_t > mirror_chunks_; // chunk -> chunk holding its copy, if mirrored;
+    std::array< std::atomic< uint32_t >, 2 > inflight_reads_{};    // reads in flight per copy, if mirrored;
+    std::atomic< bool > resync_in_progress_{false};                // only one resync is allowed at a time;
+    uint64_t mirror_dirty_gen_{0};                                 // bumped on every lbas marked dirty, under sb_lock_;
+    std::atomic< uint64_t > mirror_repaired_pages_{0};
+    std::unique_ptr< PartialPageMerger > partial_pages_;           // null unless sectors are smaller than pages;
+
+    struct read_ahead_range_t {
+        lba_t end_lba;
+        lba_t next_lba; // prefetched up to here;
+    };
+    std::mutex read_ahead_mtx_;
+    std::map< lba_t, read_ahead_range_t > read_ahead_ranges_; // start lba -> range advised SEQUENTIAL;
+
+    std::mutex journal_submit_mtx_; // one batch of acked writes is submitted to journal at a time;
+    std::mutex group_commit_mtx_;
+    std::vector< folly::Function< void() > > pending_journal_writes_; // acked writes not submitted to journal yet;
+    std::set< uint64_t > uncommitted_seqs_;                           // acked writes not committed yet;
+    // flushes waiting for commit, keyed by the last acked write they wait for;
+    std::multimap< uint64_t, folly::Promise< VolumeManager::NullResult > > flush_waiters_;
+    uint64_t group_commit_seq_{0};
+    bool group_commit_failed_{false}; // an acked write failed to be journaled since the last flush;
 };
 
 struct vol_repl_ctx : public homestore::repl_req_ctx {
@@ -18,6 +18,11 @@
 
 namespace homeblocks {
 
+static uint64_t steady_secs() {
+    return std::chrono::duration_cast< std::chrono::seconds >(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
 VolumeChunkSelector::VolumeChunkSelector(std::string module, UpdateVolSbCb update_sb_cb) :
         m_update_vol_sb_cb(update_sb_cb), m_module_name(module) {
     m_volume_chunks.resize(MAX_NUM_VOLUMES);
@@ -99,11 +104,45 @@ std::vector< chunk_num_t > VolumeChunkSelector::allocate_init_chunks(uint64_t vo
     return chunk_ids;
 }
 
+std::vector< chunk_num_t > VolumeChunkSelector::allocate_mirror_chunks(uint64_t volume_ordinal, uint32_t& pdev_id) {
+    std::lock_guard lock(m_chunk_sel_mutex);
+    auto volc = m_volume_chunks[volume_ordinal];
+    RELEASE_ASSERT(volc, "Volume doesnt exists");
+    RELEASE_ASSERT_EQ(volc->num_active_chunks.load(), volc->max_num_chunks, "Mirrored volume chunks not all allocated");
+    for (auto& [pdev, pdev_chunks] : m_per_dev_chunks) {
+        // Copies have to survive the loss of the volume's pdev.
+        if (pdev == volc->pdev || pdev_chunks.size() < volc->max_num_chunks) { continue; }
+
+        std::string str;
+        std::vector< chunk_num_t > chunk_ids;
+        auto iter = pdev_chunks.begin();
+        for (uint64_t i = 0; i < volc->max_num_chunks; i++) {
+            auto chunk = iter->second;
+            RELEASE_ASSERT_EQ(chunk->get_total_blks(), volc->m_chunks[i]->get_total_blks(), "Chunk size mismatch");
+            chunk->m_vol_ordinal = volume_ordinal;
+            chunk_ids.emplace_back(chunk->get_chunk_id());
+            volc->m_mirror_chunks.emplace_back(chunk);
+            iter = pdev_chunks.erase(iter);
+            fmt::format_to(std::back_inserter(str), "{} ", chunk->get_chunk_id());
+        }
+        volc->mirror_pdev = pdev;
+        pdev_id = pdev;
+        LOGI("Allocating mirror module={} num_chunks={} for volume={} pdev={} chunks={}", m_module_name,
+             chunk_ids.size(), volume_ordinal, pdev, str);
+        return chunk_ids;
+    }
+
+    LOGE("No pdev other than {} has {} free chunks to mirror volume={}", volc->pdev, volc->max_num_chunks,
+         volume_ordinal);
+    return {};
+}
+
 homestore::cshared< Chunk > VolumeChunkSelector::select_chunk(homestore::blk_count_t nblks,
                                                               const homestore::blk_alloc_hints& hints) {
 
     if (!hints.application_hint) { return nullptr; }
-    uint64_t volume_ordinal = hints.application_hint.value();
+    uint64_t volume_ordinal = hints.application_hint.value() & ~HOT_ALLOC_HINT;
+    bool const hot = hints.application_hint.value() & HOT_ALLOC_HINT;
 
     // We dont take lock on volumes vector and volume chunks vector
     // as they precreated and never changed
@@ -135,16 +174,31 @@ homestore::cshared< Chunk > VolumeChunkSelector::select_chunk(homestore::blk_cou
             resize_volume_num_chunks(nblks, volc);
         }
 
+        if (hot) {
+            if (auto chunk = select_hot_chunk(volc); chunk) { return chunk->get_internal_chunk(); }
+        }
+        if (volc->log_structured) {
+            if (auto chunk = select_append_chunk(volc); chunk) { return chunk->get_internal_chunk(); }
+        }
+
         // This is the fastpath where we try to allocate the blks from the active chunks.
         // Traverse through active chunks in the vector and find the first chunk
         // which has some available blks. It may not satisfy all the nblks, in that case
-        // virtual_dev will call select_chunk again.
-        uint64_t num_active_chunks = volc->num_active_chunks;
+        // virtual_dev will call select_chunk again. Cold blks skip the hot chunk.
+        uint64_t num_active_chunks = volc->log_structured ? 0 : volc->num_active_chunks.load();
+        auto const hot_index = volc->hot_chunk_index.load();
         for (uint64_t i = 0; i < num_active_chunks; i++) {
             if (*volc->m_next_chunk_index >= num_active_chunks) { *volc->m_next_chunk_index = 0; }
 
-            auto chunk = volc->m_chunks[*volc->m_next_chunk_index];
-            *volc->m_next_chunk_index = ((*volc->m_next_chunk_index) + 1);
+            auto const index = *volc->m_next_chunk_index;
+            auto chunk = volc->m_chunks[index];
+            *volc->m_next_chunk_index = index + 1;
+            if (index != hot_index && chunk && chunk->available_blks() > 0) { return chunk->get_internal_chunk(); }
+        }
+
+        // Hot chunk is the only one left with free blks.
+        if (hot_index != INVALID_CHUNK_INDEX) {
+            auto chunk = volc->m_chunks[hot_index];
             if (chunk && chunk->available_blks() > 0) { return chunk->get_internal_chunk(); }
         }
 
@@ -157,6 +211,108 @@ homestore::cshared< Chunk > VolumeChunkSelector::select_chunk(homestore::blk_cou
     return {};
 }
 
+shared< VolumeChunkSelector::HBChunk >
+VolumeChunkSelector::select_append_chunk(shared< VolumeChunksInfo > const& volc) {
+    auto chunk = volc->m_chunks[volc->append_chunk_index];
+    if (chunk && chunk->available_blks() > 0) { return chunk; }
+
+    // Appends move to the active chunk with the most free blks once the current one is full, which is usually one the
+    // cleaner emptied.
+    std::lock_guard lock(volc->append_mtx);
+    chunk = volc->m_chunks[volc->append_chunk_index];
+    if (chunk && chunk->available_blks() > 0) { return chunk; }
+
+    uint64_t next_index{0};
+    auto next = next_chunk(volc, volc->hot_chunk_index, next_index);
+    if (!next) { return nullptr; }
+
+    if (chunk) { chunk->m_sealed_secs = steady_secs(); }
+    volc->append_chunk_index = next_index;
+    LOGD("Volume={} appends moved to chunk={} available={}", volc->ordinal, next->get_chunk_id(),
+         next->available_blks());
+    return next;
+}
+
+shared< VolumeChunkSelector::HBChunk > VolumeChunkSelector::select_hot_chunk(shared< VolumeChunksInfo > const& volc) {
+    // Nothing to keep hot blks apart from.
+    if (volc->num_active_chunks.load() < 2) { return nullptr; }
+
+    auto index = volc->hot_chunk_index.load();
+    auto chunk = (index != INVALID_CHUNK_INDEX) ? volc->m_chunks[index] : nullptr;
+    if (chunk && chunk->available_blks() > 0) { return chunk; }
+
+    std::lock_guard lock(volc->append_mtx);
+    index = volc->hot_chunk_index.load();
+    chunk = (index != INVALID_CHUNK_INDEX) ? volc->m_chunks[index] : nullptr;
+    if (chunk && chunk->available_blks() > 0) { return chunk; }
+
+    uint64_t next_index{0};
+    auto const excluded_index = volc->log_structured ? volc->append_chunk_index.load() : INVALID_CHUNK_INDEX;
+    auto next = next_chunk(volc, excluded_index, next_index);
+    if (!next) { return nullptr; }
+
+    if (chunk) { chunk->m_sealed_secs = steady_secs(); }
+    volc->hot_chunk_index = next_index;
+    LOGD("Volume={} hot blks moved to chunk={} available={}", volc->ordinal, next->get_chunk_id(),
+         next->available_blks());
+    return next;
+}
+
+shared< VolumeChunkSelector::HBChunk >
+VolumeChunkSelector::next_chunk(shared< VolumeChunksInfo > const& volc, uint64_t excluded_index, uint64_t& index) {
+    shared< HBChunk > next;
+    for (uint64_t i = 0; i < volc->num_active_chunks.load(); i++) {
+        auto const& c = volc->m_chunks[i];
+        if (i == excluded_index || !c || c->available_blks() == 0) { continue; }
+        if (!next || c->available_blks() > next->available_blks()) {
+            next = c;
+            index = i;
+        }
+    }
+    return next;
+}
+
+void VolumeChunkSelector::set_log_structured(uint64_t volume_ordinal) {
+    auto volc = m_volume_chunks[volume_ordinal];
+    RELEASE_ASSERT(volc, "Volume doesnt exists");
+    // Appends start in the first chunk, which can't be the hot one.
+    std::lock_guard lock(volc->append_mtx);
+    if (volc->hot_chunk_index == volc->append_chunk_index) { volc->hot_chunk_index = INVALID_CHUNK_INDEX; }
+    volc->log_structured = true;
+    LOGI("Log structured allocation for module={} volume={}", m_module_name, volume_ordinal);
+}
+
+std::optional< chunk_num_t > VolumeChunkSelector::select_victim_chunk(uint64_t volume_ordinal, uint32_t max_live_pct) {
+    auto volc = m_volume_chunks[volume_ordinal];
+    if (!volc || !volc->log_structured) { return std::nullopt; }
+
+    auto const now = steady_secs();
+    auto const append_index = volc->append_chunk_index.load();
+    auto const hot_index = volc->hot_chunk_index.load();
+    std::optional< chunk_num_t > victim;
+    double best_score{0};
+    for (uint64_t i = 0; i < volc->num_active_chunks.load(); i++) {
+        auto const& chunk = volc->m_chunks[i];
+        if (!chunk || i == append_index || i == hot_index) { continue; }
+        auto const total = chunk->get_total_blks();
+        auto const live = total - chunk->available_blks();
+        if (live == 0 || static_cast< uint64_t >(live) * 100 > static_cast< uint64_t >(total) * max_live_pct) {
+            continue;
+        }
+
+        // Free space gained per blk read and rewritten, (1 - u) / (1 + u), chunks long stable first as their live data
+        // is less likely to be overwritten soon anyway.
+        auto const u = static_cast< double >(live) / total;
+        auto const age = now - std::min(now, chunk->m_sealed_secs.load()) + 1;
+        auto const score = (1 - u) * age / (1 + u);
+        if (score > best_score) {
+            best_score = score;
+            victim = chunk->get_chunk_id();
+        }
+    }
+    return victim;
+}
+
 void VolumeChunkSelector::resize_volume_num_chunks(homestore::blk_count_t nblks, shared< VolumeChunksInfo > volc) {
     auto idle = ResizeOp::Idle, inprogress = ResizeOp::InProgress;
     auto status = resize_op.compare_exchange_strong(idle, inprogress);
@@ -306,6 +462,34 @@ bool VolumeChunkSelector::recover_chunks(uint64_t volume_ordinal, uint32_t pdev,
     return true;
 }
 
+bool VolumeChunkSelector::recover_mirror_chunks(uint64_t volume_ordinal, uint32_t pdev,
+                                                const std::vector< chunk_num_t >& chunk_ids) {
+    std::lock_guard lock(m_chunk_sel_mutex);
+    auto volc = m_volume_chunks[volume_ordinal];
+    RELEASE_ASSERT(volc, "Volume doesnt exists");
+    RELEASE_ASSERT_EQ(chunk_ids.size(), volc->num_active_chunks.load(), "Mirror chunks not paired with volume chunks");
+
+    volc->mirror_pdev = pdev;
+    for (auto& chunk_id : chunk_ids) {
+        auto chunk = m_all_chunks[chunk_id];
+        if (!chunk) {
+            LOGE("Mirror chunk not found vol={} chunk_id={}", volume_ordinal, chunk_id);
+            return false;
+        }
+        RELEASE_ASSERT(chunk->m_vol_ordinal == INVALID_VOL_ORDINAL, "Chunk assigned to volume {}",
+                       chunk->m_vol_ordinal);
+        RELEASE_ASSERT(chunk->get_pdev_id() == pdev, "Invalid pdev for mirror chunk");
+        chunk->m_vol_ordinal = volume_ordinal;
+        volc->m_mirror_chunks.emplace_back(chunk);
+
+        auto res = m_per_dev_chunks[pdev].erase(chunk_id);
+        RELEASE_ASSERT(res == 1, "Chunk not found {}", chunk_id);
+    }
+
+    LOGI("Recovered mirror of volume={} pdev={} num_chunks={}", volume_ordinal, pdev, chunk_ids.size());
+    return true;
+}
+
 void VolumeChunkSelector::release_chunks(uint64_t volume_ordinal) {
     // Release the active chunks back to the per device chunk pool.
     std::lock_guard lock(m_chunk_sel_mutex);
@@ -322,6 +506,12 @@ void VolumeChunkSelector::release_chunks(uint64_t volume_ordinal) {
             count++;
         }
     }
+    for (auto chunk : volc->m_mirror_chunks) {
+        chunk->m_vol_ordinal = INVALID_VOL_ORDINAL;
+        m_per_dev_chunks[chunk->get_pdev_id()].emplace(chunk->get_chunk_id(), chunk);
+        fmt::format_to(std::back_inserter(str), "{} ", chunk->get_chunk_id());
+        count++;
+    }
 
     m_volume_chunks[volume_ordinal] = nullptr;
     LOGI("Released chunks for volume={} num_chunks={}", volume_ordinal, count);
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <list>
+#include <optional>
 #include <folly/ThreadLocal.h>
 #include <homestore/chunk_selector.h>
 #include <homestore/vchunk.h>
@@ -31,11 +32,14 @@ class VolumeChunkSelector : public homestore::ChunkSelector {
     static constexpr homestore::chunk_num_t num_chunks_per_vol_init = 1;
     static constexpr homestore::chunk_num_t num_chunks_per_resize = 3;
     static constexpr uint64_t INVALID_VOL_ORDINAL = UINT64_MAX;
+    static constexpr uint64_t INVALID_CHUNK_INDEX = UINT64_MAX;
+    static constexpr uint64_t HOT_ALLOC_HINT = 1ul << 63; // set in application hint along with the volume ordinal;
 
     struct HBChunk : public homestore::VChunk {
         HBChunk(homestore::cshared< Chunk >& chunk) : homestore::VChunk(chunk) {}
         ~HBChunk() = default;
         uint64_t m_vol_ordinal{INVALID_VOL_ORDINAL};
+        std::atomic< uint64_t > m_sealed_secs{0}; // when appends moved off it, log structured volumes only;
     };
 
     struct VolumeChunksInfo {
@@ -53,6 +57,20 @@ class VolumeChunkSelector : public homestore::ChunkSelector {
         folly::ThreadLocal< uint32_t > m_next_chunk_index;
         uint64_t ordinal;
         uint32_t pdev;
+
+        // Mirrored volume only, m_mirror_chunks[i] holds the copy of m_chunks[i] and is taken from another pdev. These
+        // are never selected for blk allocation, copies are written to the same blk numbers of the paired chunk.
+        std::vector< shared< HBChunk > > m_mirror_chunks;
+        uint32_t mirror_pdev;
+
+        // Log structured volume only, all the blks are allocated from m_chunks[append_chunk_index] until it is full.
+        std::atomic< bool > log_structured{false};
+        std::atomic< uint64_t > append_chunk_index{0};
+
+        // Blks of data overwritten often are allocated from m_chunks[hot_chunk_index] until it is full, the rest of
+        // the blks from the other chunks. No chunk is set aside while the volume has a single active chunk.
+        std::atomic< uint64_t > hot_chunk_index{INVALID_CHUNK_INDEX};
+        std::mutex append_mtx; // serializes moving to the next append or hot chunk;
     };
 
 public:
@@ -64,12 +82,18 @@ public:
     std::vector< chunk_num_t > allocate_init_chunks(uint64_t volume_ordinal, uint64_t volume_size, uint32_t& pdev_id,
                                                     bool lazy_alloc = true);
 
+    // Allocate chunks on a pdev other than the volume's own to hold a copy of every chunk of a mirrored volume. Chunks
+    // of the volume should all be allocated already, i.e. not lazily. Returned ids are paired with the volume's chunks
+    // in order.
+    std::vector< chunk_num_t > allocate_mirror_chunks(uint64_t volume_ordinal, uint32_t& pdev_id);
+
     // Called during destroy of volume or index.
     void release_chunks(uint64_t volume_ordinal);
 
     // Called during recovery of volume or index .
     bool recover_chunks(uint64_t volume_ordinal, uint32_t pdev_id, uint64_t volume_size,
                         const std::vector< chunk_num_t >& chunk_ids);
+    bool recover_mirror_chunks(uint64_t volume_ordinal, uint32_t pdev_id, const std::vector< chunk_num_t >& chunk_ids);
 
     // Called by homestore during start.
     void add_chunk(homestore::cshared< Chunk >&) override;
@@ -77,10 +101,25 @@ public:
     // Called by homestore during cp flush.
     void foreach_chunks(std::function< void(homestore::cshared< Chunk >&) >&& cb) override;
 
-    // Called by homestore during blk alloc.
+    // Application hint of blk allocations of a volume, hot is for data expected to be overwritten soon.
+    static uint64_t alloc_hint(uint64_t volume_ordinal, bool hot) {
+        return hot ? (volume_ordinal | HOT_ALLOC_HINT) : volume_ordinal;
+    }
+
+    // Called by homestore during blk alloc. Hot and cold blks of a volume are kept in different chunks.
     homestore::cshared< Chunk > select_chunk(homestore::blk_count_t nblks,
                                              const homestore::blk_alloc_hints& hints) override;
 
+    // Allocate blks of the volume sequentially, one chunk at a time, instead of round robin on the active chunks.
+    void set_log_structured(uint64_t volume_ordinal);
+
+    //
+    // Chunk of a log structured volume which is the most worth cleaning, by cost-benefit of the free space gained over
+    // the cost of moving its live blks, weighed by how long its data has been stable. Chunks with more than
+    // max_live_pct of live blks and the chunks appended to are not picked.
+    //
+    std::optional< chunk_num_t > select_victim_chunk(uint64_t volume_ordinal, uint32_t max_live_pct);
+
     std::vector< shared< VolumeChunkSelector::HBChunk > > get_chunks(uint64_t volume_ordinal);
     uint64_t num_free_chunks() const;
 
@@ -88,6 +127,9 @@ private:
     std::vector< shared< HBChunk > > allocate_init_chunks_from_pdev(uint64_t init_chunks, uint64_t total_chunks);
     std::vector< shared< HBChunk > > allocate_resize_chunks_from_pdev(uint32_t pdev, uint64_t num_chunks);
     void resize_volume_num_chunks(homestore::blk_count_t nblks, shared< VolumeChunksInfo > volc);
+    shared< HBChunk > select_append_chunk(shared< VolumeChunksInfo > const& volc);
+    shared< HBChunk > select_hot_chunk(shared< VolumeChunksInfo > const& volc);
+    shared< HBChunk > next_chunk(shared< VolumeChunksInfo > const& volc, uint64_t excluded_index, uint64_t& index);
     void dump_per_pdev_chunks() const;
     std::string dump_chunks() const;
 
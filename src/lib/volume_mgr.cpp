@@ -15,15 +15,24 @@
  *********************************************************************************/
 #include <boost/uuid/uuid_io.hpp>
 #include <iomgr/iomgr.hpp>
+#include <bit>
+#include <cstring>
+#include <set>
+#include <sys/mman.h>
 #include <homestore/crc.h>
 #include "volume/volume.hpp"
 #include "homeblks_impl.hpp"
+#include "home_blks_config.hpp"
 
 namespace homeblocks {
 std::shared_ptr< VolumeManager > HomeBlocksImpl::volume_manager() { return shared_from_this(); }
 
 void HomeBlocksImpl::on_vol_meta_blk_found(sisl::byte_view const& buf, void* cookie) {
     auto vol_ptr = Volume::make_volume(buf, cookie, volume_chunk_selector_, index_chunk_selector_);
+    if (vol_ptr == nullptr) {
+        LOGE("Failed to recover volume from superblk, skipping it");
+        return;
+    }
     auto id = vol_ptr->id();
 
     {
@@ -45,6 +54,12 @@ void HomeBlocksImpl::on_vol_meta_blk_found(sisl::byte_view const& buf, void* coo
         ordinal_reserver_->reserve(vol_ptr->ordinal());
     }
 
+    if (!vol_ptr->sb_supported()) {
+        // its journal records are skipped in replay as well, see on_write;
+        fault_containment(vol_ptr, "volume superblk version not supported");
+        return;
+    }
+
     if (vol_ptr->is_destroying()) {
         // resume volume destroying;
         LOGINFO("Volume {} is in destroying state, resume destroy", vol_ptr->id_str());
@@ -52,7 +67,8 @@ void HomeBlocksImpl::on_vol_meta_blk_found(sisl::byte_view const& buf, void* coo
     }
 }
 
-shared< hs_index_table_t > HomeBlocksImpl::recover_index_table(homestore::superblk< homestore::index_table_sb >&& sb) {
+shared< homestore::IndexTableBase >
+HomeBlocksImpl::recover_index_table(homestore::superblk< homestore::index_table_sb >&& sb) {
     auto pid_str = boost::uuids::to_string(sb->parent_uuid); // parent_uuid is the volume id
     {
         auto lg = std::scoped_lock(index_lock_);
@@ -67,7 +83,8 @@ shared< hs_index_table_t > HomeBlocksImpl::recover_index_table(homestore::superb
             LOGI("Failed to recover chunks for index table index_uuid: {}, parent_uuid: {} ordinal: {}",
                  boost::uuids::to_string(sb->uuid), pid_str, sb->ordinal);
         }
-        auto tbl = std::make_shared< VolumeIndexTable >(std::move(sb), cfg);
+        bool const wide_checksum = is_wide_checksum_index(sb->uuid);
+        auto tbl = std::make_shared< VolumeIndexTable >(wide_checksum, std::move(sb), cfg);
         idx_tbl_map_.emplace(pid_str, tbl);
         return tbl->index_table();
     }
@@ -86,6 +103,43 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::create_volume(VolumeInfo&& vol_in
         return std::unexpected(VolumeError::UNSUPPORTED_OP);
     }
 
+    // lba is in unit of page_size, each page is mapped by one index entry to a contiguous run of data blks;
+    if (vol_info.page_size < DATA_BLK_SIZE || vol_info.page_size > MAX_VOL_PAGE_SIZE ||
+        !std::has_single_bit(vol_info.page_size)) {
+        LOGE("Invalid page_size: {} for volume: {}, must be a power of 2 in [{}, {}]", vol_info.page_size,
+             boost::uuids::to_string(vol_info.id), DATA_BLK_SIZE, MAX_VOL_PAGE_SIZE);
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // lba of IO requests is in unit of sector_size, which is page_size unless a smaller one is given;
+    if (vol_info.sector_size == 0) { vol_info.sector_size = uint32_cast(vol_info.page_size); }
+    if (vol_info.sector_size < MIN_VOL_SECTOR_SIZE || vol_info.sector_size > vol_info.page_size ||
+        !std::has_single_bit(vol_info.sector_size)) {
+        LOGE("Invalid sector_size: {} for volume: {}, must be a power of 2 in [{}, page_size]", vol_info.sector_size,
+             boost::uuids::to_string(vol_info.id), MIN_VOL_SECTOR_SIZE);
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // Copies are told apart by checksum, compressed pages are not mirrored;
+    if (vol_info.mirrored && (vol_info.checksum_type == vol_checksum_type::NONE ||
+                              vol_info.compression_type != vol_compression_type::NONE)) {
+        LOGE("Mirrored volume: {} needs checksum and no compression", boost::uuids::to_string(vol_info.id));
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // Repair of a mirrored page waits for its range lock, which read-modify-write of the page holds while reading it;
+    if (vol_info.mirrored && vol_info.sector_size < vol_info.page_size) {
+        LOGE("Mirrored volume: {} can't have sectors smaller than pages", boost::uuids::to_string(vol_info.id));
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // Group journal is created along with the first volume sharing it.
+    ReplDevPtr group_jrnl;
+    if (vol_info.shared_journal) {
+        group_jrnl = group_journal(true /* create */);
+        if (!group_jrnl) { return std::unexpected(VolumeError::INTERNAL_ERROR); }
+    }
+
     inc_ref();
     auto id = vol_info.id;
 
@@ -108,6 +162,7 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::create_volume(VolumeInfo&& vol_in
 
     auto vol_ptr = Volume::make_volume(std::move(vol_info), volume_chunk_selector_, index_chunk_selector_);
     if (vol_ptr) {
+        if (group_jrnl) { vol_ptr->set_journal_rd(group_jrnl); }
         auto lg = std::scoped_lock(vol_lock_);
         vol_map_.emplace(std::make_pair(id, vol_ptr));
         LOGW("create_volume with input id: {} ordinal: {} ", boost::uuids::to_string(id), vol_ptr->info()->ordinal);
@@ -117,6 +172,9 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::create_volume(VolumeInfo&& vol_in
         return std::unexpected(VolumeError::INTERNAL_ERROR);
     }
 
+    // group commit timer runs only once there is a volume acking writes before their journal entry is committed;
+    if (vol_ptr->write_back_ack()) { start_group_commit_timer(); }
+
     dec_ref();
     return NullResult();
 }
@@ -248,6 +306,13 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::write(const VolumePtr& vol, const
         return std::unexpected(VolumeError::UNSUPPORTED_OP);
     }
 
+    auto const size = req->nlbas * vol->sector_size();
+    if (size > MAX_VOL_IO_SIZE) {
+        LOGE("Can't serve write of {} bytes, larger than max io size: {}, volume: {}", size, MAX_VOL_IO_SIZE,
+             vol->id_str());
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
 #ifdef _PRERELEASE
     if (delay_fake_io(vol)) {
         // If we are delaying IO, we return immediately without calling vol->write
@@ -255,9 +320,231 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::write(const VolumePtr& vol, const
         return NullResult();
     }
 #endif
+    auto app_buf = bounce_io_buffer(req, size, true /* copy_in */);
+    if (!app_buf) { return std::unexpected(app_buf.error()); }
+    // Overlapping writes are done in arrival order, each one keeps its lbas locked from blk allocation until commit.
+    // Reads of these lbas are served from the write buffer meanwhile.
+    auto f = split_io(vol, req, [this, vol](const vol_interface_req_ptr& sub_req) {
+        if (vol->partial_pages()) { return write_sectors(vol, sub_req); }
+        return vol->locked_write(sub_req->lba, sub_req->end_lba(), sub_req->buffer,
+                                 [this, vol, sub_req]() { return issue_write(vol, sub_req); });
+    });
+    if (!app_buf.value()) { return f; }
+    return std::move(f).ensure(
+        [this, req, app_buf = app_buf.value(), size]() { restore_io_buffer(req, app_buf, size, false); });
+}
+
+VolumeManager::NullAsyncResult
+HomeBlocksImpl::split_io(const VolumePtr& vol, const vol_interface_req_ptr& req,
+                         folly::Function< NullAsyncResult(const vol_interface_req_ptr&) >&& issue) {
+    auto const lba_size = vol->sector_size();
+    if (req->nlbas * lba_size <= MAX_VOL_SUB_IO_SIZE) { return issue(req); }
+
+    // Sub IOs share the buffer and flags of req. They don't overlap, so they run in parallel and their journal records
+    // share log flushes.
+    auto const sub_io_lbas = MAX_VOL_SUB_IO_SIZE / lba_size;
+    std::vector< NullAsyncResult > futs;
+    for (lba_t lba = req->lba; lba <= req->end_lba();) {
+        auto const nlbas = uint32_cast(std::min((lba / sub_io_lbas + 1) * sub_io_lbas, req->end_lba() + 1) - lba);
+        auto const buf = req->buffer + (lba - req->lba) * lba_size;
+        vol_interface_req_ptr sub_req(new vol_interface_req{buf, lba, nlbas, vol});
+        sub_req->part_of_batch = req->part_of_batch;
+        sub_req->fua = req->fua;
+        futs.emplace_back(issue(sub_req));
+        lba += nlbas;
+    }
+    return folly::collectAllUnsafe(futs).thenValue([](auto&& results) -> NullResult {
+        for (auto const& result : results) {
+            if (result.hasException()) { return std::unexpected(VolumeError::INTERNAL_ERROR); }
+            if (!result.value()) { return result.value(); }
+        }
+        return NullResult();
+    });
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::issue_write(const VolumePtr& vol, const vol_interface_req_ptr& req) {
+    if (use_inline_write(vol, req)) { return vol->write_inline(req); }
     return vol->write(req);
 }
 
+VolumeManager::NullAsyncResult HomeBlocksImpl::write_sectors(const VolumePtr& vol, const vol_interface_req_ptr& req) {
+    auto const page_size = vol->info()->page_size;
+    auto const start = req->lba * vol->sector_size();
+    auto const end = start + req->nlbas * vol->sector_size();
+    auto const start_page = start / page_size;
+    auto const end_page = (end - 1) / page_size;
+
+    // Page locks are taken without data, reads racing with a write of a page read what was there before it. A
+    // read-modify-write reading pages of a later write still waiting for its lock would apply the writes out of order.
+    if (start % page_size == 0 && end % page_size == 0) {
+        vol->partial_pages()->seal(start_page, end_page);
+        vol_interface_req_ptr page_req(
+            new vol_interface_req{req->buffer, start_page, uint32_cast(end_page - start_page + 1), vol});
+        page_req->part_of_batch = req->part_of_batch;
+        page_req->fua = req->fua;
+        return vol->locked_write(start_page, end_page, nullptr /* data */, [this, vol, page_req]() {
+            vol->partial_pages()->invalidate(page_req->lba, page_req->end_lba());
+            return issue_write(vol, page_req);
+        });
+    }
+
+    auto [pw, is_new] = vol->partial_pages()->add(start_page, uint32_cast(start % page_size), uint32_cast(end - start),
+                                                  req->buffer, req->fua);
+    if (is_new) {
+        auto f = vol->locked_write(start_page, end_page, nullptr /* data */,
+                                   [this, vol, pw]() { return read_modify_write(vol, pw); });
+        std::move(f).thenTry([pw](folly::Try< NullResult >&& result) { pw->done.setTry(std::move(result)); });
+    }
+    return pw->done.getFuture();
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::read_modify_write(const VolumePtr& vol,
+                                                                 std::shared_ptr< partial_write_t > const& pw) {
+    vol->partial_pages()->start(pw);
+    auto const page_size = vol->info()->page_size;
+    auto const end_page = pw->start_page + pw->npages - 1;
+    auto buf = std::make_shared< sisl::io_blob_safe >(pw->npages * page_size, IO_BUF_ALIGN);
+
+    // Pages not fully written are read first, unless they were written in part recently. Writes merged into the write
+    // of a single page could cover it together, it is read anyway.
+    auto const& first = pw->sectors.front();
+    std::set< lba_t > partial_pages;
+    if (pw->npages == 1 || first.offset != 0) { partial_pages.insert(pw->start_page); }
+    if ((first.offset + first.size) % page_size != 0) { partial_pages.insert(end_page); }
+    std::vector< NullAsyncResult > futs;
+    for (auto const page : partial_pages) {
+        auto page_buf = buf->bytes() + (page - pw->start_page) * page_size;
+        if (vol->partial_pages()->read_cached(page, page_buf)) { continue; }
+        vol_interface_req_ptr page_req(new vol_interface_req{page_buf, page, 1, vol});
+        futs.emplace_back(vol->read(page_req));
+    }
+
+    return folly::collectAllUnsafe(futs).thenValue(
+        [this, vol, pw, buf, end_page, partial_pages = std::move(partial_pages)](auto&& results) -> NullAsyncResult {
+            for (auto const& result : results) {
+                if (result.hasException()) { return std::unexpected(VolumeError::INTERNAL_ERROR); }
+                if (!result.value()) { return std::unexpected(result.value().error()); }
+            }
+
+            for (auto const& sectors : pw->sectors) {
+                std::memcpy(buf->bytes() + sectors.offset, sectors.data, sectors.size);
+            }
+            vol_interface_req_ptr page_req(new vol_interface_req{buf->bytes(), pw->start_page, pw->npages, vol});
+            page_req->fua = pw->fua;
+            return issue_write(vol, page_req).thenValue([vol, pw, buf, end_page, partial_pages](auto&& result) {
+                // Still under the range lock, the pages cached are what was just written.
+                auto merger = vol->partial_pages();
+                merger->invalidate(pw->start_page, end_page);
+                if (!result) { return result; }
+                for (auto const page : partial_pages) {
+                    merger->cache(page, buf->cbytes() + (page - pw->start_page) * vol->info()->page_size);
+                }
+                return result;
+            });
+        });
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::atomic_write(const VolumePtr& vol,
+                                                            const std::vector< vol_interface_req_ptr >& reqs) {
+    if (is_restricted()) {
+        LOGE("Can't serve atomic write, System is in restricted mode.");
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    } else if (vol->is_offline()) {
+        LOGE("Can't serve atomic write, Volume {} is offline.", vol->id_str());
+        return std::unexpected(VolumeError::VOLUME_OFFLINE);
+    }
+
+    if (vol->is_destroying() || is_shutting_down()) {
+        LOGE("Can't serve atomic write, Volume {} is_destroying: {} or System is shutting down.", vol->id_str(),
+             vol->is_destroying());
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+
+    // Ranges are journaled in lba order, overlapping ranges would leave it undefined which one wins.
+    auto sorted_reqs = reqs;
+    std::sort(sorted_reqs.begin(), sorted_reqs.end(), [](auto const& a, auto const& b) { return a->lba < b->lba; });
+    for (size_t i = 0; i < sorted_reqs.size(); ++i) {
+        if (sorted_reqs[i]->nlbas == 0 || (i > 0 && sorted_reqs[i]->lba <= sorted_reqs[i - 1]->end_lba())) {
+            LOGE("Can't serve atomic write, empty or overlapping ranges, volume: {}", vol->id_str());
+            return std::unexpected(VolumeError::INVALID_ARG);
+        }
+    }
+    if (sorted_reqs.empty() || sorted_reqs.size() > std::numeric_limits< uint16_t >::max()) {
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+    if (vol->partial_pages()) {
+        LOGE("Can't serve atomic write, volume: {} has sectors smaller than pages", vol->id_str());
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+    // Lbas from the first range to the last one are locked as a single range, which can't deadlock with other writes.
+    auto const start_lba = sorted_reqs.front()->lba;
+    auto const end_lba = sorted_reqs.back()->end_lba();
+    std::vector< std::pair< vol_interface_req_ptr, uint8_t* > > bounced;
+    for (auto const& req : sorted_reqs) {
+        auto app_buf = bounce_io_buffer(req, req->nlbas * vol->info()->page_size, true /* copy_in */);
+        if (!app_buf) {
+            for (auto const& [bounced_req, bounced_buf] : bounced) {
+                restore_io_buffer(bounced_req, bounced_buf, bounced_req->nlbas * vol->info()->page_size,
+                                  false /* copy_out */);
+            }
+            return std::unexpected(app_buf.error());
+        }
+        if (app_buf.value()) { bounced.emplace_back(req, app_buf.value()); }
+    }
+    auto f = vol->locked_write(start_lba, end_lba, nullptr /* data */, [vol, reqs = std::move(sorted_reqs)]() mutable {
+        return vol->atomic_write(std::move(reqs));
+    });
+    if (bounced.empty()) { return f; }
+    return std::move(f).ensure([this, vol, bounced = std::move(bounced)]() {
+        for (auto const& [req, app_buf] : bounced) {
+            restore_io_buffer(req, app_buf, req->nlbas * vol->info()->page_size, false /* copy_out */);
+        }
+    });
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::flush(const VolumePtr& vol) {
+    if (is_restricted()) {
+        LOGE("Can't serve flush, System is in restricted mode.");
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    } else if (vol->is_offline()) {
+        LOGE("Can't serve flush, Volume {} is offline.", vol->id_str());
+        return std::unexpected(VolumeError::VOLUME_OFFLINE);
+    }
+
+    if (vol->is_destroying() || is_shutting_down()) {
+        LOGE("Can't serve flush, Volume {} is_destroying: {} or System is shutting down.", vol->id_str(),
+             vol->is_destroying());
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+
+    // Writes are acked before commit only in write back mode, otherwise everything acked is durable already.
+    if (!vol->write_back_ack()) { return NullResult(); }
+    return vol->flush();
+}
+
+bool HomeBlocksImpl::use_inline_write(const VolumePtr& vol, const vol_interface_req_ptr& req) const {
+    // Inline writes are destaged by lsn of the volume's own journal, they can't be ordered with records in the group
+    // journal on replay.
+    if (vol->inline_write_degraded() || vol->shared_journal()) { return false; }
+
+    // Small writes are written inline in the journal unless too much is pending destage already. With HDD data device,
+    // the journal on fast device acts as write-back cache for writes up to write_back_max_kb, which are destaged in
+    // lba order.
+    uint64_t max_bytes = HB_DYNAMIC_CONFIG(inline_write_max_kb) * Ki;
+    uint64_t max_pending_bytes = HB_DYNAMIC_CONFIG(inline_write_max_pending_mb) * Mi;
+    bool write_back = (data_drive_type() == iomgr::drive_type::block_hdd);
+#ifdef _PRERELEASE
+    // Test devices are all of one type, this flip has them taken as HDD data device behind a fast journal device.
+    if (iomgr_flip::instance()->test_flip("vol_write_back_simulation")) { write_back = true; }
+#endif
+    if (write_back) {
+        max_bytes = std::max(max_bytes, HB_DYNAMIC_CONFIG(write_back_max_kb) * Ki);
+        max_pending_bytes = std::max(max_pending_bytes, HB_DYNAMIC_CONFIG(write_back_max_pending_mb) * Mi);
+    }
+    return (req->nlbas * vol->info()->page_size <= max_bytes) &&
+        (vol->inline_cache()->size_bytes() < max_pending_bytes);
+}
+
 VolumeManager::NullAsyncResult HomeBlocksImpl::read(const VolumePtr& vol, const vol_interface_req_ptr& req) {
     if (is_restricted()) {
         LOGE("Can't serve read, System is in restricted mode.");
@@ -273,6 +560,13 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::read(const VolumePtr& vol, const
         return std::unexpected(VolumeError::UNSUPPORTED_OP);
     }
 
+    auto const size = req->nlbas * vol->sector_size();
+    if (size > MAX_VOL_IO_SIZE) {
+        LOGE("Can't serve read of {} bytes, larger than max io size: {}, volume: {}", size, MAX_VOL_IO_SIZE,
+             vol->id_str());
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
 #ifdef _PRERELEASE
     if (delay_fake_io(vol)) {
         // If we are delaying IO, we return immediately without calling vol->read
@@ -280,7 +574,141 @@ VolumeManager::NullAsyncResult HomeBlocksImpl::read(const VolumePtr& vol, const
         return NullResult();
     }
 #endif
-    return vol->read(req);
+    auto app_buf = bounce_io_buffer(req, size, false /* copy_in */);
+    if (!app_buf) { return std::unexpected(app_buf.error()); }
+    auto f = split_io(vol, req, [this, vol](const vol_interface_req_ptr& sub_req) {
+        if (vol->partial_pages()) { return read_sectors(vol, sub_req); }
+        vol->record_read(sub_req->lba, sub_req->nlbas);
+        vol->read_ahead(sub_req->lba, sub_req->nlbas);
+        return vol->read(sub_req);
+    });
+    if (!app_buf.value()) { return f; }
+    // Content of the application buffer is undefined on error anyway, it is copied back regardless.
+    return std::move(f).ensure(
+        [this, req, app_buf = app_buf.value(), size]() { restore_io_buffer(req, app_buf, size, true); });
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::read_sectors(const VolumePtr& vol, const vol_interface_req_ptr& req) {
+    auto const page_size = vol->info()->page_size;
+    auto const start = req->lba * vol->sector_size();
+    auto const size = req->nlbas * vol->sector_size();
+    auto const start_page = start / page_size;
+    auto const npages = uint32_cast((start + size - 1) / page_size - start_page + 1);
+    vol->record_read(start_page, npages);
+    vol->read_ahead(start_page, npages);
+
+    // Reads of whole pages go to the buffer of req, others to a buffer of the pages they are in.
+    auto const offset = start % page_size;
+    if (offset == 0 && size % page_size == 0) {
+        vol_interface_req_ptr page_req(new vol_interface_req{req->buffer, start_page, npages, vol});
+        page_req->part_of_batch = req->part_of_batch;
+        return vol->read(page_req);
+    }
+
+    auto buf = std::make_shared< sisl::io_blob_safe >(npages * page_size, IO_BUF_ALIGN);
+    vol_interface_req_ptr page_req(new vol_interface_req{buf->bytes(), start_page, npages, vol});
+    page_req->part_of_batch = req->part_of_batch;
+    return vol->read(page_req).thenValue([req, buf, offset, size](auto&& result) {
+        if (result) { std::memcpy(req->buffer, buf->cbytes() + offset, size); }
+        return result;
+    });
+}
+
+VolumeManager::Result< uint8_t* > HomeBlocksImpl::bounce_io_buffer(const vol_interface_req_ptr& req, uint64_t size,
+                                                                   bool copy_in) {
+    if (bounce_pool_->is_aligned(req->buffer)) { return nullptr; }
+    auto buf = bounce_pool_->get(size);
+    if (!buf) {
+        LOGE("Can't serve io of {} bytes with unaligned buffer, no bounce buffer available", size);
+        return std::unexpected(VolumeError::INTERNAL_ERROR);
+    }
+    auto app_buf = req->buffer;
+    req->buffer = buf;
+    if (copy_in) { std::memcpy(req->buffer, app_buf, size); }
+    return app_buf;
+}
+
+void HomeBlocksImpl::restore_io_buffer(const vol_interface_req_ptr& req, uint8_t* app_buf, uint64_t size,
+                                       bool copy_out) {
+    if (copy_out) { std::memcpy(app_buf, req->buffer, size); }
+    bounce_pool_->put(req->buffer, size);
+    req->buffer = app_buf;
+}
+
+VolumeManager::NullAsyncResult HomeBlocksImpl::advise(const VolumePtr& vol, lba_t lba, lba_count_t nlbas,
+                                                      vol_advice advice) {
+    if (is_restricted()) {
+        LOGE("Can't serve advise, System is in restricted mode.");
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    } else if (vol->is_offline()) {
+        LOGE("Can't serve advise, Volume {} is offline.", vol->id_str());
+        return std::unexpected(VolumeError::VOLUME_OFFLINE);
+    }
+
+    if (vol->is_destroying() || is_shutting_down()) {
+        LOGE(
+            "Can't serve advise, Volume {} is_destroying: {} is either in destroying state or System is shutting down.",
+            vol->id_str(), vol->is_destroying());
+        return std::unexpected(VolumeError::UNSUPPORTED_OP);
+    }
+
+    auto const sector_size = vol->sector_size();
+    auto const page_size = vol->info()->page_size;
+    if (nlbas == 0 || (lba + nlbas) * sector_size > vol->info()->size_bytes ||
+        (advice == vol_advice::WILLNEED && nlbas * sector_size > MAX_VOL_IO_SIZE)) {
+        LOGE("Can't serve advise {} of range=[{}, {}], volume: {}", enum_name(advice), lba, lba + nlbas - 1,
+             vol->id_str());
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // Caches and read ahead work on pages, pages partially in the range are taken as a whole.
+    auto const start_page = lba * sector_size / page_size;
+    auto const end_page = ((lba + nlbas) * sector_size - 1) / page_size;
+    switch (advice) {
+    case vol_advice::WILLNEED: {
+        // Split like reads, the pages are read into buffers of the prefetch.
+        vol_interface_req_ptr req(new vol_interface_req{nullptr, lba, nlbas, vol});
+        return split_io(vol, req, [vol, sector_size, page_size](const vol_interface_req_ptr& sub_req) {
+            auto const start = sub_req->lba * sector_size;
+            auto const sub_start_page = start / page_size;
+            auto const sub_end_page = (start + sub_req->nlbas * sector_size - 1) / page_size;
+            return vol->prefetch(sub_start_page, uint32_cast(sub_end_page - sub_start_page + 1));
+        });
+    }
+    case vol_advice::DONTNEED:
+        vol->drop_cached(start_page, end_page);
+        break;
+    case vol_advice::SEQUENTIAL:
+        vol->set_read_ahead(start_page, end_page, true);
+        break;
+    case vol_advice::RANDOM:
+        vol->set_read_ahead(start_page, end_page, false);
+        break;
+    }
+    return NullResult();
+}
+
+VolumeManager::NullResult HomeBlocksImpl::register_io_buffer(uint8_t const* buf, uint64_t size) {
+    if (size == 0 || !bounce_pool_->is_aligned(buf) || size % IO_BUF_ALIGN != 0) {
+        LOGE("Can't register io buffer {} of size {}, it should be aligned to {}", fmt::ptr(buf), size, IO_BUF_ALIGN);
+        return std::unexpected(VolumeError::INVALID_ARG);
+    }
+
+    // Pinning is best effort, it could be over RLIMIT_MEMLOCK, IOs with the buffer work regardless.
+    if (mlock(buf, size) != 0) {
+        LOGW("Failed to lock io buffer {} of size {}, errno: {}", fmt::ptr(buf), size, errno);
+    }
+    std::scoped_lock lg(io_bufs_mtx_);
+    io_bufs_[buf] = size;
+    return NullResult();
+}
+
+void HomeBlocksImpl::unregister_io_buffer(uint8_t const* buf) {
+    std::scoped_lock lg(io_bufs_mtx_);
+    auto it = io_bufs_.find(buf);
+    if (it == io_bufs_.end()) { return; }
+    munlock(it->first, it->second);
+    io_bufs_.erase(it);
 }
 
 VolumeManager::NullAsyncResult HomeBlocksImpl::unmap(const VolumePtr& vol, const vol_interface_req_ptr& req) {
@@ -323,43 +751,106 @@ void HomeBlocksImpl::on_write(int64_t lsn, const sisl::blob& header, const sisl:
     if (ctx) { repl_ctx = boost::static_pointer_cast< repl_result_ctx< VolumeManager::NullResult > >(ctx).get(); }
     auto msg_header = r_cast< MsgHeader* >(const_cast< uint8_t* >(header.cbytes()));
 
-    // Key contains the list of checksums and old blkids. Before we ack the client
-    // request, we free the old blkid's. Also if its recovery we overwrite the index
-    // with checksum and new blkid's. We need to overwrite index during recovery as all the
-    // index writes may not be flushed to disk during crash.
     VolumePtr vol_ptr{nullptr};
-    auto journal_entry = r_cast< const VolJournalEntry* >(key.cbytes());
-    auto key_buffer = r_cast< const uint8_t* >(journal_entry + 1);
-
     if (repl_ctx == nullptr) {
         // For recovery path repl_ctx and vol_ptr wont be available.
         auto lg = std::shared_lock(vol_lock_);
         auto it = vol_map_.find(msg_header->volume_id);
         RELEASE_ASSERT(it != vol_map_.end(), "Didnt find volume {}", boost::uuids::to_string(msg_header->volume_id));
         vol_ptr = it->second;
+        // Entries of a volume whose superblk can't be read can't be parsed either, the volume is kept offline.
+        if (!vol_ptr->sb_supported()) {
+            LOGW("Skipping replay of lsn: {} of volume: {} with unsupported superblk", lsn, vol_ptr->id_str());
+            return;
+        }
+    } else {
+        // Avoid expensive lock during normal write flow.
+        vol_ptr = repl_ctx->vol_ptr_;
+    }
+
+    // An atomic write carries one entry per range, each laid out as the single entry of a write. New blkids are
+    // shared by the entries in order.
+    auto key_buffer = key.cbytes();
+    uint16_t num_entries{1};
+    if (msg_header->msg_type == MsgType::ATOMIC_WRITE) {
+        num_entries = r_cast< const VolAtomicJournalEntry* >(key_buffer)->num_ranges;
+        key_buffer += sizeof(VolAtomicJournalEntry);
+    }
+    PageBlkIdIter blkid_iter{new_blkids};
+    for (uint16_t i = 0; i < num_entries; ++i) {
+        key_buffer = on_write_entry(lsn, header, vol_ptr, key_buffer, blkid_iter, repl_ctx == nullptr);
+    }
 
-        // During log recovery overwrite new blkid and checksum to index.
+#ifdef _PRERELEASE
+    if (iomgr_flip::instance()->test_flip("vol_write_crash_after_journal_write")) {
+        // this is to simulate crash during write where both data and journal
+        // is persisted. After recovery log entries are replayed.
+        LOGINFO("Volume write crash simulation flip is set, aborting");
+        return;
+    }
+#endif
+
+    if (repl_ctx) { repl_ctx->promise_.setValue(NullResult()); }
+}
+
+uint8_t const* HomeBlocksImpl::on_write_entry(int64_t lsn, const sisl::blob& header, const VolumePtr& vol_ptr,
+                                              uint8_t const* key_buffer, PageBlkIdIter& blkid_iter,
+                                              bool is_recovery) {
+    // Key contains the list of checksums and old blkids. Before we ack the client
+    // request, we free the old blkid's. Also if its recovery we overwrite the index
+    // with checksum and new blkid's. We need to overwrite index during recovery as all the
+    // index writes may not be flushed to disk during crash.
+    auto msg_header = r_cast< const MsgHeader* >(header.cbytes());
+    auto journal_entry = r_cast< const VolJournalEntry* >(key_buffer);
+    key_buffer = r_cast< const uint8_t* >(journal_entry + 1);
+    auto const csum_sz = checksum_size(vol_ptr->checksum_type());
+    auto dedup_entry = r_cast< const VolDedupEntry* >(key_buffer + journal_entry->nlbas * csum_sz +
+                                                      journal_entry->num_old_blks * sizeof(BlkId));
+    auto const dedup_end = dedup_entry + journal_entry->num_dedup_blks;
+    auto entry_end = r_cast< const uint8_t* >(dedup_end);
+    homestore::blk_count_t const* stored_blks{nullptr};
+    if (vol_ptr->compression_type() != vol_compression_type::NONE) {
+        stored_blks = r_cast< const homestore::blk_count_t* >(dedup_end);
+        entry_end += sizeof(homestore::blk_count_t) * (journal_entry->nlbas - journal_entry->num_dedup_blks);
+    }
+
+    if (is_recovery) {
+        // During log recovery overwrite new blkid and checksum to index. Lbas deduped to an existing blk are listed
+        // after old blkids, the rest are mapped to the new blkids in order, each taking the number of blks stored for
+        // it on volumes with compression.
+        auto const blks_per_pg = static_cast< homestore::blk_count_t >(vol_ptr->blks_per_page());
         std::unordered_map< lba_t, BlockInfo > blocks_info;
-        lba_t start_lba = journal_entry->start_lba;
-        for (auto& blkid : new_blkids) {
-            for (uint32_t i = 0; i < blkid.blk_count(); i++) {
-                auto new_bid = BlkId{blkid.blk_num() + i, 1 /* nblks */, blkid.chunk_num()};
-                auto csum = *r_cast< const homestore::csum_t* >(key_buffer);
-                blocks_info.emplace(start_lba + i, BlockInfo{new_bid, BlkId{}, csum});
-                key_buffer += sizeof(homestore::csum_t);
+        for (lba_count_t i = 0; i < journal_entry->nlbas; i++) {
+            BlkId new_bid;
+            if (dedup_entry != dedup_end && dedup_entry->lba_offset == i) {
+                new_bid = (dedup_entry++)->blkid;
+            } else {
+                homestore::blk_count_t nblks{blks_per_pg};
+                if (stored_blks) { std::memcpy(&nblks, stored_blks++, sizeof(homestore::blk_count_t)); }
+                new_bid = blkid_iter.next(nblks);
+                RELEASE_ASSERT(new_bid.is_valid(), "Journal entry doesn't match new blkids");
             }
+            vol_csum_t csum{0};
+            std::memcpy(&csum, key_buffer, csum_sz);
+            blocks_info.emplace(journal_entry->start_lba + i, BlockInfo{new_bid, BlkId{}, csum});
+            key_buffer += csum_sz;
+        }
 
-            // We ignore the existing values we got in blocks_info from index as it will be
-            // same checksum, blkid we see in the journal entry.
-            lba_t end_lba = start_lba + blkid.blk_count() - 1;
-            auto status = vol_ptr->indx_table()->write_to_index(start_lba, end_lba, blocks_info);
-            RELEASE_ASSERT(status, "Index error during recovery");
-            start_lba = end_lba + 1;
+        // We ignore the existing values we got in blocks_info from index as it will be
+        // same checksum, blkid we see in the journal entry.
+        auto status = vol_ptr->write_to_index(journal_entry->start_lba,
+                                              journal_entry->start_lba + journal_entry->nlbas - 1, blocks_info);
+        RELEASE_ASSERT(status, "Index error during recovery");
+
+        // Inline written pages covered by this destage are in index now, the lsn of the latest one is in header.
+        if (msg_header->msg_type == MsgType::DESTAGE_WRITE) {
+            int64_t destage_lsn{0};
+            std::memcpy(&destage_lsn, header.cbytes() + sizeof(MsgHeader), sizeof(int64_t));
+            vol_ptr->inline_cache()->erase(journal_entry->start_lba,
+                                           journal_entry->start_lba + journal_entry->nlbas - 1, destage_lsn);
         }
     } else {
-        // Avoid expensive lock during normal write flow.
-        vol_ptr = repl_ctx->vol_ptr_;
-        key_buffer += (journal_entry->nlbas * sizeof(homestore::csum_t));
+        key_buffer += (journal_entry->nlbas * csum_sz);
     }
 
     // Free all the old blkids. This happens for both normal writes
@@ -370,16 +861,31 @@ void HomeBlocksImpl::on_write(int64_t lsn, const sisl::blob& header, const sisl:
         vol_ptr->rd()->async_free_blks(lsn, old_blkid);
         key_buffer += sizeof(BlkId);
     }
+    return entry_end;
+}
 
-#ifdef _PRERELEASE
-    if (iomgr_flip::instance()->test_flip("vol_write_crash_after_journal_write")) {
-        // this is to simulate crash during write where both data and journal
-        // is persisted. After recovery log entries are replayed.
-        LOGINFO("Volume write crash simulation flip is set, aborting");
-        return;
+void HomeBlocksImpl::on_inline_write(int64_t lsn, const sisl::blob& header, const sisl::blob& key,
+                                     cintrusive< homestore::repl_req_ctx >& ctx) {
+    repl_result_ctx< VolumeManager::NullResult >* repl_ctx{nullptr};
+    if (ctx) { repl_ctx = boost::static_pointer_cast< repl_result_ctx< VolumeManager::NullResult > >(ctx).get(); }
+    auto msg_header = r_cast< const MsgHeader* >(header.cbytes());
+
+    // Key contains lba, nlbas followed by the data pages.
+    VolumePtr vol_ptr{nullptr};
+    auto journal_entry = r_cast< const VolJournalEntry* >(key.cbytes());
+    if (repl_ctx == nullptr) {
+        // For recovery path, pages not destaged before crash are loaded to inline cache again.
+        auto lg = std::shared_lock(vol_lock_);
+        auto it = vol_map_.find(msg_header->volume_id);
+        RELEASE_ASSERT(it != vol_map_.end(), "Didnt find volume {}", boost::uuids::to_string(msg_header->volume_id));
+        vol_ptr = it->second;
+        if (!vol_ptr->sb_supported()) { return; }
+    } else {
+        vol_ptr = repl_ctx->vol_ptr_;
     }
-#endif
 
+    vol_ptr->inline_cache()->insert(journal_entry->start_lba, journal_entry->nlbas,
+                                    r_cast< const uint8_t* >(journal_entry + 1), lsn);
     if (repl_ctx) { repl_ctx->promise_.setValue(NullResult()); }
 }
 